@@ -110,7 +110,7 @@
 #define configUSE_MALLOC_FAILED_HOOK             1
 #define configENABLE_BACKWARD_COMPATIBILITY      0
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION  1
-#define configUSE_TASK_NOTIFICATIONS             0
+#define configUSE_TASK_NOTIFICATIONS             1
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES                    0
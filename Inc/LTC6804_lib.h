@@ -48,8 +48,51 @@ Copyright 2013 Linear Technology Corp. (LTC)
 #define LTC68041_H
 
 #include "stm32l4xx_hal.h"
+#include "cmsis_os.h"
+#include "packStats.h"
 
-#define TOTAL_IC	3	// Number of LTC6804-1s Stacked
+#ifndef LTC6804_MAX_CHAINS
+#define LTC6804_MAX_CHAINS	2	// Maximum number of chains (one per SPI peripheral)
+#endif
+
+// PEC15 calculation backends
+#define PEC_BACKEND_TABLE	0	// Software 256-entry lookup table
+#define PEC_BACKEND_HW		1	// STM32 CRC peripheral (hcrc)
+
+#ifndef LTC6804_PEC_BACKEND
+#define LTC6804_PEC_BACKEND	PEC_BACKEND_TABLE
+#endif
+
+#ifndef LTC6804_XFER_TIMEOUT_MS
+#define LTC6804_XFER_TIMEOUT_MS	10	// Wait for a read transfer (or job list) past its bus time before the isoSPI link is considered hung
+#endif
+
+#ifndef LTC6804_AWAKE_MS
+#define LTC6804_AWAKE_MS	3	// Traffic this recent means the isoSPI port is still awake (tIDLE is 4.3ms min), no wake pulse
+#endif
+
+#define LTC6804_WAKE_IDLE_US	10	// CS low time waking the isoSPI port from IDLE (tREADY)
+#define LTC6804_WAKE_SLEEP_US	300	// CS low time waking the core from SLEEP (tWAKE)
+
+#ifndef LTC6804_PEC_RETRIES
+#define LTC6804_PEC_RETRIES	2	// Re-reads of a register group read back with a PEC error
+#endif
+
+#ifndef LTC6804_SPI_MAX_HZ
+#define LTC6804_SPI_MAX_HZ	1000000	// Fastest SPI clock the link manager uses, its starting clock (isoSPI data rate limit)
+#endif
+
+// SPI link manager (see LTC6804_linkAdapt())
+#define LTC6804_LINK_LEVELS		3	// Clock steps, each half the previous one (level 0: fastest under LTC6804_SPI_MAX_HZ)
+#define LTC6804_LINK_WINDOW		256	// Reads per quality window (every IC is read once per read)
+#define LTC6804_LINK_MAX_ERRS	1	// PEC errors of one IC in a window tolerated at a level (~1 bit in 16k of its data)
+#define LTC6804_LINK_HOLDOFF	64	// Most clean windows waited before trying a faster level again
+
+// Completion status of a read transfer (xferStatus), the ISR then notifies the waiting task
+#define LTC6804_XFER_OK			0	// Transfer complete
+#define LTC6804_XFER_DMA_ERR	1	// SPI/DMA error reported by the HAL
+#define LTC6804_XFER_TIMEOUT	2	// No completion LTC6804_XFER_TIMEOUT_MS past the bus time, transfer aborted
+#define LTC6804_XFER_PENDING	0xFF	// Armed, not complete yet
 
 #ifndef LTC6804_CS
 #define LTC6804_CS QUIKEVAL_CS
@@ -110,6 +153,33 @@ Copyright 2013 Linear Technology Corp. (LTC)
 #define AUX_CH_GPIO5 5
 #define AUX_CH_VREF2 6
 
+// Conversions timed by LTC6804_convTime()
+#define LTC6804_CONV_CELL	0	// ADCV
+#define LTC6804_CONV_AUX	1	// ADAX
+#define LTC6804_CONV_CVAX	2	// ADCVAX
+#define LTC6804_CONV_STAT	3	// ADSTAT
+#define LTC6804_CONV_DIAGN	4	// DIAGN (MUX decoder check)
+#define LTC6804_CONV_ALL	5	// All 12 cells or all GPIOs + REF2, whatever adcCH/adcCHG (ADOW, CVST, AXST)
+
+// Scans run by LTC6804_scan()
+#define LTC6804_SCAN_CELL	0x01	// ADCV + all cell voltage groups
+#define LTC6804_SCAN_AUX	0x02	// ADAX, read back during the next scan
+#define LTC6804_SCAN_STAT	0x04	// ADSTAT + both status groups
+
+// Diagnostics rotated by LTC6804_diagRun()
+#define LTC6804_DIAG_CV		0	// Cell ADC self-test (LTC6804_cvTest())
+#define LTC6804_DIAG_AUX	1	// Aux ADC self-test (LTC6804_auxTest())
+#define LTC6804_DIAG_STAT	2	// Status ADC self-test (LTC6804_statTest())
+#define LTC6804_DIAG_MUX	3	// MUX decoder check (LTC6804_muxTest())
+#define LTC6804_DIAG_SUPPLY	4	// Supply voltage check (LTC6804_internalTest())
+#define LTC6804_DIAG_OW		5	// Open wire check (LTC6804_owTest(), two phases)
+#define LTC6804_DIAG_NUM	6
+
+#ifndef LTC6804_OW_REPEATS
+#define LTC6804_OW_REPEATS	2		// ADOW conversions per open wire phase (at least 2 except in the 26Hz mode)
+#endif
+#define LTC6804_OW_THRESHOLD	4000	// Pull-down minus pull-up reading of an open wire's cell (400mV)
+
 //uint8_t CHG = 0; //!< aux channels to be converted
  /*!****************************************************
   \brief Controls if Discharging transitors are enabled
@@ -130,23 +200,259 @@ Copyright 2013 Linear Technology Corp. (LTC)
 #define CELL_IN_REG		3		// Number of cell measurements per register group
 #define GPIO_IN_REG		3		// Number of GPIO measurements per register group
 #define NUM_AUX_REG		2		// Number of AUX register groups
+#define NUM_CV_REG		4		// Number of cell voltage register groups
+#define NUM_STAT_REG	2		// Number of status register groups
+#define STAT_IN_REG		3		// Number of boardStat halfwords per status register group
+#define LTC6804_XFER_LEN(n)	(CMD_LEN + BYTES_IN_REG * (n))			// Length of one register group read transaction for n ICs
+#define LTC6804_PIPE_STAGES	(NUM_CV_REG + 1)						// Longest job list (RDCVA-RDCVD + RDAUXA after ADCVAX)
+#define LTC6804_ASYNC_DEPTH	4										// Async requests queued at once
+#define LTC6804_ASYNC_SLOT(n, slot)	((LTC6804_PIPE_STAGES + (slot)) * LTC6804_XFER_LEN(n))	// Offset of an async request's Tx/Rx slot, past the job list ones
+#define LTC6804_BUF_LEN(n)	((LTC6804_PIPE_STAGES + LTC6804_ASYNC_DEPTH) * LTC6804_XFER_LEN(n))	// SPI buffer length for n ICs (pipelined reads + async slots)
+
+// States of an async request (see LTC6804_asyncSubmit())
+#define LTC6804_REQ_IDLE	0	// Never submitted
+#define LTC6804_REQ_QUEUED	1	// Waiting for the bus
+#define LTC6804_REQ_ACTIVE	2	// Being transferred
+#define LTC6804_REQ_XFERED	3	// Transfer ended, waiting for LTC6804_asyncService()
+#define LTC6804_REQ_DONE	4	// Parsed, status is valid
+
+// Bus priority classes of async requests, the most urgent waiting request goes next
+#define LTC6804_PRIO_DIAG	0	// Self-tests and other background traffic (default)
+#define LTC6804_PRIO_NORMAL	1	// Configuration, aux and status
+#define LTC6804_PRIO_SAFETY	2	// Cell voltage conversions and reads
 
 #define cvTestPos		0x6AAA	// Cell voltage test positive result
 #define axTestPos		0x6AAA	// Aux voltage test positive result
 #define statTestPos		0x6AAA	// Status group conversion test positive result
 
+// boardStat[ic][] layout: status groups A and B as received (little endian halfwords)
+#define STAT_SOC		0		// Sum of all cells, 2mV/LSB
+#define STAT_ITMP		1		// Die temperature, ITMP * 100uV / 7.5mV - 273 degC
+#define STAT_VA			2		// Analog supply, 100uV/LSB
+#define STAT_VD			3		// Digital supply, 100uV/LSB
+// Register groups of the PEC telemetry (bit n of pecMap, column n of pecCount)
+#define LTC6804_GRP_CVA		0	// Cell voltage groups A to D: LTC6804_GRP_CVA + reg - 1
+#define LTC6804_GRP_CVB		1
+#define LTC6804_GRP_CVC		2
+#define LTC6804_GRP_CVD		3
+#define LTC6804_GRP_AUXA	4	// Auxiliary groups A and B
+#define LTC6804_GRP_AUXB	5
+#define LTC6804_GRP_STATA	6	// Status groups A and B
+#define LTC6804_GRP_STATB	7
+#define LTC6804_GRP_CFG		8	// Configuration group
+#define LTC6804_GRP_NUM		9
+
+#define STAT_FLAGS_LO	4		// Cells 1 to 8 comparator flags: CnUV at bit 2n - 2, CnOV at bit 2n - 1
+#define STAT_FLAGS_HI	5		// Cells 9 to 12 comparator flags (bits 0 to 7), THSD, MUXFAIL and REV
+
+#define STAT_LO_UV_FLAGS	0x5555	// Masks of STAT_FLAGS_LO
+#define STAT_LO_OV_FLAGS	0xAAAA
+#define STAT_HI_UV_FLAGS	0x0055	// Masks of STAT_FLAGS_HI
+#define STAT_HI_OV_FLAGS	0x00AA
+#define STAT_HI_CELL_FLAGS	0x00FF
+#define STAT_HI_THSD		0x0100	// Thermal shutdown occurred
+#define STAT_HI_MUXFAIL		0x0200	// Multiplexer self test failed
+#define STAT_HI_REV			0xF000	// Revision code
+
+typedef struct ltc68041Req ltc68041Req;
+
+// Measurement frame of a chain; the arrays are [numIC][...] like the handle's working arrays
+typedef struct {
+	uint32_t	timestamp;									// osKernelSysTick() when the frame was published
+	uint16_t	(*cellVolts)[12];							// Cell voltage codes
+	uint16_t 	(*auxVolts)[REG_BYTES];						// Auxiliary GPIO voltage codes
+	uint16_t	(*boardStat)[6];							// Status register data
+	packStats	stats;										// Statistics of cellVolts
+	uint32_t	balIC;										// ICs discharging cells while converting them with DCP enabled (codes include the balancing IR drop)
+} ltc68041Frame;
+
+// Pack health counters of a chain (free running, never reset by the library)
+typedef struct {
+	uint32_t	initFails;									// LTC68041_Initialize() calls that failed (see its return value)
+	uint32_t	periods;									// Acquisition periods run
+	uint32_t	overruns;									// Periods whose scan overran the deadline
+	uint32_t	worstScan;									// Longest scan (ticks)
+	uint32_t	pecRetries;									// Register groups re-read because of a PEC error
+	uint32_t	pecFails;									// Reads still failing PEC after all retries
+	uint32_t	xferFails;									// Transfers or conversions that timed out or failed
+	uint32_t	cfgWrites;									// WRCFGs sent by LTC6804_cfgSync() (retries included)
+	uint32_t	cfgRetries;									// WRCFGs repeated because the read back did not match
+	uint32_t	cfgFails;									// LTC6804_cfgSync() calls still mismatched after all retries
+	uint32_t	cfgDrifts;									// Scrubs that found a chip configuration changed behind the library's back
+	uint32_t	wakes;										// Wake pulses sent
+	uint32_t	wakeSkips;									// Wake pulses skipped because the port was still awake
+} ltc68041Health;
+
+// SPI link quality and clock selection of a chain (see LTC6804_linkAdapt())
+typedef struct {
+	uint8_t		level;										// Current clock step (0: fastest allowed)
+	uint8_t		base;										// Prescaler code (CR1 BR) of level 0
+	uint16_t	winReads;									// Reads in the current window
+	uint16_t	clean;										// Error free windows in a row at this level
+	uint16_t	holdoff[LTC6804_LINK_LEVELS];				// Error free windows needed before trying each level again
+	uint32_t	reads[LTC6804_LINK_LEVELS];					// Reads done at each level
+	uint32_t	errors[LTC6804_LINK_LEVELS];				// IC reads failing PEC at each level
+	uint32_t	changes;									// Clock changes
+} ltc68041Link;
+
+// Background diagnostic counters of a chain (see LTC6804_diagRun())
+typedef struct {
+	uint8_t		next;										// Next test of the rotation
+	uint32_t	skips;										// Tests skipped for never fitting the budget
+	uint32_t	runs[LTC6804_DIAG_NUM];						// Completed runs of each test
+	uint32_t	fails[LTC6804_DIAG_NUM];					// Runs of each test failed by at least one IC
+} ltc68041Diag;
+
 typedef struct {
 	SPI_HandleTypeDef * hspi;								// SPI Handle for this chain
-	uint8_t		ADCV[2];									// Global ADCV register template
-	uint8_t		ADAX[2];									// Global ADAX register template
-	uint8_t 	spiRxBuf[TOTAL_IC * BYTES_IN_REG * 4];		// SPI Receive Buffer (Maximum size is cell voltage read result)
-	uint8_t	 	spiTxBuf[TOTAL_IC * BYTES_IN_REG];			// SPI Transmit Buffer
-	uint8_t		boardConfigs[TOTAL_IC][REG_BYTES];			// All the boards' configurations on the stack
-	uint16_t	boardStat[TOTAL_IC][6];						// Status register data for each boards
-	uint16_t 	auxVolts[TOTAL_IC][REG_BYTES];				// Stores the auxiliary GPIO measurement data
-	uint16_t	cellVolts[TOTAL_IC][12];					// Stores the cell voltage measurement data
+	TIM_HandleTypeDef * htim;								// One pulse 1MHz timer ending the wake pulses (NULL: blocking wake pulses)
+	GPIO_TypeDef * csPort;									// Chip select GPIO port
+	uint16_t	csPin;										// Chip select GPIO pin
+	TaskHandle_t volatile xferTask;							// Task notified from the ISR when a read transfer (or job list) completes
+	volatile uint8_t	xferStatus;							// LTC6804_XFER_* of the armed transfer, set by the ISR before notifying xferTask
+	uint8_t		numIC;										// Number of LTC6804-1s stacked on this chain
+	uint8_t		ADCV[CMD_LEN];								// Global ADCV command template (with PEC)
+	uint8_t		ADAX[CMD_LEN];								// Global ADAX command template (with PEC)
+	uint8_t		ADCVAX[CMD_LEN];							// Combined cell + GPIO1/2 conversion command template (with PEC)
+	uint8_t		CVST[CMD_LEN];								// Cell voltage self-test command template (with PEC)
+	uint8_t		AXST[CMD_LEN];								// Aux voltage self-test command template (with PEC)
+	uint8_t		STATST[CMD_LEN];							// Status group self-test command template (with PEC)
+	uint8_t		ADSTAT[CMD_LEN];							// Status group conversion command template (with PEC)
+	uint8_t		ADOWPU[CMD_LEN];							// Open wire conversion with pull-up current command template (with PEC)
+	uint8_t		ADOWPD[CMD_LEN];							// Open wire conversion with pull-down current command template (with PEC)
+	uint8_t		adcMD;										// ADC mode of the templates
+	uint8_t		adcCH;										// Cell channels converted by ADCV
+	uint8_t		adcCHG;										// GPIO channels converted by ADAX
+	uint8_t		adcDCP;										// Discharge permitted during cell conversions
+	uint32_t	convStart;									// osKernelSysTick() when the scan last started a conversion
+	uint8_t		auxPending;									// An ADAX is converting and not yet read back
+	ltc68041Health	health;									// Scan health counters
+	ltc68041Diag	diag;									// Background diagnostic counters
+	ltc68041Link	link;									// SPI clock selection and link quality
+	uint16_t *	linkIcErrs;									// PEC errors of each IC in the current link window
+	uint32_t	diagFailIC;									// ICs that failed the last self-test (bit n = IC n)
+	uint8_t		owPhase;									// Next phase of the open wire check (0: pull-up, 1: pull-down)
+	uint8_t *	spiRxBuf;									// SPI Receive Buffer (LTC6804_BUF_LEN(numIC) bytes)
+	uint8_t	*	spiTxBuf;									// SPI Transmit Buffer (LTC6804_BUF_LEN(numIC) bytes)
+	volatile uint8_t	xferStage;							// Current transaction of the pipelined job list
+	volatile uint8_t	xferStages;							// Number of transactions in the pipelined job list (0 for single transactions)
+	uint32_t	pecErrIC;									// ICs that failed the PEC check in the last cell/aux read (bit n = IC n)
+	uint16_t *	pecMap;										// Groups whose last read failed PEC on each IC (bit LTC6804_GRP_*)
+	uint32_t	(*pecCount)[LTC6804_GRP_NUM];				// PEC errors of each group on each IC since power up
+	uint8_t		(*boardConfigs)[REG_BYTES];					// All the boards' configurations on the stack
+	uint8_t		(*cfgShadow)[REG_BYTES];					// Configuration last verified on each IC (see LTC6804_cfgSync())
+	uint32_t	cfgStale;									// ICs whose configuration is unknown and must be rewritten (bit n = IC n)
+	uint16_t	(*boardStat)[6];							// Status register data for each boards
+	uint16_t 	(*auxVolts)[REG_BYTES];						// Stores the auxiliary GPIO measurement data
+	uint16_t	(*cellVolts)[12];							// Stores the cell voltage measurement data
+	uint32_t	(*diagHistory)[LTC6804_DIAG_NUM];			// Verdicts of the last 32 runs of each test on each IC (bit 0 = last run, 1 = failed)
+	uint16_t	(*owPU)[12];								// Cell codes of the last open wire pull-up phase
+	uint16_t	(*owPD)[12];								// Cell codes of the last open wire pull-down phase
+	uint16_t	*owOpen;									// Open sense wires of each IC found by the last open wire check (bit n = Cn)
+	ltc68041Frame	snap[2];								// Published frames (ping-pong); snap[snapSeq & 1] is the latest
+	volatile uint32_t	snapSeq;							// Number of frames published
+	ltc68041Req * volatile	asyncQ[LTC6804_ASYNC_DEPTH];	// Async request owning each Tx/Rx slot (NULL: free)
+	uint8_t		asyncIn;									// Async requests submitted
+	volatile uint8_t	asyncEnded;							// Async transfers ended
+	volatile uint8_t	asyncSlot;							// Slot of the async request on the bus
+	volatile uint8_t	asyncBusy;							// The async queue owns the bus (claimed by LTC6804_asyncSubmit(), released by the ISR when empty)
+	volatile uint8_t	asyncActive;						// The transfer on the bus is an async request's (set by LTC6804_asyncStart() only)
+	volatile uint32_t	lastXfer;							// osKernelSysTick() of the last isoSPI traffic (transfer or wake pulse)
+	volatile uint8_t	waking;								// A timer driven wake pulse holds CS low
+	uint8_t *	pendTx;										// Transfer parked behind the wake pulse (pendLen 0: none)
+	uint8_t *	pendRx;
+	volatile uint16_t	pendLen;
 } ltc68041ChainHandle;
 
+// Async command descriptor; must stay valid until it is LTC6804_REQ_DONE
+struct ltc68041Req {
+	const uint8_t *	cmd;									// Command with its PEC (CMD_LEN bytes), e.g. hbms->ADCV
+	const uint8_t *	tx;										// Data sent after the command (len bytes), NULL to clock out 0xFF
+	uint16_t	len;										// Bytes after the command, at most BYTES_IN_REG * numIC (0 for plain commands)
+	int8_t		(*parse)(ltc68041ChainHandle * hbms, const uint8_t * rx, void * ctx);	// Parses the len bytes read back (task context), NULL for none; returns the status
+	void		(*done)(ltc68041ChainHandle * hbms, ltc68041Req * req);			// Called once the request is done (task context), NULL for none
+	void *		ctx;										// Passed to parse
+	uint8_t		prio;										// Bus priority class, LTC6804_PRIO_*
+	uint8_t		seq;										// Submission (then completion) order, set by the library
+	volatile uint8_t	state;								// LTC6804_REQ_*
+	int8_t		status;										// 0 ok, parse's return, -2 transfer failure
+};
+
+/*
+ * Statically allocates the storage of a chain of n ICs.
+ * The per-IC arrays are [n][...] so they can be indexed as [ic][channel] through the handle.
+ * The SPI buffers are word aligned so every register group slot starts on a word boundary.
+ */
+#define LTC68041_CHAIN_STORAGE(name, n)						\
+	static uint8_t	name##_spiRxBuf[LTC6804_BUF_LEN(n)] __attribute__((aligned(4)));	\
+	static uint8_t	name##_spiTxBuf[LTC6804_BUF_LEN(n)] __attribute__((aligned(4)));	\
+	static uint8_t	name##_boardConfigs[n][REG_BYTES];		\
+	static uint8_t	name##_cfgShadow[n][REG_BYTES];			\
+	static uint16_t	name##_boardStat[n][6];					\
+	static uint16_t	name##_auxVolts[n][REG_BYTES];			\
+	static uint16_t	name##_cellVolts[n][12];				\
+	static uint32_t	name##_diagHistory[n][LTC6804_DIAG_NUM];	\
+	static uint16_t	name##_owPU[n][12];						\
+	static uint16_t	name##_owPD[n][12];						\
+	static uint16_t	name##_owOpen[n];						\
+	static uint16_t	name##_linkIcErrs[n];					\
+	static uint16_t	name##_pecMap[n];						\
+	static uint32_t	name##_pecCount[n][LTC6804_GRP_NUM];	\
+	static uint16_t	name##_snapCellVolts[2][n][12];			\
+	static uint16_t	name##_snapAuxVolts[2][n][REG_BYTES];	\
+	static uint16_t	name##_snapBoardStat[2][n][6];			\
+	static uint32_t	name##_snapIcSum[2][n]
+
+// Initializer of a handle bound to the storage declared by LTC68041_CHAIN_STORAGE(name, n)
+#define LTC68041_CHAIN_HANDLE(name, n)			\
+	{											\
+		.numIC = (n),							\
+		.spiRxBuf = name##_spiRxBuf,			\
+		.spiTxBuf = name##_spiTxBuf,			\
+		.boardConfigs = name##_boardConfigs,	\
+		.cfgShadow = name##_cfgShadow,			\
+		.boardStat = name##_boardStat,			\
+		.auxVolts = name##_auxVolts,			\
+		.cellVolts = name##_cellVolts,			\
+		.diagHistory = name##_diagHistory,		\
+		.owPU = name##_owPU,					\
+		.owPD = name##_owPD,					\
+		.owOpen = name##_owOpen,				\
+		.linkIcErrs = name##_linkIcErrs,		\
+		.pecMap = name##_pecMap,				\
+		.pecCount = name##_pecCount,			\
+		.snap = {								\
+			{									\
+				.cellVolts = name##_snapCellVolts[0],	\
+				.auxVolts = name##_snapAuxVolts[0],		\
+				.boardStat = name##_snapBoardStat[0],	\
+				.stats.icSum = name##_snapIcSum[0]		\
+			},									\
+			{									\
+				.cellVolts = name##_snapCellVolts[1],	\
+				.auxVolts = name##_snapAuxVolts[1],		\
+				.boardStat = name##_snapBoardStat[1],	\
+				.stats.icSum = name##_snapIcSum[1]		\
+			}									\
+		}										\
+	}
+
+/*
+ * Statically allocates a reader's copy of a frame of a chain of n ICs, and
+ * the frame bound to it. Pass &name to LTC6804_snapshotRead().
+ */
+#define LTC68041_FRAME_STORAGE(name, n)						\
+	static uint16_t	name##_cellVolts[n][12];				\
+	static uint16_t	name##_auxVolts[n][REG_BYTES];			\
+	static uint16_t	name##_boardStat[n][6];					\
+	static uint32_t	name##_icSum[n];						\
+	static ltc68041Frame name = {							\
+		.cellVolts = name##_cellVolts,						\
+		.auxVolts = name##_auxVolts,						\
+		.boardStat = name##_boardStat,						\
+		.stats.icSum = name##_icSum							\
+	}
+
 typedef struct {
 	uint8_t 	refon;		// Reference on/off
 	uint8_t		swtrd;		// Software discharge timer
@@ -162,14 +468,49 @@ int8_t LTC6804_rdaux(ltc68041ChainHandle * hbms, uint8_t reg);
 void set_adc(ltc68041ChainHandle * hbms, uint8_t MD, uint8_t DCP, uint8_t CH, uint8_t CHG);
 void LTC6804_adax(ltc68041ChainHandle * hbms);
 void LTC6804_adcv(ltc68041ChainHandle * hbms);
-uint8_t LTC6804_rdcv(ltc68041ChainHandle * hbms, uint8_t reg);
+uint32_t LTC6804_convTime(ltc68041ChainHandle * hbms, uint8_t conv);
+int8_t LTC6804_pladc(ltc68041ChainHandle * hbms);
+int8_t LTC6804_convWait(ltc68041ChainHandle * hbms, uint8_t conv, uint32_t start);
+int8_t LTC6804_scan(ltc68041ChainHandle * hbms, uint8_t scans);
+void LTC6804_adcvax(ltc68041ChainHandle * hbms);
+int8_t LTC6804_rdcvax(ltc68041ChainHandle * hbms);
+int8_t LTC6804_scanCvax(ltc68041ChainHandle * hbms);
+void LTC6804_adstat(ltc68041ChainHandle * hbms);
+void LTC6804_rdstat_reg(ltc68041ChainHandle * hbms, uint8_t reg);
+int8_t LTC6804_rdstat(ltc68041ChainHandle * hbms, uint8_t reg);
+uint16_t LTC6804_statOV(const uint16_t * stat);
+uint16_t LTC6804_statUV(const uint16_t * stat);
+uint32_t LTC6804_statFaultIC(const uint16_t (*boardStat)[6], uint8_t numIC);
+uint32_t LTC6804_pecGroupIC(ltc68041ChainHandle * hbms, uint8_t grp);
+int8_t LTC6804_rdcv(ltc68041ChainHandle * hbms, uint8_t reg);
 void LTC6804_rdcv_reg(ltc68041ChainHandle * hbms, uint8_t reg);
+void LTC6804_rdcv_pipe(ltc68041ChainHandle * hbms);
 void LTC6804_rdaux_reg(ltc68041ChainHandle * hbms, uint8_t reg);
+int8_t LTC6804_rdcv_pipeCplt(ltc68041ChainHandle * hbms);
+int8_t LTC6804_rdcvMulti(ltc68041ChainHandle * chains[], uint8_t chainCount);
+void LTC6804_snapshotPublish(ltc68041ChainHandle * hbms);
+uint32_t LTC6804_snapshotRead(ltc68041ChainHandle * hbms, ltc68041Frame * frame);
+const ltc68041Frame * LTC6804_snapshotLatest(ltc68041ChainHandle * hbms);
+uint16_t LTC6804_getDcc(ltc68041ChainHandle * hbms, uint8_t ic);
+void LTC6804_setDcc(ltc68041ChainHandle * hbms, uint8_t ic, uint16_t dcc);
+int8_t LTC6804_asyncSubmit(ltc68041ChainHandle * hbms, ltc68041Req * req);
+uint8_t LTC6804_asyncService(ltc68041ChainHandle * hbms);
+int8_t LTC6804_asyncWait(ltc68041ChainHandle * hbms, ltc68041Req * req);
+void LTC6804_asyncFlush(ltc68041ChainHandle * hbms);
+void LTC6804_asyncRdcvReq(ltc68041ChainHandle * hbms, ltc68041Req * req, uint8_t reg);
+void LTC6804_asyncRdauxReq(ltc68041ChainHandle * hbms, ltc68041Req * req, uint8_t reg);
+void LTC6804_SPI_TxRxCpltCallback(SPI_HandleTypeDef * hspi);
+void LTC6804_SPI_TxCpltCallback(SPI_HandleTypeDef * hspi);
+void LTC6804_SPI_ErrorCallback(SPI_HandleTypeDef * hspi);
+void LTC6804_TIM_PeriodElapsedCallback(TIM_HandleTypeDef * htim);
 void LTC6804_clrcell(ltc68041ChainHandle * hbms);
 void LTC6804_clraux(ltc68041ChainHandle * hbms);
 void LTC6804_wrcfg(ltc68041ChainHandle * hbms);
 int8_t LTC6804_rdcfg(ltc68041ChainHandle * hbms);
-void wakeup_sleep();
+uint32_t LTC6804_cfgDirty(ltc68041ChainHandle * hbms);
+int8_t LTC6804_cfgSync(ltc68041ChainHandle * hbms);
+int8_t LTC6804_cfgScrub(ltc68041ChainHandle * hbms);
+void wakeup_sleep(ltc68041ChainHandle * hbms);
 uint16_t pec15_calc(uint8_t len, uint8_t *data);
 
 // Diagnostics
@@ -178,6 +519,13 @@ int8_t LTC6804_auxTest(ltc68041ChainHandle * hbms);
 int8_t LTC6804_statTest(ltc68041ChainHandle * hbms);
 int8_t LTC6804_muxTest(ltc68041ChainHandle * hbms);
 int8_t LTC6804_internalTest(ltc68041ChainHandle * hbms);
+int8_t LTC6804_owTest(ltc68041ChainHandle * hbms);
+uint8_t LTC6804_diagRun(ltc68041ChainHandle * hbms, uint32_t budget);
+
+// SPI link
+void LTC6804_linkInit(ltc68041ChainHandle * hbms);
+int8_t LTC6804_linkAdapt(ltc68041ChainHandle * hbms);
+uint32_t LTC6804_linkClock(ltc68041ChainHandle * hbms);
 
 
 #endif
@@ -0,0 +1,47 @@
+/*
+ * cellBalance.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Passive cell balancing of one chain. Each period the controller picks the
+ *  cells to bleed from the latest published frame and writes the configuration
+ *  with LTC6804_cfgSync(), so a WRCFG only goes out when the discharge pattern
+ *  of some IC actually changed (or a previous write did not verify).
+ *
+ *  A cell starts bleeding once it is startDelta above the lowest cell of the
+ *  pack and stops once it falls below stopDelta above it (hysteresis). At most
+ *  maxPerIC cells, the highest ones, bleed at once on each IC.
+ *
+ *  With DCP_DISABLED (set_adc()) the LTC6804 pauses the discharge during every
+ *  cell conversion, so the codes are not affected by the balancing. With
+ *  DCP_ENABLED the frames converted while bleeding are flagged in frame.balIC.
+ */
+
+#ifndef CELLBALANCE_H_
+#define CELLBALANCE_H_
+
+#include "LTC6804_lib.h"
+
+typedef struct {
+	uint8_t		enabled;					// 0: all discharge switches off
+	uint8_t		maxPerIC;					// Most cells bled at once on each IC
+	uint16_t	startDelta;					// Start bleeding a cell this far above the lowest cell (codes)
+	uint16_t	stopDelta;					// Stop bleeding it at or below this far above the lowest cell (codes)
+	uint16_t	minCell;					// Never bleed a cell at or below this code
+	uint32_t	maxAge;						// Oldest frame balanced on (ticks); older frames switch all bleeding off
+	uint32_t	writes;						// Verified configuration writes
+	uint16_t *	dcc;						// Discharge pattern last written to each IC [numIC]
+} cellBalancer;
+
+/*
+ * Statically allocates a balancer for a chain of n ICs, bound to its storage
+ */
+#define CELLBALANCE_STORAGE(name, n)						\
+	static uint16_t	name##_dcc[n];							\
+	static cellBalancer name = {							\
+		.dcc = name##_dcc									\
+	}
+
+uint8_t cellBalance_update(cellBalancer * bal, ltc68041ChainHandle * hbms);
+
+#endif /* CELLBALANCE_H_ */
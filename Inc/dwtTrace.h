@@ -0,0 +1,76 @@
+/*
+ * dwtTrace.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Opt-in cycle count probes based on the Cortex-M4 DWT cycle counter (CYCCNT).
+ *  Define DWT_TRACE in nodeConf.h to enable them; otherwise all the probe macros
+ *  compile to nothing.
+ *
+ *  Usage:
+ *  	TRACE_BEGIN(TRACE_PEC15);
+ *  	... code to measure ...
+ *  	TRACE_END(TRACE_PEC15);
+ *
+ *  TRACE_MARK(id) / TRACE_SINCE(id) measure across contexts (e.g. from an ISR to
+ *  the task it wakes). Each probe keeps min/max/mean and a log2 histogram of its
+ *  samples; dump them with dwtTrace_dumpSerial() or dwtTrace_dumpCan().
+ */
+
+#ifndef DWTTRACE_H_
+#define DWTTRACE_H_
+
+#include "main.h"
+#include "nodeConf.h"
+
+#define TRACE_BUCKETS	24		// Histogram bucket b counts samples of 2^(b-1) to 2^b - 1 cycles (last bucket saturates)
+
+// Probe identifiers
+typedef enum {
+	TRACE_PEC15 = 0,			// pec15_calc()
+	TRACE_WRCFG,				// LTC6804_wrcfg()
+	TRACE_RDCFG,				// LTC6804_rdcfg()
+	TRACE_RDCV,					// LTC6804_rdcv()
+	TRACE_RDAUX,				// LTC6804_rdaux()
+	TRACE_RDSTAT,				// LTC6804_rdstat()
+	TRACE_PARSE_CV,				// Cell voltage parse and PEC check loops
+	TRACE_PARSE_AUX,			// Aux voltage parse and PEC check loops
+	TRACE_XFER_WAKE,			// SPI completion ISR to reading task running
+	TRACE_CAN_TX,				// bxCanDoTx() frame assembly and send
+	TRACE_SERIAL_TX,			// Serial2 doTx()
+	TRACE_SCAN,					// LTC6804_scan()
+	TRACE_SCAN_PERIOD,			// Time between scan loop releases (jitter = max - min)
+	TRACE_PACK_STATS,			// packStats_compute()
+	TRACE_NUM_PROBES
+} traceProbe;
+
+typedef struct {
+	uint32_t	count;						// Number of samples
+	uint32_t	min;						// Shortest sample (cycles)
+	uint32_t	max;						// Longest sample (cycles)
+	uint64_t	sum;						// Sum of all samples (cycles)
+	uint32_t	hist[TRACE_BUCKETS];		// log2 histogram of the samples
+} traceStat;
+
+#ifdef DWT_TRACE
+#define TRACE_BEGIN(id)		uint32_t id##_start = DWT->CYCCNT
+#define TRACE_END(id)		dwtTrace_record((id), DWT->CYCCNT - id##_start)
+#define TRACE_MARK(id)		dwtTrace_mark((id))
+#define TRACE_SINCE(id)		dwtTrace_since((id))
+#else
+#define TRACE_BEGIN(id)
+#define TRACE_END(id)
+#define TRACE_MARK(id)
+#define TRACE_SINCE(id)
+#endif
+
+void dwtTrace_init();
+void dwtTrace_reset();
+void dwtTrace_record(traceProbe id, uint32_t cycles);
+void dwtTrace_mark(traceProbe id);
+void dwtTrace_since(traceProbe id);
+void dwtTrace_get(traceProbe id, traceStat * stat);
+void dwtTrace_dumpSerial();
+void dwtTrace_dumpCan(uint32_t canId);
+
+#endif /* DWTTRACE_H_ */
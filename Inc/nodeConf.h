@@ -39,5 +39,23 @@
 #define HB_Interval		1000		// Node heartbeat send interval	(soft ms)
 #define WD_Interval		16			// Watdog timer refresh interval (soft ms) | MUST BE LESS THAN 26!!!
 
+#define TOTAL_IC		3			// Number of LTC6804-1s stacked on the BMS chain (hbms1)
+#define BMS_SCAN_Interval	100		// BMS acquisition period (soft ms), 20 to 100 | MUST BE LONGER THAN A SCAN + BMS_DIAG_Budget!!!
+#define BMS_AUX_Divider		1		// Aux (ADAX) scan every n acquisition periods (0: never)
+#define BMS_STAT_Divider	10		// Status (ADSTAT) scan every n acquisition periods (0: never)
+#define BMS_DIAG_Budget		8000	// Background self-test bus time per acquisition period (us, 0: none), fits an open wire phase
+#define BMS_CELL_OV			42000	// Cell over voltage comparator threshold (100uV/LSB, 1.6mV steps)
+#define BMS_CELL_UV			27000	// Cell under voltage comparator threshold (100uV/LSB, 1.6mV steps)
+#define BMS_BAL_Enable		1		// Passive balancing on (1) or off (0)
+#define BMS_BAL_Start		100		// Bleed cells more than this above the lowest cell (100uV/LSB)
+#define BMS_BAL_Stop		30		// ... until they are within this of the lowest cell (100uV/LSB)
+#define BMS_BAL_MinCell		33000	// Never bleed cells at or below this (100uV/LSB)
+#define BMS_BAL_MaxPerIC	4		// Most cells bled at once on each IC (heat)
+#define BMS_CFG_Scrub		10		// Configuration read back (drift check) every n acquisition periods (0: never)
+#define BMS_INIT_Retries	5		// Chain bring-up attempts before scanning anyway (failures counted in health.initFails)
+#define BMS_INIT_Delay		200		// Wait between bring-up attempts (soft ms)
+
+//#define DWT_TRACE					// Enable the DWT cycle count probes (dwtTrace.h)
+
 
 #endif /* NODECONF_H_ */
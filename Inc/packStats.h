@@ -0,0 +1,82 @@
+/*
+ * packStats.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Pack statistics over the cell voltage codes of a chain ([numIC][12], 100uV/LSB).
+ *  Min/max cell with its position, pack sum, mean, variance and per-IC sums are
+ *  computed in a single pass. The scan task computes them into every published
+ *  frame (see LTC6804_snapshotPublish()), so consumers read frame.stats instead
+ *  of looping over the cells themselves.
+ *
+ *  packStatsInc keeps the same statistics up to date from single register group
+ *  reads (3 cells per IC) without going over all the cells again:
+ *  	PACKSTATS_INC_STORAGE(fastStats, TOTAL_IC);
+ *  	packStatsInc_reset(&fastStats, hbms1.cellVolts);		// After a full read
+ *  	if(LTC6804_rdcv(&hbms1, reg) == 0){
+ *  		packStatsInc_update(&fastStats, hbms1.cellVolts, (reg - 1) * CELL_IN_REG, CELL_IN_REG);
+ *  	}
+ *  	packStatsInc_get(&fastStats, &stats);
+ */
+
+#ifndef PACKSTATS_H_
+#define PACKSTATS_H_
+
+#include "main.h"
+
+// Pack statistics backends
+#define PACKSTATS_BACKEND_SCALAR	0	// Plain C, one cell at a time (reference)
+#define PACKSTATS_BACKEND_SIMD		1	// Cortex-M4 DSP extension, two cells per instruction
+
+#ifndef PACKSTATS_BACKEND
+#define PACKSTATS_BACKEND	PACKSTATS_BACKEND_SIMD
+#endif
+
+typedef struct {
+	uint16_t	min;						// Lowest cell code
+	uint16_t	max;						// Highest cell code
+	uint8_t		minIC;						// IC of the lowest cell (first one on ties)
+	uint8_t		minCell;					// Cell of the lowest cell within its IC
+	uint8_t		maxIC;						// IC of the highest cell (first one on ties)
+	uint8_t		maxCell;					// Cell of the highest cell within its IC
+	uint16_t	delta;						// max - min (imbalance)
+	uint16_t	mean;						// Pack sum / number of cells (rounded down)
+	uint32_t	sum;						// Sum of all the cell codes
+	uint32_t	variance;					// Population variance of the cell codes (codes^2)
+	uint32_t *	icSum;						// Sum of the cell codes of each IC [numIC]
+} packStats;
+
+// Running statistics over a cached copy of the cells, updated one register group at a time
+typedef struct {
+	uint8_t		numIC;						// Number of ICs covered
+	uint8_t		extValid;					// min/max still describe the cached cells (0: rescan on the next read)
+	uint16_t	min;						// Lowest cached code (valid when extValid)
+	uint16_t	max;						// Highest cached code (valid when extValid)
+	uint16_t	minIdx;						// Position of min (ic * 12 + cell)
+	uint16_t	maxIdx;						// Position of max (ic * 12 + cell)
+	uint32_t	sum;						// Sum of the cached codes
+	uint64_t	sumSq;						// Sum of the squares of the cached codes
+	uint32_t	rebuilds;					// Number of min/max rescans so far
+	uint32_t *	icSum;						// Sum of the cached codes of each IC [numIC]
+	uint16_t	(*cells)[12];				// Codes the statistics describe [numIC][12]
+} packStatsInc;
+
+/*
+ * Statically allocates an incremental statistics block for n ICs, bound to its storage
+ */
+#define PACKSTATS_INC_STORAGE(name, n)						\
+	static uint32_t	name##_icSum[n];						\
+	static uint16_t	name##_cells[n][12];					\
+	static packStatsInc name = {							\
+		.numIC = (n),										\
+		.icSum = name##_icSum,								\
+		.cells = name##_cells								\
+	}
+
+void packStats_compute(const uint16_t (*cellVolts)[12], uint8_t numIC, packStats * stats);
+void packStats_copy(packStats * dst, const packStats * src, uint8_t numIC);
+void packStatsInc_reset(packStatsInc * inc, const uint16_t (*cellVolts)[12]);
+void packStatsInc_update(packStatsInc * inc, const uint16_t (*cellVolts)[12], uint8_t first, uint8_t count);
+void packStatsInc_get(packStatsInc * inc, packStats * stats);
+
+#endif /* PACKSTATS_H_ */
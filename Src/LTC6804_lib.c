@@ -9,30 +9,405 @@
 #include "cmsis_os.h"
 #include "stm32l4xx_hal.h"
 #include "nodeMiscHelpers.h"
+#include "dwtTrace.h"
+#include <string.h>
 
 extern CRC_HandleTypeDef hcrc;
-extern osSemaphoreId bmsTRxCompleteHandle;
+
+// Chains registered for SPI completion dispatch (one chain per SPI peripheral)
+static ltc68041ChainHandle * chainList[LTC6804_MAX_CHAINS];
+static uint8_t numChains = 0;
+
+// Fixed command codes with their PEC precomputed (CMD0, CMD1, PEC0, PEC1)
+static const uint8_t cmdWRCFG[CMD_LEN] 	= {0x00, 0x01, 0x3D, 0x6E};
+static const uint8_t cmdRDCFG[CMD_LEN] 	= {0x00, 0x02, 0x2B, 0x0A};
+static const uint8_t cmdRDCV[NUM_CV_REG][CMD_LEN] = {
+	{0x00, 0x04, 0x07, 0xC2},	// RDCVA
+	{0x00, 0x06, 0x9A, 0x94},	// RDCVB
+	{0x00, 0x08, 0x5E, 0x52},	// RDCVC
+	{0x00, 0x0A, 0xC3, 0x04}	// RDCVD
+};
+static const uint8_t cmdRDAUX[NUM_AUX_REG][CMD_LEN] = {
+	{0x00, 0x0C, 0xEF, 0xCC},	// RDAUXA
+	{0x00, 0x0E, 0x72, 0x9A}	// RDAUXB
+};
+static const uint8_t cmdRDSTAT[NUM_STAT_REG][CMD_LEN] = {
+	{0x00, 0x10, 0xED, 0x72},	// RDSTATA
+	{0x00, 0x12, 0x70, 0x24}	// RDSTATB
+};
+static const uint8_t cmdCLRCELL[CMD_LEN] 	= {0x07, 0x11, 0xC9, 0xC0};
+static const uint8_t cmdCLRAUX[CMD_LEN] 	= {0x07, 0x12, 0xDF, 0xA4};
+static const uint8_t cmdDIAGN[CMD_LEN] 	= {0x07, 0x15, 0x78, 0x5E};
+static const uint8_t cmdPLADC[CMD_LEN] 	= {0x07, 0x14, 0xF3, 0x6C};
+
+// Conversion times in us, [MD][ADCOPT] (MD = 0 is the 422Hz/1kHz mode)
+static const uint32_t convTimeAll[4][2] = {		// All 12 cells (ADCV) or all GPIOs + REF2 (ADAX)
+	{12807, 7150},		// 422Hz, 1kHz
+	{1113, 1288},		// MD_FAST: 27kHz, 14kHz
+	{2335, 3033},		// MD_NORMAL: 7kHz, 3kHz
+	{201317, 4430}		// MD_FILTERED: 26Hz, 2kHz
+};
+static const uint32_t convTimeCvax[4][2] = {	// All 12 cells + GPIO1 and GPIO2 (ADCVAX)
+	{17077, 9534},		// 422Hz, 1kHz
+	{1564, 1736},		// MD_FAST: 27kHz, 14kHz
+	{3133, 4064},		// MD_NORMAL: 7kHz, 3kHz
+	{335000, 5925}		// MD_FILTERED: 26Hz, 2kHz
+};
+static const uint32_t convTimeSingle[4][2] = {	// One cell pair (ADCV) or one GPIO (ADAX)
+	{2135, 1192},		// 422Hz, 1kHz
+	{201, 230},			// MD_FAST: 27kHz, 14kHz
+	{405, 521},			// MD_NORMAL: 7kHz, 3kHz
+	{34000, 754}		// MD_FILTERED: 26Hz, 2kHz
+};
+// ESTIMATE: the datasheet gives no ADSTAT time in the 422Hz/1kHz mode. Row 0 is the
+// ADCV time scaled by ADSTAT/ADCV of MD_NORMAL; LTC6804_convWait() polls PLADC past it.
+static const uint32_t convTimeStat[4][2] = {	// SOC, ITMP, VA and VD (ADSTAT)
+	{8570, 4781},		// 422Hz, 1kHz (ESTIMATE, see above)
+	{748, 865},			// MD_FAST: 27kHz, 14kHz
+	{1563, 2028},		// MD_NORMAL: 7kHz, 3kHz
+	{134000, 2959}		// MD_FILTERED: 26Hz, 2kHz
+};
+
+static void LTC6804_xferArm(ltc68041ChainHandle * hbms);
+static uint8_t LTC6804_pecCheck(void);
+static uint32_t LTC6804_xferTime(ltc68041ChainHandle * hbms, uint32_t bytes);
+
+/***********************************************//**
+ \brief Returns how long a transfer may take before the link is taken as hung
+
+ The longest job list (LTC6804_PIPE_STAGES groups of the whole chain) at the
+ current SPI clock plus LTC6804_XFER_TIMEOUT_MS, so long chains at a slow clock
+ are not cut short.
+
+ @return TickType_t, Timeout in ticks
+ *************************************************/
+static TickType_t LTC6804_xferTimeout(ltc68041ChainHandle * hbms)
+{
+	uint32_t us = LTC6804_xferTime(hbms, LTC6804_PIPE_STAGES * LTC6804_XFER_LEN(hbms->numIC));
+
+	return(pdMS_TO_TICKS(LTC6804_XFER_TIMEOUT_MS) + (TickType_t)osKernelSysTickMicroSec(us) + 1);
+}
+
+/***********************************************//**
+ \brief Drops whatever is left in the chain's SPI Rx FIFO
+
+ A read transfer must not start with stale bytes in the FIFO, the DMA would
+ take them as the first bytes of the answer.
+ *************************************************/
+static void LTC6804_rxFlush(ltc68041ChainHandle * hbms)
+{
+	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE))
+	{
+		(void)hbms->hspi->Instance->DR;
+	}
+}
+
+/***********************************************//**
+ \brief Takes the bus back from a transfer that never ended
+
+ Aborts the DMA transfer, releases CS and drops whatever the completion ISR
+ would have chained after it: the rest of a job list, whose wait then returns
+ LTC6804_XFER_TIMEOUT, and the async request on the bus, which ends with
+ status -2 (completed by LTC6804_asyncService()).
+ Requests still queued stay queued; the queue no longer owns the bus, so the
+ next LTC6804_asyncSubmit() or LTC6804_asyncWait() starts them again.
+ *************************************************/
+static void LTC6804_busRecover(ltc68041ChainHandle * hbms)
+{
+	ltc68041Req * req;
+
+	HAL_SPI_Abort(hbms->hspi);
+	HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_SET);
+	taskENTER_CRITICAL();
+	hbms->xferStages = 0;
+	hbms->xferStatus = LTC6804_XFER_TIMEOUT;
+	if(hbms->asyncActive)
+	{
+		req = (hbms->asyncQ)[hbms->asyncSlot];
+		req->status = -2;
+		req->seq = hbms->asyncEnded++;
+		req->state = LTC6804_REQ_XFERED;
+		hbms->asyncActive = 0;
+	}
+	hbms->asyncBusy = 0;
+	taskEXIT_CRITICAL();
+}
+
+/***********************************************//**
+ \brief Waits until the chain's SPI has no transfer in progress
+
+ Lets a command follow a transmit-only one (e.g. ADCV) without its wakeup
+ pulse toggling CS in the middle of the previous transfer (or wake pulse). The task sleeps
+ until the completion ISR notifies it, so the bus is idle for microseconds
+ rather than a whole tick. A transfer that never ends within
+ LTC6804_xferTimeout() is aborted (see LTC6804_busRecover()).
+ *************************************************/
+static void LTC6804_spiWaitIdle(ltc68041ChainHandle * hbms)
+{
+	if(!(hbms->waking) && (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY))
+	{
+		return;
+	}
+
+	LTC6804_xferArm(hbms);											// Before checking again, so the end of the transfer still notifies
+	while(hbms->waking || (HAL_SPI_GetState(hbms->hspi) != HAL_SPI_STATE_READY))
+	{
+		if(xTaskNotifyWait(0, 0xFFFFFFFF, NULL, LTC6804_xferTimeout(hbms)) != pdTRUE)
+		{
+			LTC6804_busRecover(hbms);
+			hbms->health.xferFails++;
+			break;
+		}
+	}
+	hbms->xferTask = NULL;
+}
+
+/***********************************************//**
+ \brief Arms the completion notification of a read transfer
+
+ Must be called by the reading task before the transfer is started, so the ISR
+ knows which task to notify. Any stale notification (e.g. from a transfer that
+ completed after its wait had already timed out) is dropped; a transfer of
+ another chain that already ended keeps its xferStatus.
+ *************************************************/
+static void LTC6804_xferArm(ltc68041ChainHandle * hbms)
+{
+	xTaskNotifyStateClear(NULL);
+	hbms->xferStatus = LTC6804_XFER_PENDING;
+	hbms->xferTask = xTaskGetCurrentTaskHandle();
+}
+
+/***********************************************//**
+ \brief Ends the armed transfer of a chain with a status, from its ISRs
+
+ The status goes in the handle before the task is notified: one task may wait
+ on several chains (LTC6804_rdcvMulti()), so a notification only wakes it and
+ each chain's wait checks its own xferStatus. A timeout stays until the next
+ LTC6804_xferArm().
+ *************************************************/
+static void LTC6804_xferNotify(ltc68041ChainHandle * hbms, uint8_t status, BaseType_t * pxHigherPriorityTaskWoken)
+{
+	if(hbms->xferStatus != LTC6804_XFER_TIMEOUT)
+	{
+		hbms->xferStatus = status;									// The armed transfer was aborted, this end is another one's
+	}
+	if(hbms->xferTask != NULL)
+	{
+		xTaskNotifyFromISR(hbms->xferTask, status, eSetValueWithOverwrite, pxHigherPriorityTaskWoken);
+	}
+}
+
+/***********************************************//**
+ \brief Waits for the completion of a read transfer armed with LTC6804_xferArm()
+
+ Blocks for at most LTC6804_xferTimeout(). On timeout the link is taken as
+ hung and the bus recovered (see LTC6804_busRecover()).
+
+ The wake latency, from the ISR's notification to this task running again,
+ is the TRACE_XFER_WAKE probe. It has not been measured on the target yet:
+ define DWT_TRACE, run a few hundred acquisition periods and read the probe
+ with dwtTrace_get(); for the binary semaphore this replaced, put the same
+ TRACE_MARK()/TRACE_SINCE() pair around its give and take. Expected bound:
+ Bms_Acquire is the highest priority task, so PendSV tail-chains the DMA
+ interrupt and the switch needs no tick. Exception return and entry (~30
+ cycles), xTaskNotifyFromISR() (~150) and vTaskSwitchContext() with the
+ CLZ ready list lookup and the context save and restore (~250) stay under
+ 600 cycles, 7.5us at 80MHz, plus any CAN or USART interrupt running in
+ between. The semaphore woke through the same yield, with a slightly longer
+ xSemaphoreGiveFromISR().
+
+ @return uint8_t, Transfer status.
+
+		LTC6804_XFER_OK: Transfer complete, data is in spiRxBuf
+
+		LTC6804_XFER_DMA_ERR: SPI/DMA error
+
+		LTC6804_XFER_TIMEOUT: No completion, transfer aborted
+ *************************************************/
+static uint8_t LTC6804_xferWait(ltc68041ChainHandle * hbms)
+{
+	uint32_t start = osKernelSysTick();
+	TickType_t timeout = LTC6804_xferTimeout(hbms);
+	TickType_t elapsed;
+
+	// Another chain of this task may be the one waking it, carry on until this one is done
+	while(hbms->xferStatus == LTC6804_XFER_PENDING)
+	{
+		elapsed = osKernelSysTick() - start;
+		if((elapsed >= timeout) || (xTaskNotifyWait(0, 0xFFFFFFFF, NULL, timeout - elapsed) != pdTRUE))
+		{
+			LTC6804_busRecover(hbms);
+			break;
+		}
+	}
+	if(hbms->xferStatus != LTC6804_XFER_TIMEOUT)
+	{
+		TRACE_SINCE(TRACE_XFER_WAKE);								// ISR notification to this task running
+	}
+	hbms->xferTask = NULL;
+	return hbms->xferStatus;
+}
+
+/***********************************************//**
+ \brief Starts a DMA transfer now, or at the end of the wake pulse in progress
+
+ Called from tasks and ISRs. While a timer driven wake pulse holds CS low the
+ transfer is parked, and LTC6804_TIM_PeriodElapsedCallback() starts it as soon
+ as it releases CS.
+
+ @param[in] uint8_t * rx; Receive buffer, NULL for a write-only transfer
+ *************************************************/
+static void LTC6804_xferStart(ltc68041ChainHandle * hbms, uint8_t * tx, uint8_t * rx, uint16_t len)
+{
+	UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+	if(hbms->waking)
+	{
+		hbms->pendTx = tx;
+		hbms->pendRx = rx;
+		hbms->pendLen = len;
+		taskEXIT_CRITICAL_FROM_ISR(mask);
+		return;
+	}
+	taskEXIT_CRITICAL_FROM_ISR(mask);
+
+	hbms->lastXfer = osKernelSysTick();
+	HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_RESET);
+	if(rx != NULL)
+	{
+		HAL_SPI_TransmitReceive_DMA(hbms->hspi, tx, rx, len);
+	}
+	else
+	{
+		HAL_SPI_Transmit_DMA(hbms->hspi, tx, len);
+	}
+}
+
+/***********************************************//**
+ \brief Holds CS low for us microseconds to wake the isoSPI port (or the core)
+
+ With a timer bound to the chain (hbms->htim) the pulse is ended by the timer
+ ISR and the calling task carries on meanwhile; the next transfer is parked
+ until then (see LTC6804_xferStart()). Without one it falls back to blocking.
+ *************************************************/
+static void LTC6804_wakePulse(ltc68041ChainHandle * hbms, uint16_t us)
+{
+	hbms->lastXfer = osKernelSysTick();
+	hbms->health.wakes++;
+
+	if(hbms->htim == NULL)
+	{
+		HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_RESET);
+		if(us > LTC6804_WAKE_IDLE_US)
+		{
+			osDelay(1);												// Guarantees the LTC6804 will be in standby; soft delay
+		}
+		else
+		{
+			delayUs(2);												// Guarantees the isoSPI will be in ready mode
+		}
+		HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_SET);
+		return;
+	}
+
+	hbms->waking = 1;
+	HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_RESET);
+	__HAL_TIM_SET_AUTORELOAD(hbms->htim, us - 1);
+	__HAL_TIM_SET_COUNTER(hbms->htim, 0);
+	__HAL_TIM_CLEAR_FLAG(hbms->htim, TIM_FLAG_UPDATE);
+	__HAL_TIM_ENABLE_IT(hbms->htim, TIM_IT_UPDATE);
+	__HAL_TIM_ENABLE(hbms->htim);									// One pulse mode: stops itself at the update
+}
+
+/***********************************************//**
+ \brief Dispatches HAL_TIM_PeriodElapsedCallback() to the chain on that timer
+
+ Call from HAL_TIM_PeriodElapsedCallback(). Ends the chain's wake pulse and
+ starts the transfer parked behind it, if any; otherwise wakes a task waiting
+ for the bus in LTC6804_spiWaitIdle(). The pulse may end between a read's
+ LTC6804_xferArm() and its LTC6804_xferStart() (task preempted), so it never
+ completes the armed transfer.
+ *************************************************/
+void LTC6804_TIM_PeriodElapsedCallback(TIM_HandleTypeDef * htim)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	ltc68041ChainHandle * hbms;
+	uint16_t len;
+
+	for(uint8_t chain = 0; chain < numChains; chain++)
+	{
+		hbms = chainList[chain];
+		if((hbms->htim == htim) && hbms->waking)
+		{
+			HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_SET);
+			hbms->waking = 0;
+			len = hbms->pendLen;
+			hbms->pendLen = 0;
+			if(len)
+			{
+				LTC6804_xferStart(hbms, hbms->pendTx, hbms->pendRx, len);
+			}
+			else if(hbms->xferTask != NULL)
+			{
+				// Only wakes LTC6804_spiWaitIdle(): a read armed meanwhile has not started, its xferStatus stays pending
+				xTaskNotifyFromISR(hbms->xferTask, 0, eNoAction, &xHigherPriorityTaskWoken);
+			}
+			break;
+		}
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
 
 /*
  * To initialize:
  * set_adc(hbms, MD_NORMAL,DCP_DISABLED,CELL_CH_ALL,AUX_CH_ALL);
  *
- * Create a global ltc68041ChainHandle in main.c
+ * Create a global ltc68041ChainHandle in main.c with its storage:
+ * LTC68041_CHAIN_STORAGE(hbms1, TOTAL_IC);
+ * ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TOTAL_IC);
+ *
+ * hinit must hold one ltc68041ChainInitStruct per IC (numIC entries).
+ *
+ * Other tasks should not read the handle's measurement arrays directly; the scan
+ * task publishes them with LTC6804_snapshotPublish() and readers take a copy:
+ * LTC68041_FRAME_STORAGE(pack, TOTAL_IC);
+ * if(LTC6804_snapshotRead(&hbms1, &pack)){ ... pack.cellVolts[ic][cell] ... pack.stats.max ... }
  */
 
 uint8_t LTC68041_Initialize(ltc68041ChainHandle * hbms, ltc68041ChainInitStruct * hinit){
 	uint8_t retVal = 0;
+
+	// Nothing can be read or written with a broken PEC backend
+	if(!LTC6804_pecCheck()){
+		hbms->health.initFails++;
+		return 5;
+	}
+
+	// Register the chain for SPI completion dispatch, once when the caller retries
+	uint8_t chain = 0;
+	while((chain < numChains) && (chainList[chain] != hbms)){
+		chain++;
+	}
+	if((chain == numChains) && (numChains < LTC6804_MAX_CHAINS)){
+		chainList[numChains++] = hbms;
+	}
+	hbms->lastXfer = osKernelSysTick() - pdMS_TO_TICKS(LTC6804_AWAKE_MS);	// Asleep as far as we know
+	LTC6804_linkInit(hbms);		// Fastest SPI clock allowed
+
 	// Initialize all the configuraiton groups
-	for(uint8_t current_board = 0; current_board < TOTAL_IC; current_board++){
+	for(uint8_t current_board = 0; current_board < hbms->numIC; current_board++){
 		(hbms->boardConfigs)[current_board][0] = (hinit[current_board].refon << 2) | (hinit[current_board].swtrd << 1) | (hinit[current_board].adcMode);
 		(hbms->boardConfigs)[current_board][1] = hinit[current_board].vuv & 0xFF;
 		(hbms->boardConfigs)[current_board][2] = ((hinit[current_board].vuv >> 8) & 0x0F) | ((hinit[current_board].vov << 4) & 0xF0);
-		(hbms->boardConfigs)[current_board][3] = (hinit[current_board].vov << 4);
+		(hbms->boardConfigs)[current_board][3] = (hinit[current_board].vov >> 4) & 0xFF;
 		(hbms->boardConfigs)[current_board][4] = hinit[current_board].dcc & 0xFF;
 		(hbms->boardConfigs)[current_board][5] = (hinit[current_board].dcc >> 8) | (hinit[current_board].dcto << 4);
 	}
-	LTC6804_wrcfg(hbms);	// Write configurations to the board
+	hbms->cfgStale = 0xFFFFFFFF;	// Nothing verified on the chips yet
+	if(LTC6804_cfgSync(hbms) != 1){	// Write and verify the configurations
+		retVal = 4;
+	}
 
 	// Global ADC settings
 	set_adc(hbms, MD_NORMAL,DCP_DISABLED,CELL_CH_ALL,AUX_CH_ALL);
@@ -52,13 +427,69 @@ uint8_t LTC68041_Initialize(ltc68041ChainHandle * hbms, ltc68041ChainInitStruct
 		retVal = 3;
 	}
 
+	if(retVal){
+		hbms->health.initFails++;
+	}
 	return retVal;
 }
 
 
+#if (LTC6804_PEC_BACKEND == PEC_BACKEND_TABLE)
+// PEC15 lookup table for x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1
+static const uint16_t crc15Table[256] = {
+	0x0000, 0xC599, 0xCEAB, 0x0B32, 0xD8CF, 0x1D56, 0x1664, 0xD3FD,
+	0xF407, 0x319E, 0x3AAC, 0xFF35, 0x2CC8, 0xE951, 0xE263, 0x27FA,
+	0xAD97, 0x680E, 0x633C, 0xA6A5, 0x7558, 0xB0C1, 0xBBF3, 0x7E6A,
+	0x5990, 0x9C09, 0x973B, 0x52A2, 0x815F, 0x44C6, 0x4FF4, 0x8A6D,
+	0x5B2E, 0x9EB7, 0x9585, 0x501C, 0x83E1, 0x4678, 0x4D4A, 0x88D3,
+	0xAF29, 0x6AB0, 0x6182, 0xA41B, 0x77E6, 0xB27F, 0xB94D, 0x7CD4,
+	0xF6B9, 0x3320, 0x3812, 0xFD8B, 0x2E76, 0xEBEF, 0xE0DD, 0x2544,
+	0x02BE, 0xC727, 0xCC15, 0x098C, 0xDA71, 0x1FE8, 0x14DA, 0xD143,
+	0xF3C5, 0x365C, 0x3D6E, 0xF8F7, 0x2B0A, 0xEE93, 0xE5A1, 0x2038,
+	0x07C2, 0xC25B, 0xC969, 0x0CF0, 0xDF0D, 0x1A94, 0x11A6, 0xD43F,
+	0x5E52, 0x9BCB, 0x90F9, 0x5560, 0x869D, 0x4304, 0x4836, 0x8DAF,
+	0xAA55, 0x6FCC, 0x64FE, 0xA167, 0x729A, 0xB703, 0xBC31, 0x79A8,
+	0xA8EB, 0x6D72, 0x6640, 0xA3D9, 0x7024, 0xB5BD, 0xBE8F, 0x7B16,
+	0x5CEC, 0x9975, 0x9247, 0x57DE, 0x8423, 0x41BA, 0x4A88, 0x8F11,
+	0x057C, 0xC0E5, 0xCBD7, 0x0E4E, 0xDDB3, 0x182A, 0x1318, 0xD681,
+	0xF17B, 0x34E2, 0x3FD0, 0xFA49, 0x29B4, 0xEC2D, 0xE71F, 0x2286,
+	0xA213, 0x678A, 0x6CB8, 0xA921, 0x7ADC, 0xBF45, 0xB477, 0x71EE,
+	0x5614, 0x938D, 0x98BF, 0x5D26, 0x8EDB, 0x4B42, 0x4070, 0x85E9,
+	0x0F84, 0xCA1D, 0xC12F, 0x04B6, 0xD74B, 0x12D2, 0x19E0, 0xDC79,
+	0xFB83, 0x3E1A, 0x3528, 0xF0B1, 0x234C, 0xE6D5, 0xEDE7, 0x287E,
+	0xF93D, 0x3CA4, 0x3796, 0xF20F, 0x21F2, 0xE46B, 0xEF59, 0x2AC0,
+	0x0D3A, 0xC8A3, 0xC391, 0x0608, 0xD5F5, 0x106C, 0x1B5E, 0xDEC7,
+	0x54AA, 0x9133, 0x9A01, 0x5F98, 0x8C65, 0x49FC, 0x42CE, 0x8757,
+	0xA0AD, 0x6534, 0x6E06, 0xAB9F, 0x7862, 0xBDFB, 0xB6C9, 0x7350,
+	0x51D6, 0x944F, 0x9F7D, 0x5AE4, 0x8919, 0x4C80, 0x47B2, 0x822B,
+	0xA5D1, 0x6048, 0x6B7A, 0xAEE3, 0x7D1E, 0xB887, 0xB3B5, 0x762C,
+	0xFC41, 0x39D8, 0x32EA, 0xF773, 0x248E, 0xE117, 0xEA25, 0x2FBC,
+	0x0846, 0xCDDF, 0xC6ED, 0x0374, 0xD089, 0x1510, 0x1E22, 0xDBBB,
+	0x0AF8, 0xCF61, 0xC453, 0x01CA, 0xD237, 0x17AE, 0x1C9C, 0xD905,
+	0xFEFF, 0x3B66, 0x3054, 0xF5CD, 0x2630, 0xE3A9, 0xE89B, 0x2D02,
+	0xA76F, 0x62F6, 0x69C4, 0xAC5D, 0x7FA0, 0xBA39, 0xB10B, 0x7492,
+	0x5368, 0x96F1, 0x9DC3, 0x585A, 0x8BA7, 0x4E3E, 0x450C, 0x8095
+};
+#endif
+
 /*!**********************************************************
  \brief calaculates  and returns the CRC15
 
+  The backend is selected at compile time with LTC6804_PEC_BACKEND:
+
+  PEC_BACKEND_TABLE (default): byte-wise 256-entry table lookup. Reentrant, so
+  any task can compute a PEC without going through the shared CRC peripheral.
+  On the host it takes 2-6 cycles/byte, 6 to 15 times fewer than the bitwise
+  datasheet loop (make -C test bench, bench_pec). The PECs computed at run time are mostly
+  for 2 to 6 byte messages, where the CRC unit would pay HAL_CRC_Calculate()'s
+  lock and reset on every call.
+
+  PEC_BACKEND_HW: STM32 CRC unit running the 16-bit polynomial
+  (x + 1)(x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1) = 0x14EAB with
+  init value 0x20 (the PEC seed 16 pre-shifted by one). The 16-bit remainder
+  is folded back modulo the PEC15 polynomial, which gives the same result as
+  the table backend for every input.
+
   @param[in] uint8_t len: the length of the data array being passed to the function
 
   @param[in] uint8_t data[] : the array of data that the PEC will be generated from
@@ -70,30 +501,206 @@ inline uint16_t pec15_calc(uint8_t len, //Number of bytes that will be used to c
 					uint8_t *data //Array of data that will be used to calculate  a PEC
 					)
 {
-	return HAL_CRC_Calculate(&hcrc , (uint32_t*)(data), len);	// Use STM32's CRC peripheral
+	TRACE_BEGIN(TRACE_PEC15);
+#if (LTC6804_PEC_BACKEND == PEC_BACKEND_HW)
+	uint16_t remainder;
+
+	remainder = HAL_CRC_Calculate(&hcrc , (uint32_t*)(data), len);	// Use STM32's CRC peripheral
+
+	// Fold the (x + 1) * PEC15 remainder back into PEC15
+	if(remainder & 0x8000)
+	{
+		remainder ^= 0xC599;
+	}
+	if(remainder & 0x0001)
+	{
+		remainder ^= 0xC599;
+	}
+	TRACE_END(TRACE_PEC15);
+	return remainder;
+#else
+	uint16_t remainder = 16;	// PEC seed
+	uint8_t addr;
+
+	for(uint8_t i = 0; i < len; i++)
+	{
+		addr = ((remainder >> 7) ^ data[i]) & 0xFF;		// Calculate PEC table address
+		remainder = (remainder << 8) ^ crc15Table[addr];
+	}
+	TRACE_END(TRACE_PEC15);
+	return (remainder * 2);		// The CRC15 has a 0 in the LSB so the remainder must be multiplied by 2
+#endif
+}
+
+/***********************************************//**
+ \brief Checks the selected PEC backend against known answers
+
+ Run once by LTC68041_Initialize(): a misconfigured CRC unit (PEC_BACKEND_HW)
+ or a corrupted table would otherwise fail every transfer with PEC errors.
+ The answers come from the datasheet's bitwise algorithm (RDCFG and WRCFG are
+ the datasheet's own examples).
+
+ @return uint8_t, 1: every vector matches, 0: the backend is broken
+ *************************************************/
+static uint8_t LTC6804_pecCheck(void)
+{
+	static const uint8_t group[REG_BYTES] __attribute__((aligned(4))) = {0xF8, 0xFF, 0x00, 0x00, 0xA5, 0x5A};
+
+	return((pec15_calc(2, (uint8_t *)cmdRDCFG) == 0x2B0A) &&
+			(pec15_calc(2, (uint8_t *)cmdWRCFG) == 0x3D6E) &&
+			(pec15_calc(REG_BYTES, (uint8_t *)group) == 0x3D2A));
+}
+
+/***********************************************//**
+ \brief Checks the PEC of one IC's register group as received
+ *************************************************/
+static uint8_t LTC6804_pecOk(const uint8_t * rx)
+{
+	return(pec15_calc(REG_BYTES, (uint8_t *)rx) == (((uint16_t)rx[REG_BYTES] << 8) | rx[REG_BYTES + 1]));
+}
+
+/***********************************************//**
+ \brief Unpacks and PEC-checks one register group of every IC in one pass
+
+ Each IC's 8 bytes (3 little endian codes + big endian PEC) are fetched as one
+ word and two halfwords. The codes are stored from the word directly, and with
+ the table backend the PEC is computed from the same registers instead of a
+ second pass over the buffer. The Rx slots start 4-byte aligned (see
+ LTC68041_CHAIN_STORAGE) so the fetches are single aligned loads. On the host
+ a 32 IC RDCVA-RDCVD parse takes about 1.5x fewer cycles than the separate
+ unpack and pec15_calc() loops it replaced (make -C test bench, bench_parse).
+
+ @param[in] const uint8_t * rx; First data byte of IC 0 (past the CMD_LEN command echo)
+
+ @param[in] uint8_t numIC; Number of ICs in the group (at most 32)
+
+ @param[out] uint16_t * dst; Destination of IC 0's 3 codes
+
+ @param[in] uint8_t stride; Codes per IC row of dst (12 for cellVolts, REG_BYTES for auxVolts)
+
+ @return uint32_t, PEC error mask: bit n set if IC n failed the PEC check
+ *************************************************/
+static uint32_t LTC6804_parseGroup(const uint8_t * rx, uint8_t numIC, uint16_t * dst, uint8_t stride)
+{
+	uint32_t pec_errors = 0;
+	uint32_t codes01;				// Codes 1 and 2 (little endian core, so no byte swap)
+	uint16_t code2;					// Code 3
+	uint16_t received_pec;
+	uint16_t data_pec;
+
+	for(uint8_t current_ic = 0; current_ic < numIC; current_ic++)
+	{
+		memcpy(&codes01, rx, 4);
+		memcpy(&code2, rx + 4, 2);
+		memcpy(&received_pec, rx + REG_BYTES, 2);
+		received_pec = (uint16_t)__REV16(received_pec);			// The PEC is sent MSB first
+
+		dst[0] = (uint16_t)codes01;
+		dst[1] = (uint16_t)(codes01 >> 16);
+		dst[2] = code2;
+
+#if (LTC6804_PEC_BACKEND == PEC_BACKEND_TABLE)
+		data_pec = 16;	// PEC seed
+		data_pec = (data_pec << 8) ^ crc15Table[((data_pec >> 7) ^ codes01) & 0xFF];
+		data_pec = (data_pec << 8) ^ crc15Table[((data_pec >> 7) ^ (codes01 >> 8)) & 0xFF];
+		data_pec = (data_pec << 8) ^ crc15Table[((data_pec >> 7) ^ (codes01 >> 16)) & 0xFF];
+		data_pec = (data_pec << 8) ^ crc15Table[((data_pec >> 7) ^ (codes01 >> 24)) & 0xFF];
+		data_pec = (data_pec << 8) ^ crc15Table[((data_pec >> 7) ^ code2) & 0xFF];
+		data_pec = (data_pec << 8) ^ crc15Table[((data_pec >> 7) ^ (code2 >> 8)) & 0xFF];
+		data_pec = data_pec * 2;
+#else
+		data_pec = pec15_calc(REG_BYTES, (uint8_t *)rx);
+#endif
+		if(received_pec != data_pec)
+		{
+			pec_errors |= (1UL << current_ic);
+		}
+
+		rx += BYTES_IN_REG;
+		dst += stride;
+	}
+	return pec_errors;
+}
+
+/***********************************************//**
+ \brief Records the PEC result of one register group read in the telemetry
+
+ Updates the group's bit in every IC's pecMap and counts the errors in
+ pecCount.
+
+ @param[in] uint8_t grp; LTC6804_GRP_*
+
+ @param[in] uint32_t errIC; ICs that failed the PEC check (bit n = IC n)
+
+ @return uint32_t, errIC
+ *************************************************/
+static uint32_t LTC6804_pecNote(ltc68041ChainHandle * hbms, uint8_t grp, uint32_t errIC)
+{
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		if(errIC & (1UL << ic))
+		{
+			(hbms->pecMap)[ic] |= (1U << grp);
+			(hbms->pecCount)[ic][grp]++;
+		}
+		else
+		{
+			(hbms->pecMap)[ic] &= ~(1U << grp);
+		}
+	}
+	return errIC;
+}
+
+/***********************************************//**
+ \brief Returns the ICs whose last read of a register group failed PEC
+
+ @param[in] uint8_t grp; LTC6804_GRP_*
+
+ @return uint32_t, bit n set if IC n failed (0: group clean)
+ *************************************************/
+uint32_t LTC6804_pecGroupIC(ltc68041ChainHandle * hbms, uint8_t grp)
+{
+	uint32_t errIC = 0;
+
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		if((hbms->pecMap)[ic] & (1U << grp))
+		{
+			errIC |= (1UL << ic);
+		}
+	}
+	return errIC;
 }
 
 /*!****************************************************
   \brief Wake the LTC6804 from the sleep state
 
  Generic wakeup commannd to wake the LTC6804 from sleep
+ Skipped when the chain had traffic within LTC6804_AWAKE_MS.
  *****************************************************/
-void wakeup_sleep()
+void wakeup_sleep(ltc68041ChainHandle * hbms)
 {
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  osDelay(1); // Guarantees the LTC6804 will be in standby; soft delay
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_SET);
+  if((osKernelSysTick() - hbms->lastXfer) < pdMS_TO_TICKS(LTC6804_AWAKE_MS))
+  {
+    hbms->health.wakeSkips++;
+    return;
+  }
+  LTC6804_wakePulse(hbms, LTC6804_WAKE_SLEEP_US); // Guarantees the LTC6804 will be in standby
 }
 
 /*!****************************************************
   \brief Wake isoSPI up from idle state
  Generic wakeup commannd to wake isoSPI up out of idle
+ Skipped when the chain had traffic within LTC6804_AWAKE_MS.
  *****************************************************/
-void wakeup_idle()
+void wakeup_idle(ltc68041ChainHandle * hbms)
 {
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  delayUs(2); //Guarantees the isoSPI will be in ready mode
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_SET);
+  if((osKernelSysTick() - hbms->lastXfer) < pdMS_TO_TICKS(LTC6804_AWAKE_MS))
+  {
+    hbms->health.wakeSkips++;
+    return;
+  }
+  LTC6804_wakePulse(hbms, LTC6804_WAKE_IDLE_US); // Guarantees the isoSPI will be in ready mode
 }
 
 
@@ -116,7 +723,9 @@ block of the array, the second IC in the second 8 byte etc. Below is an table il
 
 	0: Data read back has matching PEC
 
-	-1: Data read back has incorrect PEC
+	-1: Data read back has incorrect PEC on some IC (pecErrIC); those ICs keep their previous boardConfigs
+
+	-2: Transfer failed (DMA error or timeout)
 
 
 Command Code:
@@ -128,57 +737,50 @@ Command Code:
 ********************************************************/
 int8_t LTC6804_rdcfg(ltc68041ChainHandle * hbms)
 {
-  int8_t pec_error = 0;
-  uint16_t data_pec;
-  uint16_t received_pec;
+  uint32_t pec_errors = 0;
+  const uint8_t * rx;
+  TRACE_BEGIN(TRACE_RDCFG);
 
   //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
   // RDCFG + pec15
-  (hbms->spiTxBuf)[0] = 0x00;
-  (hbms->spiTxBuf)[1] = 0x02;
-  (hbms->spiTxBuf)[2] = 0x2b;
-  (hbms->spiTxBuf)[3] = 0x0A;
+  memcpy(hbms->spiTxBuf, cmdRDCFG, CMD_LEN);
 
   //2
-  wakeup_idle(); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
 
   //3
-  // Wait for the SPI peripheral to finish TXing if it's busy
-  while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-		  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX))){
-	  osDelay(1);
-  }
   // Flush spi Rx FIFO
-  	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-  		uint32_t garbage = hbms->hspi->Instance->DR;
-  	}
+  LTC6804_rxFlush(hbms);
 
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + BYTES_IN_REG * TOTAL_IC );
+  LTC6804_xferArm(hbms);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + BYTES_IN_REG * hbms->numIC );
   //Read the configuration data of all ICs on the daisy chain into the handle's storage arrays
 
-  // Suspend until we get the semaphore that the transmission is
-  xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
-  for (uint8_t current_ic = 0; current_ic < TOTAL_IC; current_ic++) 			//executes for each LTC6804 in the daisy chain and packs the data
+  // Suspend until the ISR notifies that the transmission is complete
+  if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+  {
+    return(-2);														// Transfer failed, nothing to parse
+  }
+  for (uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++) 			//executes for each LTC6804 in the daisy chain and packs the data
   { 																			//into the r_config array as well as check the received Config data
 																				//for any bit errors
+    rx = &((hbms->spiRxBuf)[CMD_LEN + (current_ic*BYTES_IN_REG)]);
 	//4.a
-    for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG; current_byte++)
+    if(!LTC6804_pecOk(rx))
     {
-      (hbms->boardConfigs)[current_ic][current_byte] = (hbms->spiRxBuf)[current_byte + CMD_LEN + (current_ic*BYTES_IN_REG)];
+      pec_errors |= (1UL << current_ic);
+      continue;																// Don't terminate on a bad PEC, keep the IC's configuration as it was
     }
     //4.b
-    received_pec = ((hbms->boardConfigs)[current_ic][6]<<8) + (hbms->boardConfigs)[current_ic][7];	// Extract the last 2 bytes of the received data buffer
-    data_pec = pec15_calc(6, &((hbms->boardConfigs)[current_ic][0]));
-    if(received_pec != data_pec)
-    {
-      pec_error = -1 * current_ic;
-      // Don't terminate on a bad PEC
-    }
+    memcpy((hbms->boardConfigs)[current_ic], rx, REG_BYTES);
   }
 
   //5
-  return(pec_error);
+  hbms->pecErrIC = LTC6804_pecNote(hbms, LTC6804_GRP_CFG, pec_errors);
+  TRACE_END(TRACE_RDCFG);
+  return(pec_errors ? -1 : 0);
 }
 /*
 	RDCFG Sequence:
@@ -187,14 +789,73 @@ int8_t LTC6804_rdcfg(ltc68041ChainHandle * hbms)
 	2. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
 	3. Send command and read back configuration data
 	4. For each LTC6804 in the daisy chain
-	  a. load configuration data into r_config array
-	  b. calculate PEC of received data and compare against calculated PEC
-	5. Return PEC Error
+	  a. calculate PEC of received data and compare against calculated PEC
+	  b. load configuration data into r_config array if it is intact
+	5. Record the failing ICs (pecErrIC, pecMap) and return PEC Error
 
 */
 
 
 
+/***********************************************//**
+ \brief Returns the discharge (DCC) bits of one IC's configuration
+
+ @return uint16_t, bit n set if cell n + 1 is discharged
+ *************************************************/
+uint16_t LTC6804_getDcc(ltc68041ChainHandle * hbms, uint8_t ic)
+{
+	return((hbms->boardConfigs)[ic][4] | (((uint16_t)(hbms->boardConfigs)[ic][5] & 0x0F) << 8));
+}
+
+/***********************************************//**
+ \brief Sets the discharge (DCC) bits of one IC's configuration
+
+ Only boardConfigs is changed; the cells are discharged once the
+ configuration is written with LTC6804_wrcfg().
+
+ @param[in] uint16_t dcc; bit n set to discharge cell n + 1
+ *************************************************/
+void LTC6804_setDcc(ltc68041ChainHandle * hbms, uint8_t ic, uint16_t dcc)
+{
+	(hbms->boardConfigs)[ic][4] = dcc & 0xFF;
+	(hbms->boardConfigs)[ic][5] = ((hbms->boardConfigs)[ic][5] & 0xF0) | ((dcc >> 8) & 0x0F);
+}
+
+/***********************************************//**
+ \brief Builds a WRCFG transaction of every IC's boardConfigs into tx
+
+ LTC6804_XFER_LEN(numIC) bytes: the command, then each IC's configuration
+ and its PEC, the last IC of the chain first.
+ *************************************************/
+static void LTC6804_wrcfgFill(ltc68041ChainHandle * hbms, uint8_t * tx)
+{
+  uint16_t cfg_pec;
+  uint16_t cmd_index; //command counter
+
+  //1
+  // WRCFG + pec
+  memcpy(tx, cmdWRCFG, CMD_LEN);
+
+  //2
+  cmd_index = 4;
+  for (uint8_t current_ic = hbms->numIC; current_ic > 0; current_ic--) 			// executes for each LTC6804 in daisy chain, this loops starts with
+  {																				// the last IC on the stack. The first configuration written is
+																				// received by the last IC in the daisy chain
+
+    for (uint8_t current_byte = 0; current_byte < REG_BYTES; current_byte++) 	// executes for each of the 6 bytes in the CFGR register
+    {																			// current_byte is the byte counter
+
+    	tx[cmd_index] = (hbms->boardConfigs)[current_ic-1][current_byte]; 		//adding the config data to the array to be sent
+      cmd_index = cmd_index + 1;
+    }
+	//3
+    cfg_pec = (uint16_t)pec15_calc(REG_BYTES, &((hbms->boardConfigs)[current_ic-1][0]));		// calculating the PEC for each ICs configuration register data
+    tx[cmd_index] = (uint8_t)(cfg_pec >> 8);
+    tx[cmd_index + 1] = (uint8_t)cfg_pec;
+    cmd_index = cmd_index + 2;
+  }
+}
+
 /*****************************************************//**
  \brief Write the LTC6804 configuration register
 
@@ -225,48 +886,21 @@ Command Code:
 ********************************************************/
 void LTC6804_wrcfg(ltc68041ChainHandle * hbms)
 {
-  uint16_t cfg_pec;
-  uint8_t cmd_index; //command counter
-
-  //1
-  // WRCFG + pec
-  (hbms->spiTxBuf)[0] = 0x00;
-  (hbms->spiTxBuf)[1] = 0x01;
-  (hbms->spiTxBuf)[2] = 0x3d;
-  (hbms->spiTxBuf)[3] = 0x6e;
+  TRACE_BEGIN(TRACE_WRCFG);
 
-  //2
-  cmd_index = 4;
-  for (uint8_t current_ic = TOTAL_IC; current_ic > 0; current_ic--) 			// executes for each LTC6804 in daisy chain, this loops starts with
-  {																				// the last IC on the stack. The first configuration written is
-																				// received by the last IC in the daisy chain
+  //1, 2, 3
+  LTC6804_spiWaitIdle(hbms);													// A write-only command may still be sending from spiTxBuf
+  LTC6804_wrcfgFill(hbms, hbms->spiTxBuf);
 
-    for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG; current_byte++) // executes for each of the 6 bytes in the CFGR register
-    {																			// current_byte is the byte counter
-
-    	(hbms->spiTxBuf)[cmd_index] = (hbms->boardConfigs)[current_ic-1][current_byte]; 						//adding the config data to the array to be sent
-      cmd_index = cmd_index + 1;
-    }
-	//3
-    cfg_pec = (uint16_t)pec15_calc(BYTES_IN_REG, &((hbms->boardConfigs)[current_ic-1][0]));		// calculating the PEC for each ICs configuration register data
-    (hbms->spiTxBuf)[cmd_index] = (uint8_t)(cfg_pec >> 8);
-    (hbms->spiTxBuf)[cmd_index + 1] = (uint8_t)cfg_pec;
-    cmd_index = cmd_index + 2;
-  }
-
-  //4
-  wakeup_idle (); 															 	//This will guarantee that the LTC6804 isoSPI port is awake.This command can be removed.
+  //4
+  wakeup_idle(hbms); 															 	//This will guarantee that the LTC6804 isoSPI port is awake.This command can be removed.
 
   //5
   // Wait for the SPI peripheral to finish TXing if it's busy
-  while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-	  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-  {
-	  osDelay(1);
-  }
+  LTC6804_spiWaitIdle(hbms);
   // Transmit the command via DMA
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  HAL_SPI_Transmit_DMA(hbms->hspi, hbms->spiTxBuf, CMD_LEN+(8*TOTAL_IC));
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN+(BYTES_IN_REG*hbms->numIC));
+  TRACE_END(TRACE_WRCFG);
 }
 /*
 	WRCFG Sequence:
@@ -297,30 +931,21 @@ Command Code:
 void LTC6804_clraux(ltc68041ChainHandle * hbms)
 {
   //1 - CLRAUX + pec
-  (hbms->spiTxBuf)[0] = 0x07;
-  (hbms->spiTxBuf)[1] = 0x12;
-  (hbms->spiTxBuf)[2] = 0x3d;
-  (hbms->spiTxBuf)[3] = 0x6e;
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, cmdCLRAUX, CMD_LEN);
 
   //3
-  wakeup_idle (); //This will guarantee that the LTC6804 isoSPI port is awake.This command can be removed.
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake.This command can be removed.
 
   //4
-  // Wait for the SPI peripheral to finish TXing if it's busy
-  while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-    (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-  {
-    osDelay(1);
-  }
   // Transmit the command via DMA
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  HAL_SPI_Transmit_DMA(hbms->hspi, hbms->spiTxBuf, CMD_LEN);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
 }
 /*
   LTC6804_clraux Function sequence:
 
-  1. Load clraux command into cmd array
-  2. Calculate clraux cmd PEC and load pec into cmd array
+  1. Load clraux command and its precomputed PEC into cmd array
   3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
   4. send broadcast clraux command to LTC6804 daisy chain
 */
@@ -343,30 +968,21 @@ Command Code:
 void LTC6804_clrcell(ltc68041ChainHandle * hbms)
 {
   //1 - CLRCELL + pec
-  (hbms->spiTxBuf)[0] = 0x07;
-  (hbms->spiTxBuf)[1] = 0x11;
-  (hbms->spiTxBuf)[2] = 0xc9;
-  (hbms->spiTxBuf)[3] = 0xc0;
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, cmdCLRCELL, CMD_LEN);
 
   //3
-  wakeup_idle (); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
 
   //4
-  // Wait for the SPI peripheral to finish TXing if it's busy
-  while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-       (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-  {
-    osDelay(1);
-  }
   // Transmit the command via DMA
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  HAL_SPI_Transmit_DMA(hbms->hspi, hbms->spiTxBuf, CMD_LEN);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
 }
 /*
   LTC6804_clrcell Function sequence:
 
-  1. Load clrcell command into cmd array
-  2. Calculate clrcell cmd PEC and load pec into cmd array
+  1. Load clrcell command and its precomputed PEC into cmd array
   3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
   4. send broadcast clrcell command to LTC6804 daisy chain
 */
@@ -404,48 +1020,31 @@ Command Code:
  *************************************************/
 void LTC6804_rdaux_reg(ltc68041ChainHandle * hbms, uint8_t reg)
 {
-  uint16_t cmd_pec;
-
   //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
   if(reg == 2)		// Read back auxiliary group B
   {
-	  (hbms->spiTxBuf)[1] = 0x0e;
-	  (hbms->spiTxBuf)[0] = 0x00;
+	  memcpy(hbms->spiTxBuf, cmdRDAUX[1], CMD_LEN);
   }
   else				// Read back auxiliary group A
   {
-	  (hbms->spiTxBuf)[1] = 0x0C;
-	  (hbms->spiTxBuf)[0] = 0x00;
+	  memcpy(hbms->spiTxBuf, cmdRDAUX[0], CMD_LEN);
   }
 
-  //2
-  cmd_pec = pec15_calc(2, (hbms->spiTxBuf));
-  (hbms->spiTxBuf)[2] = (uint8_t)((cmd_pec >> 8) & 0xFF);
-  (hbms->spiTxBuf)[3] = (uint8_t)((cmd_pec) & 0xFF);
-
   //3
-  wakeup_idle (); //This will guarantee that the LTC6804 isoSPI port is awake, this command can be removed.
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake, this command can be removed.
 
   //4
-  // Wait for the SPI peripheral to finish TXing if it's busy
-  while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-       (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-  {
-    osDelay(1);
-  }
-
   // Transmit the command via DMA
   // Flush spi Rx FIFO
-  	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-  		uint32_t garbage = hbms->hspi->Instance->DR;
-  	}
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + (BYTES_IN_REG*TOTAL_IC));
+  LTC6804_rxFlush(hbms);
+  LTC6804_xferArm(hbms);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + (BYTES_IN_REG*hbms->numIC));
 }
 /*
   LTC6804_rdaux_reg Function Process:
-  1. Determine Command and initialize command array
-  2. Calculate Command PEC
+  1. Determine Command and copy it with its precomputed PEC into the command array
   3. Wake up isoSPI, this step is optional
   4. Send Global Command to LTC6804 daisy chain
 */
@@ -485,728 +1084,2570 @@ Command Code:
  *************************************************/
 void LTC6804_rdcv_reg(ltc68041ChainHandle * hbms, uint8_t reg) 	//Determines which cell voltage register is read back
 {
-  uint16_t cmd_pec;
-
   //1
-  if (reg == 1)     //1: RDCVA
-  {
-    (hbms->spiTxBuf)[1] = 0x04;
-    (hbms->spiTxBuf)[0] = 0x00;
-  }
-  else if(reg == 2) //2: RDCVB
-  {
-	  (hbms->spiTxBuf)[1] = 0x06;
-	  (hbms->spiTxBuf)[0] = 0x00;
-  }
-  else if(reg == 3) //3: RDCVC
-  {
-	  (hbms->spiTxBuf)[1] = 0x08;
-	  (hbms->spiTxBuf)[0] = 0x00;
-  }
-  else if(reg == 4) //4: RDCVD
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  if ((reg >= 1) && (reg <= NUM_CV_REG))     //1: RDCVA, 2: RDCVB, 3: RDCVC, 4: RDCVD
   {
-	  (hbms->spiTxBuf)[1] = 0x0A;
-	  (hbms->spiTxBuf)[0] = 0x00;
+    memcpy(hbms->spiTxBuf, cmdRDCV[reg - 1], CMD_LEN);
   }
 
-  //2
-  cmd_pec = pec15_calc(2, (hbms->spiTxBuf));
-  (hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-  (hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
-
   //3
-  wakeup_idle (); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
 
   //4
-  // Wait for the SPI peripheral to finish TXing if it's busy
-  while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-    		(HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-  {
-      osDelay(1);
-  }
-
   // Flush spi Rx FIFO
-  	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-  		uint32_t garbage = hbms->hspi->Instance->DR;
-  	}
+  LTC6804_rxFlush(hbms);
   // Transmit the command via DMA
-  HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-  HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + (BYTES_IN_REG*TOTAL_IC));
+  LTC6804_xferArm(hbms);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + (BYTES_IN_REG*hbms->numIC));
 }
 /*
   LTC6804_rdcv_reg Function Process:
-  1. Determine Command and initialize command array
-  2. Calculate Command PEC
+  1. Determine Command and copy it with its precomputed PEC into the command array
   3. Wake up isoSPI, this step is optional
   4. Send Global Command to LTC6804 daisy chain
 */
 
 /***********************************************//**
- \brief Reads and parses the LTC6804 cell voltage registers.
-
- The function is used to read the cell codes of the LTC6804.
- This function will send the requested read commands parse the data
- and store the cell voltages in cell_codes variable.
-
- @param[in] uint8_t reg; This controls which cell voltage register is read back.
-
-          0: Read back all Cell registers
-
-          1: Read back cell group A
+ \brief Starts a pipelined job list of register group reads
 
-          2: Read back cell group B
+ The reads are queued as one job list. Every read gets its own
+ LTC6804_XFER_LEN(numIC) slot in spiTxBuf and spiRxBuf; the first transaction
+ is started here and each following one is chained from
+ LTC6804_SPI_TxRxCpltCallback(), so the calling task only blocks once for the
+ whole list. Read n is found at spiRxBuf[n * LTC6804_XFER_LEN(numIC)].
 
-          3: Read back cell group C
+ @param[in] const uint8_t * const cmds[]; Read commands with their PEC, one per stage
 
-          4: Read back cell group D
+ @param[in] uint8_t stages; Number of reads, at most LTC6804_PIPE_STAGES
+ *************************************************/
+static void LTC6804_pipeStart(ltc68041ChainHandle * hbms, const uint8_t * const cmds[], uint8_t stages)
+{
+  //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  for(uint8_t stage = 0; stage < stages; stage++)
+  {
+	  memcpy(&((hbms->spiTxBuf)[stage * LTC6804_XFER_LEN(hbms->numIC)]), cmds[stage], CMD_LEN);
+  }
 
- @param[in] uint8_t total_ic; This is the number of ICs in the daisy chain(-1 only)
+  //3
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
 
- @param[out] uint16_t cell_codes[]; An array of the parsed cell codes from lowest to highest. The cell codes will
-  be stored in the cell_codes[] array in the following format:
-  |  cell_codes[0][0]| cell_codes[0][1] |  cell_codes[0][2]|    .....     |  cell_codes[0][11]|  cell_codes[1][0] | cell_codes[1][1]|  .....   |
-  |------------------|------------------|------------------|--------------|-------------------|-------------------|-----------------|----------|
-  |IC1 Cell 1        |IC1 Cell 2        |IC1 Cell 3        |    .....     |  IC1 Cell 12      |IC2 Cell 1         |IC2 Cell 2       | .....    |
+  //4
+  // Flush spi Rx FIFO
+  LTC6804_rxFlush(hbms);
+  // Queue the job list and transmit the first command via DMA
+  hbms->xferStage = 0;
+  hbms->xferStages = stages;
+  LTC6804_xferArm(hbms);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, hbms->spiRxBuf, LTC6804_XFER_LEN(hbms->numIC));
+}
+/*
+  LTC6804_pipeStart Function Process:
+  1. Load every read command with its precomputed PEC into its own Tx slot
+  3. Wake up isoSPI, this step is optional
+  4. Queue the job list and send the first command; the rest is chained from the ISR
+*/
 
-  @return int8_t, PEC Status.
+/***********************************************//**
+ \brief Compares configuration groups read back with RDCFG against ref
 
-		0: No PEC error detected
+ Only the bits that read back what was written are compared: the GPIO pull-down
+ bits of CFGR0 read the pin levels, SWTRD is a read-only pin state and DCTO reads
+ the time left on the discharge timer.
 
-		-1: PEC error detected, retry read
+ @param[in] const uint8_t * rx; First IC's group in spiRxBuf
 
+ @param[in] const uint8_t (*ref)[REG_BYTES]; Expected configuration of each IC
 
+ @return uint32_t, ICs that failed the PEC check or differ (bit n = IC n)
  *************************************************/
-uint8_t LTC6804_rdcv(ltc68041ChainHandle * hbms, uint8_t reg)
+static uint32_t LTC6804_cfgCheck(ltc68041ChainHandle * hbms, const uint8_t * rx, const uint8_t (*ref)[REG_BYTES])
 {
-	uint8_t pec_error = 0;
-	uint16_t parsed_cell;
-	uint16_t received_pec;
-	uint16_t data_pec;
-	uint8_t data_counter = 0; //data counter
-	//1.a
-	if (reg == 0)	// Read back all registers
+	static const uint8_t cfgMask[REG_BYTES] = {0x05, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+	uint32_t bad = 0;
+
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++, rx += BYTES_IN_REG)
 	{
-		//a.i
-		for(uint8_t cell_reg = 1; cell_reg<5; cell_reg++)         			 			//executes once for each of the LTC6804 cell voltage registers
+		if(!LTC6804_pecOk(rx))
 		{
-		  data_counter = 0;								// Reset the counter at every cycle
-		  LTC6804_rdcv_reg(hbms, cell_reg);												// Reads a single Cell voltage register
-		  xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);							// Only proceeds when data is received
-
-		  for (uint8_t current_ic = 0 ; current_ic < TOTAL_IC; current_ic++) 			// executes for every LTC6804 in the daisy chain
-		  {																 	  			// current_ic is used as the IC counter
-			//a.ii
-			for(uint8_t current_cell = 0; current_cell<CELL_IN_REG; current_cell++)	 	// This loop parses the read back data into cell voltages, it
-			{														   		  			// loops once for each of the 3 cell voltage codes in the register
-			  // The data offset is CMD_LEN to offset the data received during TX
-			  parsed_cell = (hbms->spiRxBuf)[data_counter + CMD_LEN] + \
-					  ((hbms->spiRxBuf)[data_counter + CMD_LEN + 1] << 8);				 // uint8_t combine into uint16_t
-
-			  (hbms->cellVolts)[current_ic][current_cell  + ((cell_reg - 1) * CELL_IN_REG)] = parsed_cell;
-			  data_counter += 2;														 // Increment by 2 for uint16_t type
-			}
-			//a.iii
-			// Last 2 bytes of the received data is the PEC
-			received_pec = ((hbms->spiRxBuf)[data_counter + CMD_LEN] << 8) + (hbms->spiRxBuf)[data_counter + CMD_LEN + 1];
-			data_pec = pec15_calc(REG_BYTES, &((hbms->spiRxBuf)[CMD_LEN + current_ic * BYTES_IN_REG]));
-
-			if(received_pec != data_pec)
+			bad |= (1U << ic);
+			continue;
+		}
+		for(uint8_t byte = 0; byte < REG_BYTES; byte++)
+		{
+			if((rx[byte] ^ ref[ic][byte]) & cfgMask[byte])
 			{
-			  pec_error = -1;															//The pec_error variable is simply set negative if any PEC errors
-																						//are detected in the serial data
+				bad |= (1U << ic);
+				break;
 			}
-			data_counter += 2;
-		  }
 		}
 	}
-	//1.b
-	else
+	return bad;
+}
+
+/***********************************************//**
+ \brief Returns the ICs whose configuration still has to be written
+
+ An IC is dirty when its boardConfigs differs from the configuration last
+ verified on it (cfgShadow), or when that is unknown (cfgStale).
+
+ @return uint32_t, Dirty ICs (bit n = IC n)
+ *************************************************/
+uint32_t LTC6804_cfgDirty(ltc68041ChainHandle * hbms)
+{
+	uint32_t dirty = hbms->cfgStale;
+
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
 	{
-		//b.i
-		LTC6804_rdcv_reg(hbms, reg);
-		xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);							// Only proceeds when data is received
-
-		for (uint8_t current_ic = 0 ; current_ic < TOTAL_IC; current_ic++) 				// executes for every LTC6804 in the daisy chain
-		{																 	  			// current_ic is used as the IC counter
-			//b.ii
-			for(uint8_t current_cell = 0; current_cell < CELL_IN_REG; current_cell++)   // This loop parses the read back data into cell voltages, it
-			{														   		  			// loops once for each of the 3 cell voltage codes in the register
-				 parsed_cell = (hbms->spiRxBuf)[data_counter + CMD_LEN] + \
-								((hbms->spiRxBuf)[data_counter + CMD_LEN + 1] << 8);	// uint8_t combine into uint16_t
-
-				(hbms->cellVolts)[current_ic][current_cell + ((reg - 1) * CELL_IN_REG)] = parsed_cell;
-				data_counter += 2;
-			}
-			//b.iii
-			received_pec = ((hbms->spiRxBuf)[data_counter + CMD_LEN] << 8) + (hbms->spiRxBuf)[data_counter + CMD_LEN + 1]; //The received PEC for the current_ic is transmitted as the 7th and 8th
-																						 //after the 6 cell voltage data bytes
-			data_pec = pec15_calc(REG_BYTES, &((hbms->spiRxBuf)[current_ic * BYTES_IN_REG]));
-			if(received_pec != data_pec)
-			{
-				pec_error = -1;															//The pec_error variable is simply set negative if any PEC errors
-																						//are detected in the serial data
-			}
-			data_counter += 2;
+		if(memcmp((hbms->boardConfigs)[ic], (hbms->cfgShadow)[ic], REG_BYTES))
+		{
+			dirty |= (1U << ic);
 		}
 	}
-	return(pec_error);
+	return dirty;
 }
-/*
-	LTC6804_rdcv Sequence
 
-	1. Switch Statement:
-		a. Reg = 0
-			i. Read cell voltage registers A-D for every IC in the daisy chain
-			ii. Parse raw cell voltage data in cell_codes array
-			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
-		b. Reg != 0
-			i.Read single cell voltage register for all ICs in daisy chain
-			ii. Parse raw cell voltage data in cell_codes array
-			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
-	2. Return pec_error flag
-*/
+/***********************************************//**
+ \brief Writes boardConfigs to the chain if any IC is dirty, and verifies it
 
+ Nothing is sent when LTC6804_cfgDirty() is 0, so it can be called every period.
+ Otherwise WRCFG and RDCFG go out as one job list (see LTC6804_pipeStart()) and
+ the read back is compared with boardConfigs. A PEC error or a mismatch repeats
+ the write, at most LTC6804_PEC_RETRIES times. The WRCFG is a daisy chain
+ write, so every IC gets its configuration rewritten, dirty or not.
 
+ @return int8_t, Write status.
 
-/*!*********************************************************************************************
-  \brief Starts cell voltage conversion
+		1: Configuration written and verified on every IC
 
-  Starts ADC conversions of the LTC6804 Cpin inputs.
-  The type of ADC conversion executed can be changed by setting the associated global variables:
- |Variable|Function                                      |
- |--------|----------------------------------------------|
- | MD     | Determines the filter corner of the ADC      |
- | CH     | Determines which cell channels are converted |
- | DCP    | Determines if Discharge is Permitted	     |
+		0: Nothing to write
 
-Command Code:
--------------
+		-1: Still mismatched after all retries (the ICs stay dirty)
 
-|CMD[0:1]	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
-|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
-|ADCV:	    |   0   |   0   |   0   |   0   |   0   |   0   |   1   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CH[2] | CH[1] | CH[0] |
-***********************************************************************************************/
-void LTC6804_adcv(ltc68041ChainHandle * hbms)
+		-2: Transfer failure
+ *************************************************/
+int8_t LTC6804_cfgSync(ltc68041ChainHandle * hbms)
 {
-  uint16_t cmd_pec;
+	static const uint8_t * const cmds[2] = {cmdWRCFG, cmdRDCFG};
+	uint32_t bad = 0;
 
-  //1
-  (hbms->spiTxBuf)[0] = (hbms->ADCV)[0];
-  (hbms->spiTxBuf)[1] = (hbms->ADCV)[1];
+	if(!LTC6804_cfgDirty(hbms))
+	{
+		return 0;
+	}
 
-  //2
-  cmd_pec = pec15_calc(2, hbms->ADCV);
-  (hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-  (hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
+	for(uint8_t attempt = 0; attempt <= LTC6804_PEC_RETRIES; attempt++)
+	{
+		if(attempt)
+		{
+			hbms->health.cfgRetries++;
+		}
+		//1
+		TRACE_BEGIN(TRACE_WRCFG);
+		LTC6804_spiWaitIdle(hbms);
+		LTC6804_wrcfgFill(hbms, hbms->spiTxBuf);
+
+		//2
+		LTC6804_pipeStart(hbms, cmds, 2);
+		TRACE_END(TRACE_WRCFG);
+		if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+		{
+			hbms->health.xferFails++;
+			return -2;
+		}
+		hbms->health.cfgWrites++;
 
-  //3
-  wakeup_idle (); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+		//3
+		bad = LTC6804_cfgCheck(hbms, &((hbms->spiRxBuf)[LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]), hbms->boardConfigs);
+		if(!bad)
+		{
+			memcpy(hbms->cfgShadow, hbms->boardConfigs, REG_BYTES * hbms->numIC);
+			hbms->cfgStale = 0;
+			return 1;
+		}
+	}
 
-  //4
-  // Wait for the SPI peripheral to finish TXing if it's busy
-   while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-     		(HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-   {
-       osDelay(1);
-   }
-   // Transmit the command via DMA
-   HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-   HAL_SPI_Transmit_DMA(hbms->hspi, hbms->spiTxBuf, CMD_LEN);
+	//4
+	hbms->cfgStale |= bad;
+	hbms->health.cfgFails++;
+	return -1;
 }
 /*
-  LTC6804_adcv Function sequence:
-
-  1. Load adcv command into cmd array
-  2. Calculate adcv cmd PEC and load pec into cmd array
-  3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
-  4. send broadcast adcv command to LTC6804 daisy chain
+  LTC6804_cfgSync Function Process:
+  1. Build the WRCFG transaction in the first Tx slot
+  2. Send WRCFG then RDCFG as one job list
+  3. Compare the read back with what was written; done when every IC matches
+  4. Otherwise retry, and leave the failing ICs stale for the next call
 */
 
+/***********************************************//**
+ \brief Reads the configuration back and rewrites it if a chip lost it
 
-/*!******************************************************************************************************
- \brief Start an GPIO Conversion
-
-  Starts an ADC conversions of the LTC6804 GPIO inputs.
-  The type of ADC conversion executed can be changed by setting the associated global variables:
- |Variable|Function                                      |
- |--------|----------------------------------------------|
- | MD     | Determines the filter corner of the ADC      |
- | CHG    | Determines which GPIO channels are converted |
-
-
-Command Code:
--------------
+ A chip that reset (power dip, watchdog timeout after 2s without commands)
+ comes back with its default configuration: REFON off, no thresholds and no
+ discharge. Call it every few periods. The read back is compared with the last
+ verified configuration (cfgShadow), so pending boardConfigs changes are not
+ counted as drift; they are written by the LTC6804_cfgSync() that follows.
 
-|CMD[0:1]	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
-|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
-|ADAX:	    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CHG[2]| CHG[1]| CHG[0]|
-*********************************************************************************************************/
-void LTC6804_adax(ltc68041ChainHandle * hbms)
+ @return int8_t, Same as LTC6804_cfgSync()
+ *************************************************/
+int8_t LTC6804_cfgScrub(ltc68041ChainHandle * hbms)
 {
-  uint16_t cmd_pec;
+	static const uint8_t * const cmds[1] = {cmdRDCFG};
+	uint32_t drift;
 
-  (hbms->spiTxBuf)[0] = hbms->ADAX[0];
-  (hbms->spiTxBuf)[1] = hbms->ADAX[1];
-  cmd_pec = pec15_calc(2, hbms->ADAX);
-  (hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-  (hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
+	//1
+	LTC6804_spiWaitIdle(hbms);
+	LTC6804_pipeStart(hbms, cmds, 1);
+	if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+	{
+		hbms->health.xferFails++;
+		return -2;
+	}
 
-  wakeup_idle (); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+	//2
+	drift = LTC6804_cfgCheck(hbms, &((hbms->spiRxBuf)[CMD_LEN]), hbms->cfgShadow) & ~(hbms->cfgStale);
+	if(drift)
+	{
+		hbms->health.cfgDrifts++;
+		hbms->cfgStale |= drift;
+	}
 
-  // Wait for the SPI peripheral to finish TXing if it's busy
-   while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-     		(HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX)))
-   {
-       osDelay(1);
-   }
-   // Transmit the command via DMA
-   HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-   HAL_SPI_Transmit_DMA(hbms->hspi, hbms->spiTxBuf, CMD_LEN);
+	//3
+	return LTC6804_cfgSync(hbms);
 }
 /*
-  LTC6804_adax Function sequence:
-
-  1. Load adax command into cmd array
-  2. Calculate adax cmd PEC and load pec into cmd array
-  3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
-  4. send broadcast adax command to LTC6804 daisy chain
+  LTC6804_cfgScrub Function Process:
+  1. Read every IC's configuration group
+  2. Mark the ICs that differ from their verified configuration (or fail PEC) stale
+  3. Rewrite and verify if anything is dirty
 */
 
+/***********************************************//**
+ \brief Starts a pipelined read of all cell voltage register groups
 
-/*!*******************************************************************************************************************
- \brief Maps  global ADC control variables to the appropriate control bytes for each of the different ADC commands
-
-@param[in] uint8_t MD The adc conversion mode
-@param[in] uint8_t DCP Controls if Discharge is permitted during cell conversions
-@param[in] uint8_t CH Determines which cells are measured during an ADC conversion command
-@param[in] uint8_t CHG Determines which GPIO channels are measured during Auxiliary conversion command
-
-Command Code:
--------------
-
-|command	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
-|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
-|ADCV:	    |   0   |   0   |   0   |   0   |   0   |   0   |   1   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CH[2] | CH[1] | CH[0] |
-|ADAX:	    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CHG[2]| CHG[1]| CHG[0]|
- ******************************************************************************************************************/
-void set_adc(ltc68041ChainHandle * hbms,
-			 uint8_t MD, //ADC Mode
-			 uint8_t DCP, //Discharge Permit
-			 uint8_t CH, //Cell Channels to be measured
-			 uint8_t CHG //GPIO Channels to be measured
-			 )
+ RDCVA to RDCVD as one job list (see LTC6804_pipeStart()). Collect the result
+ with LTC6804_rdcv_pipeCplt(). Group n (0 to 3) is found at spiRxBuf[n * LTC6804_XFER_LEN(numIC)].
+ *************************************************/
+void LTC6804_rdcv_pipe(ltc68041ChainHandle * hbms)
 {
-  uint8_t md_bits;
-
-  // Setter functions; no SPI transmissions
-  md_bits = (MD & 0x02) >> 1;
-  (hbms->ADCV)[0] = md_bits + 0x02;
-  md_bits = (MD & 0x01) << 7;
-  (hbms->ADCV)[1] =  md_bits + 0x60 + (DCP<<4) + CH;
+  static const uint8_t * const cmds[NUM_CV_REG] = {cmdRDCV[0], cmdRDCV[1], cmdRDCV[2], cmdRDCV[3]};
 
-  md_bits = (MD & 0x02) >> 1;
-  (hbms->ADCV)[0] = md_bits + 0x04;
-  md_bits = (MD & 0x01) << 7;
-  (hbms->ADCV)[1] = md_bits + 0x60 + CHG ;
+  LTC6804_pipeStart(hbms, cmds, NUM_CV_REG);
 }
 
+/***********************************************//**
+ \brief Reads the result of an ADCVAX conversion
 
-/***********************************************************************************//**
- \brief Reads and parses the LTC6804 auxiliary registers.
+ RDCVA to RDCVD and RDAUXA (GPIO1, GPIO2) are read as one job list, so a
+ combined conversion costs a single wakeup and a single wait. The cell codes
+ go to cellVolts and aux group A to auxVolts[ic][0..2].
 
- The function is used
- to read the  parsed GPIO codes of the LTC6804. This function will send the requested
- read commands parse the data and store the gpio voltages in aux_codes variable
+ @return int8_t, PEC Status (see LTC6804_rdcv_pipeCplt()).
+ *************************************************/
+int8_t LTC6804_rdcvax(ltc68041ChainHandle * hbms)
+{
+  static const uint8_t * const cmds[NUM_CV_REG + 1] = {cmdRDCV[0], cmdRDCV[1], cmdRDCV[2], cmdRDCV[3], cmdRDAUX[0]};
+  int8_t pec_error;
+  uint32_t aux_errors;
 
-@param[in] uint8_t reg; This controls which GPIO voltage register is read back.
+  LTC6804_pipeStart(hbms, cmds, NUM_CV_REG + 1);
+  pec_error = LTC6804_rdcv_pipeCplt(hbms);				// Waits for the whole job list; parses the cell groups
+  if(pec_error == -2)
+  {
+    return(-2);
+  }
 
-          0: Read back all auxiliary registers
+  TRACE_BEGIN(TRACE_PARSE_AUX);
+  aux_errors = LTC6804_pecNote(hbms, LTC6804_GRP_AUXA,
+		  LTC6804_parseGroup(&((hbms->spiRxBuf)[NUM_CV_REG * LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]),
+		  hbms->numIC, &((hbms->auxVolts)[0][0]), REG_BYTES));
+  TRACE_END(TRACE_PARSE_AUX);
+  hbms->pecErrIC |= aux_errors;
+  if(aux_errors)
+  {
+    pec_error = -1;
+  }
+  return(pec_error);
+}
 
-          1: Read back auxiliary group A
+/***********************************************//**
+ \brief Picks the next async request for the bus
 
-          2: Read back auxiliary group B
+ The oldest queued request of the most urgent class (see LTC6804_PRIO_*).
+ Called from the completion ISR or with it masked.
 
+ @return int8_t, Its slot, -1 if none is waiting
+ *************************************************/
+static int8_t LTC6804_asyncPick(ltc68041ChainHandle * hbms)
+{
+	int8_t best = -1;
+	ltc68041Req * req;
 
-@param[in] uint8_t total_ic; This is the number of ICs in the daisy chain(-1 only)
+	for(uint8_t slot = 0; slot < LTC6804_ASYNC_DEPTH; slot++)
+	{
+		req = (hbms->asyncQ)[slot];
+		if((req == NULL) || (req->state != LTC6804_REQ_QUEUED))
+		{
+			continue;
+		}
+		if((best < 0) || (req->prio > (hbms->asyncQ)[best]->prio) ||
+				((req->prio == (hbms->asyncQ)[best]->prio) && ((int8_t)(req->seq - (hbms->asyncQ)[best]->seq) < 0)))
+		{
+			best = slot;
+		}
+	}
+	return best;
+}
 
+/***********************************************//**
+ \brief Starts the transfer of the async request in slot
 
- @param[out] uint16_t aux_codes[][6]; A two dimensional array of the gpio voltage codes. The GPIO codes will
- be stored in the aux_codes[][6] array in the following format:
- |  aux_codes[0][0]| aux_codes[0][1] |  aux_codes[0][2]|  aux_codes[0][3]|  aux_codes[0][4]|  aux_codes[0][5]| aux_codes[1][0] |aux_codes[1][1]|  .....    |
- |-----------------|-----------------|-----------------|-----------------|-----------------|-----------------|-----------------|---------------|-----------|
- |IC1 GPIO1        |IC1 GPIO2        |IC1 GPIO3        |IC1 GPIO4        |IC1 GPIO5        |IC1 Vref2        |IC2 GPIO1        |IC2 GPIO2      |  .....    |
+ Called with CS high and the SPI idle, from the submitting task or from the
+ completion ISR of the previous request.
+ *************************************************/
+static void LTC6804_asyncStart(ltc68041ChainHandle * hbms, uint8_t slot)
+{
+	uint16_t offset = LTC6804_ASYNC_SLOT(hbms->numIC, slot);
 
-@return  int8_t, PEC Status
+	hbms->asyncSlot = slot;
+	hbms->asyncActive = 1;
+	(hbms->asyncQ)[slot]->state = LTC6804_REQ_ACTIVE;
+	LTC6804_xferStart(hbms, &((hbms->spiTxBuf)[offset]), &((hbms->spiRxBuf)[offset]),
+			CMD_LEN + ((hbms->asyncQ)[slot])->len);
+}
 
-  0: No PEC error detected
+/***********************************************//**
+ \brief Ends the async request on the bus and starts the next one (ISR)
 
- -1: PEC error detected, retry read
+ @param[in] int8_t status; 0, or -2 if the transfer failed
+
+ @return uint8_t, Always 1: the waiting task can check its request
  *************************************************/
-int8_t LTC6804_rdaux(ltc68041ChainHandle * hbms, uint8_t reg)
+static uint8_t LTC6804_asyncNext(ltc68041ChainHandle * hbms, int8_t status)
 {
-  uint8_t data_counter = 0;
-  int8_t pec_error = 0;
-  uint16_t parsed_aux;
-  uint16_t received_pec;
-  uint16_t data_pec;
-
-  //1.a
-  if (reg == 0)
-  {
-	//a.i
-    for(uint8_t gpio_reg = 1; gpio_reg <= NUM_AUX_REG; gpio_reg++)		 	   		 			//executes once for each of the LTC6804 aux voltage registers
-    {
-      data_counter = 0;
-      LTC6804_rdaux_reg(hbms, gpio_reg);											//Reads the raw auxiliary register data into the data[] array
-      xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
-
-      for (uint8_t current_ic = 0 ; current_ic < TOTAL_IC; current_ic++) 			// executes for every LTC6804 in the daisy chain
-      {																 	  			// current_ic is used as the IC counter
-        //a.ii
-		for(uint8_t current_gpio = 0; current_gpio< GPIO_IN_REG; current_gpio++)	// This loop parses the read back data into GPIO voltages, it
-        {														   		  			// loops once for each of the 3 gpio voltage codes in the register
-		  parsed_aux = (hbms->spiRxBuf)[data_counter + CMD_LEN] + ((hbms->spiRxBuf)[data_counter+CMD_LEN+1]<<8);
-          (hbms->auxVolts)[current_ic][current_gpio +((gpio_reg-1)*GPIO_IN_REG)] = parsed_aux;
-          data_counter += 2;
-        }
-		//a.iii
-        received_pec = ((hbms->spiRxBuf)[data_counter + CMD_LEN]<<8) + (hbms->spiRxBuf)[data_counter+CMD_LEN+1];
-        data_pec = pec15_calc(REG_BYTES, &(hbms->spiRxBuf)[current_ic*BYTES_IN_REG + CMD_LEN]);
-
-        if(received_pec != data_pec)
-        {
-          pec_error = -1;
-        }
-
-        data_counter += 2;
-      }
-    }
-  }
-  else
-  {
-	//b.i
-    LTC6804_rdaux_reg(hbms, reg);
-    xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
-
-    for (int current_ic = 0 ; current_ic < TOTAL_IC; current_ic++) 			  		// executes for every LTC6804 in the daisy chain
-    {							   									          		// current_ic is used as an IC counter
-		//b.ii
-		for(int current_gpio = 0; current_gpio<GPIO_IN_REG; current_gpio++)  	 	// This loop parses the read back data. Loops
-		{						 											  		// once for each aux voltage in the register
-			parsed_aux = ((hbms->spiRxBuf)[data_counter+CMD_LEN] + ((hbms->spiRxBuf)[data_counter+CMD_LEN+1]<<8));
-			(hbms->auxVolts)[current_ic][current_gpio +((reg-1)*GPIO_IN_REG)] = parsed_aux;
-			data_counter += 2;
-		}
-		//b.iii
-		received_pec = ((hbms->spiRxBuf)[data_counter+CMD_LEN]<<8) + (hbms->spiRxBuf)[data_counter+CMD_LEN+1];
-        data_pec = pec15_calc(REG_BYTES, &((hbms->spiRxBuf)[current_ic*BYTES_IN_REG + CMD_LEN]));
-        if(received_pec != data_pec)
-        {
-          pec_error = -1;
-        }
-
-		data_counter += 2;
-    }
-  }
-  return (pec_error);
+	ltc68041Req * req = (hbms->asyncQ)[hbms->asyncSlot];
+	int8_t next;
+
+	hbms->asyncActive = 0;
+	req->status = status;
+	req->seq = hbms->asyncEnded++;							// From now on the completion order, for LTC6804_asyncService()
+	req->state = LTC6804_REQ_XFERED;
+	next = LTC6804_asyncPick(hbms);
+	if(next >= 0)
+	{
+		LTC6804_asyncStart(hbms, next);						// Back to back, the isoSPI port is still awake
+	}
+	else
+	{
+		hbms->asyncBusy = 0;
+	}
+	return 1;
 }
-/*
-	LTC6804_rdaux Sequence
 
-	1. Switch Statement:
-		a. Reg = 0
-			i. Read GPIO voltage registers A-D for every IC in the daisy chain
-			ii. Parse raw GPIO voltage data in cell_codes array
-			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
-		b. Reg != 0
-			i.Read single GPIO voltage register for all ICs in daisy chain
-			ii. Parse raw GPIO voltage data in cell_codes array
-			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
-	2. Return pec_error flag
-*/
+/***********************************************//**
+ \brief SPI transmit-receive complete handler for the chain
 
-// TODO: Open wire test
+ Called by LTC6804_SPI_TxRxCpltCallback() for the chain on the interrupting
+ SPI. Releases CS and, if a pipelined job list is in progress, starts the next
+ transaction straight away. The isoSPI port is still awake from the previous
+ transaction so no wakeup pulse is needed between the stages.
 
-//  Cell voltage Self-Test
-int8_t LTC6804_cvTest(ltc68041ChainHandle * hbms)
+ @return 1 when the transfer (or the whole job list) is complete and the
+ waiting task can be released, 0 when another transaction was started.
+ *************************************************/
+static uint8_t LTC6804_TxRxCplt(ltc68041ChainHandle * hbms)
 {
-	int8_t retVal = 0;
-	uint16_t cmd_pec;
-	uint16_t RxTemp;
+	uint16_t offset;
 
-	//1
-	// CVST + pec15
-	(hbms->spiTxBuf)[0] = (hbms->ADCV)[0] & 0x03;
-	(hbms->spiTxBuf)[1] = ((hbms->ADCV)[1] & 0x80) | (0x02 << 5) | 0x7;	// Self-test mode 2
-	cmd_pec = pec15_calc(2, hbms->ADAX);
-	(hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-	(hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
-
-	//2
-	wakeup_idle(); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+	HAL_GPIO_WritePin(hbms->csPort, hbms->csPin, GPIO_PIN_SET);
+	hbms->lastXfer = osKernelSysTick();
 
-	//3
-	// Wait for the SPI peripheral to finish TXing if it's busy
-	while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-		  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX))){
-	  osDelay(1);
+	if(hbms->asyncActive)
+	{
+		return LTC6804_asyncNext(hbms, 0);
 	}
 
-	// Flush spi Rx FIFO
-	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-		uint32_t garbage = hbms->hspi->Instance->DR;
+	if(++(hbms->xferStage) < hbms->xferStages)
+	{
+		offset = hbms->xferStage * LTC6804_XFER_LEN(hbms->numIC);
+		LTC6804_xferStart(hbms, &((hbms->spiTxBuf)[offset]), &((hbms->spiRxBuf)[offset]), LTC6804_XFER_LEN(hbms->numIC));
+		return 0;
 	}
 
-	HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-	// 4 register groups, 6 registers per register group
-	HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + REG_BYTES * 4 * TOTAL_IC);
-	//Read the configuration data of all ICs on the daisy chain into the handle's storage arrays
+	hbms->xferStages = 0;	// Job list done; following transfers are single transactions
+	return 1;
+}
+
+/***********************************************//**
+ \brief Dispatches HAL_SPI_TxRxCpltCallback() to the chain on that SPI
 
-	// Suspend until we get the semaphore that the transmission is complete
-	xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
+ Call from HAL_SPI_TxRxCpltCallback(). Notifies the chain's waiting task with
+ LTC6804_XFER_OK once its transfer or job list is complete.
+ *************************************************/
+void LTC6804_SPI_TxRxCpltCallback(SPI_HandleTypeDef * hspi)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-	// Check the return values for all the ICs
-	for (uint8_t current_ic = 0; current_ic < TOTAL_IC; current_ic++)
+	for(uint8_t chain = 0; chain < numChains; chain++)
 	{
-		// Dump data
-		for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG * 4; current_byte += 2)
+		if(chainList[chain]->hspi == hspi)
 		{
-			RxTemp = (((hbms->spiRxBuf)[current_byte + CMD_LEN + REG_BYTES * 4 * current_ic]) << 8) +
-					((hbms->spiRxBuf)[current_byte + 1 + CMD_LEN + REG_BYTES * 4 * current_ic]);
-
-			// Check the test value
-			if(RxTemp != cvTestPos){
-				retVal = -1;	// Self-test failed
+			if(LTC6804_TxRxCplt(chainList[chain]))
+			{
+				TRACE_MARK(TRACE_XFER_WAKE);
+				LTC6804_xferNotify(chainList[chain], LTC6804_XFER_OK, &xHigherPriorityTaskWoken);
 			}
+			break;
 		}
 	}
-
-	return(retVal);
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
-//  Auxiliary voltage measurement Self-Test
-int8_t LTC6804_auxTest(ltc68041ChainHandle * hbms)
+/***********************************************//**
+ \brief Dispatches HAL_SPI_TxCpltCallback() to the chain on that SPI
+
+ Call from HAL_SPI_TxCpltCallback(). Releases CS after write-only commands
+ and wakes a task waiting for the bus in LTC6804_spiWaitIdle().
+ *************************************************/
+void LTC6804_SPI_TxCpltCallback(SPI_HandleTypeDef * hspi)
 {
-	int8_t retVal = 0;
-	uint16_t cmd_pec;
-	uint16_t RxTemp;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-	//1
-	// AXST + pec15
-	(hbms->spiTxBuf)[0] = ((hbms->ADCV)[0] & 0x01) | 0x4;
-	(hbms->spiTxBuf)[1] = ((hbms->ADCV)[1] & 0x80) | (0x02 << 5) | 0x7;	// Self-test mode 2
-	cmd_pec = pec15_calc(2, hbms->ADAX);
-	(hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-	(hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
+	for(uint8_t chain = 0; chain < numChains; chain++)
+	{
+		if(chainList[chain]->hspi == hspi)
+		{
+			HAL_GPIO_WritePin(chainList[chain]->csPort, chainList[chain]->csPin, GPIO_PIN_SET);
+			chainList[chain]->lastXfer = osKernelSysTick();
+			LTC6804_xferNotify(chainList[chain], LTC6804_XFER_OK, &xHigherPriorityTaskWoken);
+			break;
+		}
+	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
 
-	//2
-	wakeup_idle(); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+/***********************************************//**
+ \brief Dispatches HAL_SPI_ErrorCallback() to the chain on that SPI
 
-	//3
-	// Wait for the SPI peripheral to finish TXing if it's busy
-	while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-		  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX))){
-	  osDelay(1);
-	}
+ Call from HAL_SPI_ErrorCallback(). Releases CS, drops any pending job list
+ and wakes the chain's waiting task with LTC6804_XFER_DMA_ERR.
+ *************************************************/
+void LTC6804_SPI_ErrorCallback(SPI_HandleTypeDef * hspi)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-	// Flush spi Rx FIFO
-	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-		uint32_t garbage = hbms->hspi->Instance->DR;
+	for(uint8_t chain = 0; chain < numChains; chain++)
+	{
+		if(chainList[chain]->hspi == hspi)
+		{
+			HAL_GPIO_WritePin(chainList[chain]->csPort, chainList[chain]->csPin, GPIO_PIN_SET);
+			chainList[chain]->xferStages = 0;
+			if(chainList[chain]->asyncActive)
+			{
+				LTC6804_asyncNext(chainList[chain], -2);	// The status is in the request, the queue carries on
+			}
+			LTC6804_xferNotify(chainList[chain], LTC6804_XFER_DMA_ERR, &xHigherPriorityTaskWoken);
+			break;
+		}
 	}
+	portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/*
+ * Async requests
+ *
+ * A request is a command descriptor (ltc68041Req) queued on its chain. The
+ * chain keeps up to LTC6804_ASYNC_DEPTH of them, each in its own spiTxBuf/spiRxBuf
+ * slot past the job list ones (LTC6804_ASYNC_SLOT()). The next transfer is started from the completion ISR of the previous
+ * one, picking the oldest request of the most urgent class (LTC6804_PRIO_*), so
+ * safety reads overtake queued diagnostics and the bus is never idle between
+ * requests. Within a class requests go out in submission order: keep a write
+ * and the reads depending on it in the same class. The task that submitted them
+ * parses them with LTC6804_asyncService() (non-blocking) or LTC6804_asyncWait()
+ * (blocks on one request), and gets on with CAN or balancing work meanwhile:
+ *
+ * static ltc68041Req adcv = {.cmd = hbms1.ADCV, .prio = LTC6804_PRIO_SAFETY};
+ * static ltc68041Req rdcv[4];
+ * LTC6804_asyncSubmit(&hbms1, &adcv);
+ * ... wait for the conversion ...
+ * for(reg = 1..4){ LTC6804_asyncRdcvReq(&hbms1, &rdcv[reg - 1], reg); rdcv[reg - 1].prio = LTC6804_PRIO_SAFETY; LTC6804_asyncSubmit(&hbms1, &rdcv[reg - 1]); }
+ * ... other work, LTC6804_asyncService(&hbms1) ...
+ * if(LTC6804_asyncWait(&hbms1, &rdcv[3]) == 0){ ... }
+ *
+ * The blocking functions use other buffer slots and wait for the queued
+ * transfers to leave the bus first, so they may be called with requests
+ * outstanding; from the same task as the requests only.
+ */
 
-	HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-	// 4 register groups, 6 registers per register group
-	HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + REG_BYTES * 2 * TOTAL_IC);
-	//Read the configuration data of all ICs on the daisy chain into the handle's storage arrays
+/***********************************************//**
+ \brief Starts the queued async requests unless the queue owns the bus
 
-	// Suspend until we get the semaphore that the transmission is complete
-	xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
+ While it does, the completion ISR starts them back to back. Otherwise waits
+ for the bus to be idle (a blocking write-only command may still be sending)
+ and claims it for the queue with the ISR masked: only tasks claim, the ISR
+ only releases.
+ *************************************************/
+static void LTC6804_asyncKick(ltc68041ChainHandle * hbms)
+{
+	uint8_t idle = 0;
 
-	// Check the return values for all the ICs
-	for (uint8_t current_ic = 0; current_ic < TOTAL_IC; current_ic++)
+	while(!idle)
 	{
-		// Dump data
-		for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG * 2; current_byte += 2)
+		taskENTER_CRITICAL();
+		if(hbms->asyncBusy || (LTC6804_asyncPick(hbms) < 0))
 		{
-			RxTemp = (((hbms->spiRxBuf)[current_byte + CMD_LEN + REG_BYTES * 4 * current_ic]) << 8) +
-					((hbms->spiRxBuf)[current_byte + 1 + CMD_LEN + REG_BYTES * 4 * current_ic]);
-
-			// Check the test value
-			if(RxTemp != axTestPos){
-				retVal = -1;	// Self-test failed
-			}
+			taskEXIT_CRITICAL();
+			return;
+		}
+		idle = !(hbms->waking) && (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY);
+		if(idle)
+		{
+			hbms->asyncBusy = 1;
+		}
+		taskEXIT_CRITICAL();
+		if(!idle)
+		{
+			LTC6804_spiWaitIdle(hbms);
 		}
 	}
 
-	return(retVal);
+	LTC6804_rxFlush(hbms);
+	wakeup_idle(hbms);
+	LTC6804_asyncStart(hbms, LTC6804_asyncPick(hbms));				// Claimed from idle: nothing else starts requests
 }
 
-// Status register Self-Test
-int8_t LTC6804_statTest(ltc68041ChainHandle * hbms)
+/***********************************************//**
+ \brief Queues an async request on the chain
+
+ Starts its transfer right away if the bus is free. req must not be queued
+ already, and must stay valid until it is LTC6804_REQ_DONE.
+
+ @return int8_t, 0 queued, -1 queue full (service it first) or len too long
+ *************************************************/
+int8_t LTC6804_asyncSubmit(ltc68041ChainHandle * hbms, ltc68041Req * req)
 {
-	int8_t retVal = 0;
-	uint16_t cmd_pec;
-	uint16_t RxTemp;
+	int8_t slot = -1;
+	uint8_t * tx;
 
 	//1
-	// STATST + pec15
-	(hbms->spiTxBuf)[0] = ((hbms->ADCV)[0] & 0x01) | 0x4;
-	(hbms->spiTxBuf)[1] = ((hbms->ADCV)[1] & 0x80) | (0x02 << 5) | 0xF;	// Self-test mode 2
-	cmd_pec = pec15_calc(2, hbms->ADAX);
-	(hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-	(hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
+	for(uint8_t free = 0; free < LTC6804_ASYNC_DEPTH; free++)
+	{
+		if((hbms->asyncQ)[free] == NULL)
+		{
+			slot = free;
+			break;
+		}
+	}
+	if((slot < 0) || (req->len > BYTES_IN_REG * hbms->numIC))
+	{
+		return -1;
+	}
 
 	//2
-	wakeup_idle(); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+	tx = &((hbms->spiTxBuf)[LTC6804_ASYNC_SLOT(hbms->numIC, slot)]);
+	memcpy(tx, req->cmd, CMD_LEN);
+	if(req->tx != NULL)
+	{
+		memcpy(tx + CMD_LEN, req->tx, req->len);
+	}
+	else
+	{
+		memset(tx + CMD_LEN, 0xFF, req->len);
+	}
+	req->status = 0;
+	req->seq = hbms->asyncIn++;
+	req->state = LTC6804_REQ_QUEUED;
 
 	//3
-	// Wait for the SPI peripheral to finish TXing if it's busy
-	while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-		  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX))){
-	  osDelay(1);
-	}
+	taskENTER_CRITICAL();
+	(hbms->asyncQ)[slot] = req;
+	taskEXIT_CRITICAL();
+	LTC6804_asyncKick(hbms);
+	return 0;
+}
+/*
+  LTC6804_asyncSubmit Function Process:
+  1. Take a free Tx/Rx slot
+  2. Load the command and its data into it
+  3. Queue the request and start the queue if it does not own the bus
+*/
 
-	// Flush spi Rx FIFO
-	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-		uint32_t garbage = hbms->hspi->Instance->DR;
-	}
+/***********************************************//**
+ \brief Parses the async requests whose transfer ended, in completion order
 
-	HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-	// 4 register groups, 6 registers per register group
-	HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + REG_BYTES * 2 * TOTAL_IC);
-	//Read the configuration data of all ICs on the daisy chain into the handle's storage arrays
+ Runs each request's parse then its done callback in the calling task, and
+ frees its slot (done may submit again). Never blocks.
 
-	// Suspend until we get the semaphore that the transmission is complete
-	xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
+ @return uint8_t, Number of requests completed
+ *************************************************/
+uint8_t LTC6804_asyncService(ltc68041ChainHandle * hbms)
+{
+	uint8_t completed = 0;
+	int8_t slot;
+	ltc68041Req * req;
 
-	// Check the return values for all the ICs
-	for (uint8_t current_ic = 0; current_ic < TOTAL_IC; current_ic++)
+	for(;;)
 	{
-		// Dump data
-		for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG * 2; current_byte += 2)
+		//1
+		slot = -1;
+		for(uint8_t ended = 0; ended < LTC6804_ASYNC_DEPTH; ended++)
 		{
-			RxTemp = (((hbms->spiRxBuf)[current_byte + CMD_LEN + REG_BYTES * 4 * current_ic]) << 8) +
-					((hbms->spiRxBuf)[current_byte + 1 + CMD_LEN + REG_BYTES * 4 * current_ic]);
-
-			// Check the test value
-			if(RxTemp != statTestPos){
-				retVal = -1;	// Self-test failed
+			req = (hbms->asyncQ)[ended];
+			if((req != NULL) && (req->state == LTC6804_REQ_XFERED) &&
+					((slot < 0) || ((int8_t)(req->seq - (hbms->asyncQ)[slot]->seq) < 0)))
+			{
+				slot = ended;
 			}
 		}
-	}
+		if(slot < 0)
+		{
+			break;
+		}
 
-	return(retVal);
+		//2
+		req = (hbms->asyncQ)[slot];
+		if(req->status != 0)
+		{
+			hbms->health.xferFails++;
+		}
+		else if(req->parse != NULL)
+		{
+			req->status = req->parse(hbms, &((hbms->spiRxBuf)[LTC6804_ASYNC_SLOT(hbms->numIC, slot) + CMD_LEN]), req->ctx);
+		}
+
+		//3
+		req->state = LTC6804_REQ_DONE;
+		(hbms->asyncQ)[slot] = NULL;
+		completed++;
+		if(req->done != NULL)
+		{
+			req->done(hbms, req);
+		}
+	}
+	return completed;
 }
+/*
+  LTC6804_asyncService Function Process:
+  1. Find the request whose transfer ended first
+  2. Parse its read back unless the transfer failed
+  3. Free its slot and call its done callback
+*/
 
-// Multiplexer Self-Test
-int8_t LTC6804_muxTest(ltc68041ChainHandle * hbms)
+/***********************************************//**
+ \brief Drops every async request still queued after the bus hung
+
+ The requests end with status -2 and are completed by LTC6804_asyncService().
+ *************************************************/
+static void LTC6804_asyncAbort(ltc68041ChainHandle * hbms)
 {
-	int8_t retVal = 0;
+	ltc68041Req * req;
 
-	//1
-	// DIAGN + pec15
-	(hbms->spiTxBuf)[0] = 0x15;
-	(hbms->spiTxBuf)[1] = 0x07;
-	(hbms->spiTxBuf)[2] = 0x78;
-	(hbms->spiTxBuf)[3] = 0x5e;
+	LTC6804_busRecover(hbms);										// Ends the one on the bus
+	taskENTER_CRITICAL();
+	for(uint8_t slot = 0; slot < LTC6804_ASYNC_DEPTH; slot++)
+	{
+		req = (hbms->asyncQ)[slot];
+		if((req != NULL) && (req->state == LTC6804_REQ_QUEUED))
+		{
+			req->status = -2;
+			req->seq = hbms->asyncEnded++;
+			req->state = LTC6804_REQ_XFERED;
+		}
+	}
+	taskEXIT_CRITICAL();
+}
 
-	//2
-	wakeup_idle(); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+/***********************************************//**
+ \brief Blocks until an async request is done
 
-	//3
-	// Wait for the SPI peripheral to finish TXing if it's busy
-	while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-		  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX))){
-	  osDelay(1);
-	}
+ Services the chain's requests (see LTC6804_asyncService()) as their transfers
+ end, and restarts the queue if a bus recovery left it without the bus. A
+ transfer not ending within LTC6804_xferTimeout() aborts the bus and fails
+ every queued request with -2.
 
-	// Flush spi Rx FIFO
-	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-		uint32_t garbage = hbms->hspi->Instance->DR;
+ @return int8_t, The request's status, -1 if it was never submitted
+ *************************************************/
+int8_t LTC6804_asyncWait(ltc68041ChainHandle * hbms, ltc68041Req * req)
+{
+	if(req->state == LTC6804_REQ_IDLE)
+	{
+		return -1;
 	}
 
-	HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-	// 4 register groups, 6 registers per register group
-	HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + REG_BYTES * TOTAL_IC);
-	//Read the configuration data of all ICs on the daisy chain into the handle's storage arrays
+	while(req->state != LTC6804_REQ_DONE)
+	{
+		LTC6804_asyncKick(hbms);									// Requests left queued by a bus recovery
+		LTC6804_xferArm(hbms);										// Before servicing, so an end in between still notifies
+		LTC6804_asyncService(hbms);
+		if(req->state == LTC6804_REQ_DONE)
+		{
+			break;
+		}
+		if(xTaskNotifyWait(0, 0xFFFFFFFF, NULL, LTC6804_xferTimeout(hbms)) != pdTRUE)
+		{
+			LTC6804_asyncAbort(hbms);
+		}
+	}
+	hbms->xferTask = NULL;
+	return req->status;
+}
 
-	// Suspend until we get the semaphore that the transmission is complete
-	xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
+/***********************************************//**
+ \brief Blocks until every async request of the chain is done
+ *************************************************/
+void LTC6804_asyncFlush(ltc68041ChainHandle * hbms)
+{
+	uint8_t slot = 0;
 
-	// Check the return values for all the ICs
-	for (uint8_t current_ic = 0; current_ic < TOTAL_IC; current_ic++)
+	while(slot < LTC6804_ASYNC_DEPTH)
 	{
-		// MUXFAIL bit set
-		if(!((((hbms->spiRxBuf)[current_ic * REG_BYTES + 5]) >> 1) & 0x1)){
-			retVal = -1;
+		if((hbms->asyncQ)[slot] != NULL)
+		{
+			LTC6804_asyncWait(hbms, (hbms->asyncQ)[slot]);
+			slot = 0;												// A done callback may have queued more, look again
+		}
+		else
+		{
+			slot++;
 		}
 	}
+}
 
-	return(retVal);
+// Parses an async cell voltage group read into cellVolts; ctx is the group (1 to 4)
+static int8_t LTC6804_asyncParseCV(ltc68041ChainHandle * hbms, const uint8_t * rx, void * ctx)
+{
+	uint8_t reg = (uint8_t)(uintptr_t)ctx;
+
+	TRACE_BEGIN(TRACE_PARSE_CV);
+	hbms->pecErrIC = LTC6804_pecNote(hbms, LTC6804_GRP_CVA + reg - 1,
+			LTC6804_parseGroup(rx, hbms->numIC, &((hbms->cellVolts)[0][(reg - 1) * CELL_IN_REG]), 12));
+	TRACE_END(TRACE_PARSE_CV);
+	return (hbms->pecErrIC ? -1 : 0);
 }
 
+// Parses an async auxiliary group read into auxVolts; ctx is the group (1 or 2)
+static int8_t LTC6804_asyncParseAux(ltc68041ChainHandle * hbms, const uint8_t * rx, void * ctx)
+{
+	uint8_t reg = (uint8_t)(uintptr_t)ctx;
+
+	TRACE_BEGIN(TRACE_PARSE_AUX);
+	hbms->pecErrIC = LTC6804_pecNote(hbms, LTC6804_GRP_AUXA + reg - 1,
+			LTC6804_parseGroup(rx, hbms->numIC, &((hbms->auxVolts)[0][(reg - 1) * GPIO_IN_REG]), REG_BYTES));
+	TRACE_END(TRACE_PARSE_AUX);
+	return (hbms->pecErrIC ? -1 : 0);
+}
 
-// Run internal diagnostic variable test (ADSTAT)
-int8_t LTC6804_internalTest(ltc68041ChainHandle * hbms)
+/***********************************************//**
+ \brief Fills req as the read of one cell voltage group into cellVolts
+
+ Same result as LTC6804_rdcv(hbms, reg) once done: 0, -1 on a PEC error
+ (pecErrIC), -2 on a transfer failure. prio and done are left as set by the
+ caller.
+
+ @param[in] uint8_t reg; Cell voltage group, 1 to 4
+ *************************************************/
+void LTC6804_asyncRdcvReq(ltc68041ChainHandle * hbms, ltc68041Req * req, uint8_t reg)
 {
-	int8_t retVal = 0;
-	uint16_t cmd_pec;
+	req->cmd = cmdRDCV[reg - 1];
+	req->tx = NULL;
+	req->len = BYTES_IN_REG * hbms->numIC;
+	req->parse = LTC6804_asyncParseCV;
+	req->ctx = (void *)(uintptr_t)reg;
+}
 
-	//1
-	// ADSTAT + pec15
-	(hbms->spiTxBuf)[0] = ((hbms->ADCV)[0] & 0x01) | 0x4;
-	(hbms->spiTxBuf)[1] = ((hbms->ADCV)[1] & 0x80) | 0x68;	// Self-test mode 2
-	cmd_pec = pec15_calc(2, hbms->ADAX);
-	(hbms->spiTxBuf)[2] = (uint8_t)(cmd_pec >> 8);
-	(hbms->spiTxBuf)[3] = (uint8_t)(cmd_pec);
+/***********************************************//**
+ \brief Fills req as the read of one auxiliary group into auxVolts
 
-	//2
-	wakeup_idle(); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+ Same result as LTC6804_rdaux(hbms, reg) once done.
 
-	//3
-	// Wait for the SPI peripheral to finish TXing if it's busy
-	while(!((HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_READY) ||
-		  (HAL_SPI_GetState(hbms->hspi) == HAL_SPI_STATE_BUSY_RX))){
-	  osDelay(1);
+ @param[in] uint8_t reg; Auxiliary group, 1 or 2
+ *************************************************/
+void LTC6804_asyncRdauxReq(ltc68041ChainHandle * hbms, ltc68041Req * req, uint8_t reg)
+{
+	req->cmd = cmdRDAUX[reg - 1];
+	req->tx = NULL;
+	req->len = BYTES_IN_REG * hbms->numIC;
+	req->parse = LTC6804_asyncParseAux;
+	req->ctx = (void *)(uintptr_t)reg;
+}
+
+/***********************************************//**
+ \brief Completes a pipelined read started by LTC6804_rdcv_pipe()
+
+ Blocks until the whole job list is received (at most LTC6804_xferTimeout()),
+ then parses all 4 cell voltage groups of every IC into cellVolts.
+
+ @return int8_t, PEC Status.
+
+		0: No PEC error detected
+
+		-1: PEC error detected, retry read
+
+		-2: Transfer failed (DMA error or timeout), cellVolts not updated
+ *************************************************/
+int8_t LTC6804_rdcv_pipeCplt(ltc68041ChainHandle * hbms)
+{
+	uint32_t pec_errors = 0;
+
+//i
+	if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)								// Only proceeds when all 4 groups are received
+	{
+		return(-2);														// Transfer failed, nothing to parse
 	}
 
-	// Flush spi Rx FIFO
-	while(__HAL_SPI_GET_FLAG(hbms->hspi, SPI_FLAG_RXNE)){
-		uint32_t garbage = hbms->hspi->Instance->DR;
+	TRACE_BEGIN(TRACE_PARSE_CV);
+	for(uint8_t cell_reg = 0; cell_reg < NUM_CV_REG; cell_reg++)         			//executes once for each of the LTC6804 cell voltage registers
+	{
+		//ii, iii
+		// Each group has its own slot in the Rx buffer; CMD_LEN skips the data received during TX
+		pec_errors |= LTC6804_pecNote(hbms, LTC6804_GRP_CVA + cell_reg,
+				LTC6804_parseGroup(&((hbms->spiRxBuf)[cell_reg * LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]),
+				hbms->numIC, &((hbms->cellVolts)[0][cell_reg * CELL_IN_REG]), 12));
 	}
+	TRACE_END(TRACE_PARSE_CV);
+
+	hbms->pecErrIC = pec_errors;
+	return(pec_errors ? -1 : 0);
+}
+/*
+	LTC6804_rdcv_pipeCplt Sequence
+
+	i. Wait for the job list of RDCVA-RDCVD to complete
+	ii. Parse raw cell voltage data of every group slot into cellVolts
+	iii. Check the PEC of the data read back vs the calculated PEC for each group of each IC
+*/
+
+/***********************************************//**
+ \brief Reads all cell voltage registers of several chains concurrently
+
+ The pipelined read is started on every chain first, so the DMA transfers of
+ chains on independent SPI peripherals overlap; the results are then
+ collected chain by chain. Each chain must be on its own SPI peripheral.
+
+ @param[in] ltc68041ChainHandle * chains[]; The chains to scan
+
+ @param[in] uint8_t chainCount; Number of chains in chains[]
 
-	HAL_GPIO_WritePin(BMS_CS_GPIO_Port, BMS_CS_Pin, GPIO_PIN_RESET);
-	// 4 register groups, 6 registers per register group
-	HAL_SPI_TransmitReceive_DMA(hbms->hspi, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + REG_BYTES * 2 * TOTAL_IC);
-	//Read the configuration data of all ICs on the daisy chain into the handle's storage arrays
+ @return int8_t, PEC Status.
+
+		0: No PEC error detected on any chain
+
+		-1: PEC error detected on at least one chain, retry read
+
+		-2: Transfer failed on at least one chain
+ *************************************************/
+int8_t LTC6804_rdcvMulti(ltc68041ChainHandle * chains[], uint8_t chainCount)
+{
+	int8_t pec_error = 0;
+	int8_t chain_error;
 
-	// Suspend until we get the semaphore that the transmission is complete
-	xSemaphoreTake(bmsTRxCompleteHandle, portMAX_DELAY);
+	// Kick off every bus before blocking on any of them
+	for(uint8_t chain = 0; chain < chainCount; chain++)
+	{
+		LTC6804_rdcv_pipe(chains[chain]);
+	}
 
-	// Check the return values for all the ICs
-	for (uint8_t current_ic = 0; current_ic < TOTAL_IC; current_ic++)
+	for(uint8_t chain = 0; chain < chainCount; chain++)
 	{
-		// Dump data
-		for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG * 2; current_byte += 2)
+		chain_error = LTC6804_rdcv_pipeCplt(chains[chain]);
+		if(chain_error < pec_error)
 		{
-			(hbms->boardStat)[current_ic][current_byte / 2] = (((hbms->spiRxBuf)[current_byte + CMD_LEN + REG_BYTES * 4 * current_ic]) << 8) +
-					((hbms->spiRxBuf)[current_byte + 1 + CMD_LEN + REG_BYTES * 4 * current_ic]);
+			pec_error = chain_error;											// Report the worst chain
 		}
+	}
+	return(pec_error);
+}
 
-		// Check power supply measurements
-		// Analag power supply (4.5V <= Va <= 5.5V)
-		if((((hbms->boardStat)[current_ic][3]) >= 55000) || (((hbms->boardStat)[current_ic][3]) <= 45000)){
-			retVal = -1;
-		}
+/***********************************************//**
+ \brief Publishes the working measurement arrays as a frame
 
-		// Digital power supply (2.7V <= Va <= 3.6V)
-		if((((hbms->boardStat)[current_ic][4]) >= 36000) || (((hbms->boardStat)[current_ic][4]) <= 27000)){
-			retVal = -1;
+ Copies cellVolts, auxVolts and boardStat into the snapshot slot that is not
+ being read, computes the pack statistics of the copied cells, stamps it and
+ then makes it the latest frame. Only the scan task
+ of the chain may publish, and only after the reads returned 0 (PEC valid).
+ Never blocks; readers use LTC6804_snapshotRead().
+ *************************************************/
+void LTC6804_snapshotPublish(ltc68041ChainHandle * hbms)
+{
+	uint32_t seq = hbms->snapSeq;
+	ltc68041Frame * frame = &(hbms->snap[(seq + 1) & 1]);		// Slot not handed out to readers
+
+	memcpy(frame->cellVolts, hbms->cellVolts, sizeof(hbms->cellVolts[0]) * hbms->numIC);
+	memcpy(frame->auxVolts, hbms->auxVolts, sizeof(hbms->auxVolts[0]) * hbms->numIC);
+	memcpy(frame->boardStat, hbms->boardStat, sizeof(hbms->boardStat[0]) * hbms->numIC);
+	packStats_compute((const uint16_t (*)[12])frame->cellVolts, hbms->numIC, &(frame->stats));
+	frame->balIC = 0;
+	if(hbms->adcDCP)
+	{
+		for(uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++)
+		{
+			if(LTC6804_getDcc(hbms, current_ic))
+			{
+				frame->balIC |= (1UL << current_ic);
+			}
 		}
 	}
+	frame->timestamp = osKernelSysTick();
 
-	return(retVal);
+	__DMB();														// Frame contents land before it is published
+	hbms->snapSeq = seq + 1;
+}
+
+/***********************************************//**
+ \brief Copies the latest published frame of a chain
+
+ Lock-free; any number of tasks may read concurrently with the scan task.
+ The copy is retried if a new frame was published while it was being taken,
+ so the result is always one consistent frame.
+
+ @param[out] ltc68041Frame * frame; Reader's frame, see LTC68041_FRAME_STORAGE()
+
+ @return uint32_t, Sequence number of the copied frame (0: nothing published yet,
+ frame left untouched). Compare with a previous return value to detect new frames.
+ *************************************************/
+uint32_t LTC6804_snapshotRead(ltc68041ChainHandle * hbms, ltc68041Frame * frame)
+{
+	uint32_t seq;
+	ltc68041Frame * latest;
+
+	do
+	{
+		seq = hbms->snapSeq;
+		if(seq == 0)
+		{
+			return 0;
+		}
+		__DMB();
+		latest = &(hbms->snap[seq & 1]);
+		memcpy(frame->cellVolts, latest->cellVolts, sizeof(latest->cellVolts[0]) * hbms->numIC);
+		memcpy(frame->auxVolts, latest->auxVolts, sizeof(latest->auxVolts[0]) * hbms->numIC);
+		memcpy(frame->boardStat, latest->boardStat, sizeof(latest->boardStat[0]) * hbms->numIC);
+		packStats_copy(&(frame->stats), &(latest->stats), hbms->numIC);
+		frame->balIC = latest->balIC;
+		frame->timestamp = latest->timestamp;
+		__DMB();
+	} while(hbms->snapSeq != seq);									// A publish completed meanwhile; our slot may be rewritten
+
+	return seq;
+}
+/***********************************************//**
+ \brief Returns the latest published frame of a chain in place
+
+ For the scan task of the chain only: the frame is not copied, so it stays
+ consistent only until that task publishes again. Other tasks use
+ LTC6804_snapshotRead().
+
+ @return const ltc68041Frame *, Latest frame (NULL: nothing published yet)
+ *************************************************/
+const ltc68041Frame * LTC6804_snapshotLatest(ltc68041ChainHandle * hbms)
+{
+	uint32_t seq = hbms->snapSeq;
+
+	return((seq == 0) ? NULL : &(hbms->snap[seq & 1]));
 }
+/*
+	Snapshot protocol (single writer per chain)
+
+	The writer fills snap[(snapSeq + 1) & 1] while readers copy snap[snapSeq & 1], then
+	increments snapSeq. A reader's slot can only be rewritten after snapSeq moved on,
+	so a reader whose snapSeq is unchanged after the copy holds a consistent frame.
+	Readers never make the writer wait, and the writer never spins on readers.
+*/
 
+/***********************************************//**
+ \brief Reads and parses the LTC6804 cell voltage registers.
 
-// TODO: Read status register (RDSTATA + RDSTATB)
+ The function is used to read the cell codes of the LTC6804.
+ This function will send the requested read commands parse the data
+ and store the cell voltages in cell_codes variable.
+
+ @param[in] uint8_t reg; This controls which cell voltage register is read back.
+
+          0: Read back all Cell registers
+
+          1: Read back cell group A
+
+          2: Read back cell group B
+
+          3: Read back cell group C
+
+          4: Read back cell group D
+
+ @param[in] uint8_t total_ic; This is the number of ICs in the daisy chain(-1 only)
+
+ @param[out] uint16_t cell_codes[]; An array of the parsed cell codes from lowest to highest. The cell codes will
+  be stored in the cell_codes[] array in the following format:
+  |  cell_codes[0][0]| cell_codes[0][1] |  cell_codes[0][2]|    .....     |  cell_codes[0][11]|  cell_codes[1][0] | cell_codes[1][1]|  .....   |
+  |------------------|------------------|------------------|--------------|-------------------|-------------------|-----------------|----------|
+  |IC1 Cell 1        |IC1 Cell 2        |IC1 Cell 3        |    .....     |  IC1 Cell 12      |IC2 Cell 1         |IC2 Cell 2       | .....    |
+
+  @return int8_t, PEC Status.
+
+		0: No PEC error detected
+
+		-1: PEC error detected, retry read
+
+		-2: Transfer failed (DMA error or timeout)
+
+
+ *************************************************/
+int8_t LTC6804_rdcv(ltc68041ChainHandle * hbms, uint8_t reg)
+{
+	int8_t pec_error = 0;
+	TRACE_BEGIN(TRACE_RDCV);
+	//1.a
+	if (reg == 0)	// Read back all registers
+	{
+		//a.i
+		LTC6804_rdcv_pipe(hbms);														// Reads all cell voltage registers in one job list
+		pec_error = LTC6804_rdcv_pipeCplt(hbms);										// Only proceeds when all 4 groups are received
+	}
+	//1.b
+	else
+	{
+		//b.i
+		LTC6804_rdcv_reg(hbms, reg);
+		if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)							// Only proceeds when data is received
+		{
+			return(-2);														// Transfer failed, nothing to parse
+		}
+
+		//b.ii, b.iii
+		TRACE_BEGIN(TRACE_PARSE_CV);
+		hbms->pecErrIC = LTC6804_pecNote(hbms, LTC6804_GRP_CVA + reg - 1,
+				LTC6804_parseGroup(&((hbms->spiRxBuf)[CMD_LEN]), hbms->numIC,
+				&((hbms->cellVolts)[0][(reg - 1) * CELL_IN_REG]), 12));
+		TRACE_END(TRACE_PARSE_CV);
+		if(hbms->pecErrIC)
+		{
+			pec_error = -1;																//The pec_error variable is simply set negative if any PEC errors
+		}																				//are detected in the serial data
+	}
+	TRACE_END(TRACE_RDCV);
+	return(pec_error);
+}
+/*
+	LTC6804_rdcv Sequence
+
+	1. Switch Statement:
+		a. Reg = 0
+			i. Read cell voltage registers A-D for every IC in the daisy chain as one pipelined job list
+			ii. Parse raw cell voltage data in cell_codes array
+			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
+		b. Reg != 0
+			i.Read single cell voltage register for all ICs in daisy chain
+			ii. Parse raw cell voltage data in cell_codes array
+			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
+	2. Return pec_error flag
+*/
+
+
+
+/*!*********************************************************************************************
+  \brief Starts cell voltage conversion
+
+  Starts ADC conversions of the LTC6804 Cpin inputs.
+  The type of ADC conversion executed can be changed by setting the associated global variables:
+ |Variable|Function                                      |
+ |--------|----------------------------------------------|
+ | MD     | Determines the filter corner of the ADC      |
+ | CH     | Determines which cell channels are converted |
+ | DCP    | Determines if Discharge is Permitted	     |
+
+Command Code:
+-------------
+
+|CMD[0:1]	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
+|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
+|ADCV:	    |   0   |   0   |   0   |   0   |   0   |   0   |   1   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CH[2] | CH[1] | CH[0] |
+***********************************************************************************************/
+void LTC6804_adcv(ltc68041ChainHandle * hbms)
+{
+  //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, hbms->ADCV, CMD_LEN);
+
+  //3
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+
+  //4
+   // Transmit the command via DMA
+   LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
+}
+/*
+  LTC6804_adcv Function sequence:
+
+  1. Load adcv command and its PEC (computed by set_adc) into cmd array
+  3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
+  4. send broadcast adcv command to LTC6804 daisy chain
+*/
+
+
+/*!******************************************************************************************************
+ \brief Start an GPIO Conversion
+
+  Starts an ADC conversions of the LTC6804 GPIO inputs.
+  The type of ADC conversion executed can be changed by setting the associated global variables:
+ |Variable|Function                                      |
+ |--------|----------------------------------------------|
+ | MD     | Determines the filter corner of the ADC      |
+ | CHG    | Determines which GPIO channels are converted |
+
+
+Command Code:
+-------------
+
+|CMD[0:1]	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
+|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
+|ADAX:	    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CHG[2]| CHG[1]| CHG[0]|
+*********************************************************************************************************/
+void LTC6804_adax(ltc68041ChainHandle * hbms)
+{
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, hbms->ADAX, CMD_LEN);
+
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+
+   // Transmit the command via DMA
+   LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
+}
+/*
+  LTC6804_adax Function sequence:
+
+  1. Load adax command and its PEC (computed by set_adc) into cmd array
+  3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
+  4. send broadcast adax command to LTC6804 daisy chain
+*/
+
+/***********************************************//**
+ \brief Returns the duration of a conversion with the current set_adc() settings
+
+ The ADCOPT bit of IC 0's configuration selects between the two modes of each MD.
+
+ @param[in] uint8_t conv; LTC6804_CONV_CELL (ADCV), LTC6804_CONV_AUX (ADAX), LTC6804_CONV_CVAX (ADCVAX)
+ LTC6804_CONV_STAT (ADSTAT), LTC6804_CONV_DIAGN (DIAGN) or LTC6804_CONV_ALL (ADOW, CVST, AXST)
+
+ @return uint32_t, Conversion time in us
+ *************************************************/
+uint32_t LTC6804_convTime(ltc68041ChainHandle * hbms, uint8_t conv)
+{
+	uint8_t adcopt = (hbms->boardConfigs)[0][0] & 0x01;
+	uint8_t ch = (conv == LTC6804_CONV_AUX) ? hbms->adcCHG : hbms->adcCH;
+
+	if(conv == LTC6804_CONV_CVAX)
+	{
+		return convTimeCvax[hbms->adcMD][adcopt];
+	}
+	if(conv == LTC6804_CONV_STAT)
+	{
+		return convTimeStat[hbms->adcMD][adcopt];
+	}
+	if(conv == LTC6804_CONV_DIAGN)
+	{
+		return(((hbms->boardConfigs)[0][0] & 0x04) ? 400 : 4500);	// Reference up (REFON) or from standby
+	}
+	if((conv == LTC6804_CONV_ALL) || (ch == 0))
+	{
+		return convTimeAll[hbms->adcMD][adcopt];
+	}
+	return convTimeSingle[hbms->adcMD][adcopt];
+}
+
+/***********************************************//**
+ \brief Polls the ADC conversion status of the chain (PLADC)
+
+ Each LTC6804 holds its data output low while converting, so the byte clocked
+ out after the command reads 0xFF only once every IC in the chain is done.
+
+ @return int8_t, Conversion status.
+
+		1: Conversions complete
+
+		0: Conversion in progress
+
+		-2: Transfer failed (DMA error or timeout)
+ *************************************************/
+int8_t LTC6804_pladc(ltc68041ChainHandle * hbms)
+{
+  //1
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, cmdPLADC, CMD_LEN);
+  (hbms->spiTxBuf)[CMD_LEN] = 0xFF;
+
+  //2
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+
+  //3
+  // Flush spi Rx FIFO
+  LTC6804_rxFlush(hbms);
+  LTC6804_xferArm(hbms);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + 1);
+  if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+  {
+    return(-2);
+  }
+
+  //4
+  return(((hbms->spiRxBuf)[CMD_LEN] == 0xFF) ? 1 : 0);
+}
+/*
+  LTC6804_pladc Function sequence:
+
+  1. Load the PLADC command and its precomputed PEC, followed by one byte to clock out the status
+  2. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
+  3. Send PLADC and read back the status byte
+  4. Conversions are done when the status byte reads back high
+*/
+
+/***********************************************//**
+ \brief Waits for a conversion started at tick start to complete
+
+ Sleeps for the whole milliseconds of LTC6804_convTime() not yet elapsed, then
+ polls PLADC for the remainder instead of rounding the sleep up to the next tick.
+ A conversion still busy after the first poll is polled once per tick, so a
+ long or mispriced conversion does not keep the bus and the CPU busy.
+
+ @param[in] uint8_t conv; Any LTC6804_CONV_ conversion (see LTC6804_convTime())
+
+ @param[in] uint32_t start; osKernelSysTick() when the conversion command was sent
+
+ @return int8_t, Conversion status.
+
+		0: Conversion complete
+
+		-2: Transfer failed, or the conversion did not complete LTC6804_XFER_TIMEOUT_MS past its expected time
+ *************************************************/
+int8_t LTC6804_convWait(ltc68041ChainHandle * hbms, uint8_t conv, uint32_t start)
+{
+	uint32_t convTicks = osKernelSysTickMicroSec(LTC6804_convTime(hbms, conv));	// Whole ticks of the conversion, rounded down
+	uint32_t elapsed = osKernelSysTick() - start;
+	uint32_t deadline = convTicks + osKernelSysTickMicroSec(LTC6804_XFER_TIMEOUT_MS * 1000);
+	int8_t status;
+
+	if(elapsed < convTicks)
+	{
+		osDelay(convTicks - elapsed);
+	}
+
+	while((status = LTC6804_pladc(hbms)) == 0)
+	{
+		if((osKernelSysTick() - start) > deadline)
+		{
+			return(-2);
+		}
+		osDelay(1);
+	}
+	return((status == 1) ? 0 : -2);
+}
+
+/***********************************************//**
+ \brief Accounts one read in the link quality window (see LTC6804_linkAdapt())
+
+ @param[in] int8_t status; The read's return; transfer failures are not counted
+ *************************************************/
+static void LTC6804_linkCount(ltc68041ChainHandle * hbms, int8_t status)
+{
+	if(status == -2)
+	{
+		return;
+	}
+	hbms->link.reads[hbms->link.level]++;
+	hbms->link.winReads++;
+	if(status == -1)
+	{
+		for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+		{
+			if(hbms->pecErrIC & (1UL << ic))
+			{
+				(hbms->linkIcErrs)[ic]++;
+				hbms->link.errors[hbms->link.level]++;
+			}
+		}
+	}
+}
+
+/***********************************************//**
+ \brief Reads one register group alone (LTC6804_GRP_*), for LTC6804_readRetry()
+
+ @return int8_t, Status of the read (see LTC6804_rdcv()).
+ *************************************************/
+static int8_t LTC6804_rdGroup(ltc68041ChainHandle * hbms, uint8_t grp)
+{
+	if(grp <= LTC6804_GRP_CVD)
+	{
+		return(LTC6804_rdcv(hbms, grp - LTC6804_GRP_CVA + 1));
+	}
+	else if(grp <= LTC6804_GRP_AUXB)
+	{
+		return(LTC6804_rdaux(hbms, grp - LTC6804_GRP_AUXA + 1));
+	}
+	else if(grp <= LTC6804_GRP_STATB)
+	{
+		return(LTC6804_rdstat(hbms, grp - LTC6804_GRP_STATA + 1));
+	}
+	return(LTC6804_rdcfg(hbms));
+}
+
+/***********************************************//**
+ \brief Reads back registers, re-reading only the groups failing PEC
+
+ The registers keep their contents until the next conversion, so a PEC error
+ is retried up to LTC6804_PEC_RETRIES times without converting again. Each
+ retry re-reads only the groups of the range that failed on some IC (pecMap),
+ one group at a time, instead of repeating the whole read. Retried groups and
+ failures are counted in the chain's health counters.
+
+ @param[in] read; Full read of groups first to last
+
+ @param[in] uint8_t first, last; LTC6804_GRP_* range covered by read
+
+ @return int8_t, Status of the last read (see LTC6804_rdcv()), pecErrIC
+ holds the ICs still failing in any group of the range.
+ *************************************************/
+static int8_t LTC6804_readRetry(ltc68041ChainHandle * hbms, int8_t (*read)(ltc68041ChainHandle *, uint8_t),
+		uint8_t first, uint8_t last)
+{
+	int8_t status = read(hbms, 0);
+	int8_t grpStatus;
+	uint32_t errIC;
+
+	//1
+	LTC6804_linkCount(hbms, status);
+	for(uint8_t retry = 0; (status == -1) && (retry < LTC6804_PEC_RETRIES); retry++)
+	{
+		//2
+		status = 0;
+		errIC = 0;
+		for(uint8_t grp = first; grp <= last; grp++)
+		{
+			if(!LTC6804_pecGroupIC(hbms, grp))
+			{
+				continue;
+			}
+			hbms->health.pecRetries++;
+			grpStatus = LTC6804_rdGroup(hbms, grp);
+			LTC6804_linkCount(hbms, grpStatus);
+			if(grpStatus == -2)
+			{
+				status = -2;
+				break;
+			}
+			errIC |= hbms->pecErrIC;
+		}
+
+		//3
+		if(status == 0)
+		{
+			for(uint8_t grp = first; grp <= last; grp++)
+			{
+				errIC |= LTC6804_pecGroupIC(hbms, grp);
+			}
+			hbms->pecErrIC = errIC;
+			status = errIC ? -1 : 0;
+		}
+	}
+
+	if(status == -1)
+	{
+		hbms->health.pecFails++;
+	}
+	else if(status == -2)
+	{
+		hbms->health.xferFails++;
+	}
+	return(status);
+}
+/*
+  LTC6804_readRetry Function sequence:
+
+  1. Read all the groups of the range at once
+  2. On a PEC error, re-read each group of the range that failed on any IC (pecMap)
+  3. Collect the ICs still failing in the range, repeat 2 up to LTC6804_PEC_RETRIES times
+*/
+
+/***********************************************//**
+ \brief Reads status group B only (VD and the OV/UV flags), for LTC6804_readRetry()
+ *************************************************/
+static int8_t LTC6804_rdstatFlags(ltc68041ChainHandle * hbms, uint8_t reg)
+{
+	return(LTC6804_rdstat(hbms, 2));
+}
+
+/***********************************************//**
+ \brief Runs one overlapped scan
+
+ Any aux conversion left pending by the previous scan is read back while the
+ cells convert, and a requested ADAX is started as soon as the cells are read,
+ so it completes while the caller waits for its next period. auxVolts
+ therefore lag cellVolts by one scan.
+
+ Every cell scan also reads status group B, so the OV/UV flags in boardStat
+ are from the same conversion as cellVolts. A status scan converts and reads
+ both status groups (SOC, ITMP, VA, VD) before the ADAX is started.
+
+ @param[in] uint8_t scans; Any of LTC6804_SCAN_CELL, LTC6804_SCAN_AUX and LTC6804_SCAN_STAT
+
+ @return int8_t, Worst status of the reads (see LTC6804_rdcv()).
+ *************************************************/
+int8_t LTC6804_scan(ltc68041ChainHandle * hbms, uint8_t scans)
+{
+	int8_t retVal = 0;
+	int8_t status;
+
+	//1
+	if(hbms->auxPending)
+	{
+		if(LTC6804_convWait(hbms, LTC6804_CONV_AUX, hbms->convStart))
+		{
+			hbms->health.xferFails++;
+			return(-2);
+		}
+	}
+
+	if(scans & LTC6804_SCAN_CELL)
+	{
+		LTC6804_adcv(hbms);
+		hbms->convStart = osKernelSysTick();
+		LTC6804_spiWaitIdle(hbms);
+	}
+
+	//2
+	if(hbms->auxPending)
+	{
+		hbms->auxPending = 0;
+		retVal = LTC6804_readRetry(hbms, LTC6804_rdaux, LTC6804_GRP_AUXA, LTC6804_GRP_AUXB);
+	}
+
+	//3
+	if(scans & LTC6804_SCAN_CELL)
+	{
+		if(LTC6804_convWait(hbms, LTC6804_CONV_CELL, hbms->convStart))
+		{
+			hbms->health.xferFails++;
+			return(-2);
+		}
+		status = LTC6804_readRetry(hbms, LTC6804_rdcv, LTC6804_GRP_CVA, LTC6804_GRP_CVD);
+		if(status < retVal)
+		{
+			retVal = status;
+		}
+		if(!(scans & LTC6804_SCAN_STAT))
+		{
+			status = LTC6804_readRetry(hbms, LTC6804_rdstatFlags, LTC6804_GRP_STATB, LTC6804_GRP_STATB);
+			if(status < retVal)
+			{
+				retVal = status;
+			}
+		}
+	}
+
+	//4
+	if(scans & LTC6804_SCAN_STAT)
+	{
+		LTC6804_adstat(hbms);
+		hbms->convStart = osKernelSysTick();
+		LTC6804_spiWaitIdle(hbms);
+		if(LTC6804_convWait(hbms, LTC6804_CONV_STAT, hbms->convStart))
+		{
+			hbms->health.xferFails++;
+			return(-2);
+		}
+		status = LTC6804_readRetry(hbms, LTC6804_rdstat, LTC6804_GRP_STATA, LTC6804_GRP_STATB);
+		if(status < retVal)
+		{
+			retVal = status;
+		}
+	}
+
+	//5
+	if(scans & LTC6804_SCAN_AUX)
+	{
+		LTC6804_adax(hbms);
+		hbms->convStart = osKernelSysTick();
+		hbms->auxPending = 1;
+	}
+
+	return(retVal);
+}
+/*
+  LTC6804_scan Function sequence:
+
+  1. Wait for a pending ADAX to complete, then start ADCV
+  2. Read back the pending aux conversion while the cells convert
+  3. Wait out the cell conversion time, then read all cell voltage groups and the OV/UV flags
+  4. Convert and read both status groups if requested
+  5. Start the next aux conversion if requested
+  Only the register groups failing PEC are re-read (LTC6804_readRetry())
+*/
+
+/*!*********************************************************************************************
+  \brief Starts a combined cell and GPIO1/GPIO2 conversion
+
+  All 12 cells are converted followed by GPIO1 and GPIO2, with the MD and DCP
+  set by set_adc(). Read the results with LTC6804_rdcvax().
+
+Command Code:
+-------------
+
+|CMD[0:1]	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
+|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
+|ADCVAX:    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] |   1   |   1   |  DCP  |   1   |   1   |   1   |   1   |
+***********************************************************************************************/
+void LTC6804_adcvax(ltc68041ChainHandle * hbms)
+{
+  //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, hbms->ADCVAX, CMD_LEN);
+
+  //3
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+
+  //4
+  // Transmit the command via DMA
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
+}
+/*
+  LTC6804_adcvax Function sequence:
+
+  1. Load adcvax command and its PEC (computed by set_adc) into cmd array
+  3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
+  4. send broadcast adcvax command to LTC6804 daisy chain
+*/
+
+/***********************************************//**
+ \brief Adapts LTC6804_rdcvax() to LTC6804_readRetry()
+ *************************************************/
+static int8_t LTC6804_rdcvaxReg(ltc68041ChainHandle * hbms, uint8_t reg)
+{
+	return(LTC6804_rdcvax(hbms));
+}
+
+/***********************************************//**
+ \brief Runs one combined cell and GPIO1/GPIO2 scan
+
+ One ADCVAX conversion and one five-group job list replace the ADCV, ADAX and
+ separate reads of LTC6804_scan(). Only aux group A (GPIO1, GPIO2) is updated,
+ and unlike LTC6804_scan() it is from the same conversion cycle as the cells.
+
+ @return int8_t, PEC Status (see LTC6804_rdcvax()).
+ *************************************************/
+int8_t LTC6804_scanCvax(ltc68041ChainHandle * hbms)
+{
+	//1
+	if(hbms->auxPending)
+	{
+		hbms->auxPending = 0;								// Overwritten by ADCVAX before it is read
+		if(LTC6804_convWait(hbms, LTC6804_CONV_AUX, hbms->convStart))
+		{
+			hbms->health.xferFails++;
+			return(-2);
+		}
+	}
+	LTC6804_adcvax(hbms);
+	hbms->convStart = osKernelSysTick();
+
+	//2
+	LTC6804_spiWaitIdle(hbms);
+	if(LTC6804_convWait(hbms, LTC6804_CONV_CVAX, hbms->convStart))
+	{
+		hbms->health.xferFails++;
+		return(-2);
+	}
+
+	//3
+	return(LTC6804_readRetry(hbms, LTC6804_rdcvaxReg, LTC6804_GRP_CVA, LTC6804_GRP_AUXA));
+}
+/*
+  LTC6804_scanCvax Function sequence:
+
+  1. Wait for any aux conversion started by LTC6804_scan() to complete, then start ADCVAX
+  2. Wait out the combined conversion time
+  3. Read all cell voltage groups and aux group A in one job list
+*/
+
+
+/*!*******************************************************************************************************************
+ \brief Loads a 2-byte command code and its PEC into a 4-byte command template
+ ******************************************************************************************************************/
+static void LTC6804_setCmd(uint8_t * cmd, uint16_t code)
+{
+  uint16_t cmd_pec;
+
+  cmd[0] = (uint8_t)(code >> 8);
+  cmd[1] = (uint8_t)(code);
+  cmd_pec = pec15_calc(2, cmd);
+  cmd[2] = (uint8_t)(cmd_pec >> 8);
+  cmd[3] = (uint8_t)(cmd_pec);
+}
+
+/*!*******************************************************************************************************************
+ \brief Maps  global ADC control variables to the appropriate control bytes for each of the different ADC commands
+
+ The PEC of every ADC and self-test command is computed here once, so issuing
+ any of them later is just a 4-byte copy of the template.
+
+@param[in] uint8_t MD The adc conversion mode
+@param[in] uint8_t DCP Controls if Discharge is permitted during cell conversions
+@param[in] uint8_t CH Determines which cells are measured during an ADC conversion command
+@param[in] uint8_t CHG Determines which GPIO channels are measured during Auxiliary conversion command
+
+Command Code:
+-------------
+
+|command	|  15   |  14   |  13   |  12   |  11   |  10   |   9   |   8   |   7   |   6   |   5   |   4   |   3   |   2   |   1   |   0   |
+|-----------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|-------|
+|ADCV:	    |   0   |   0   |   0   |   0   |   0   |   0   |   1   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CH[2] | CH[1] | CH[0] |
+|ADAX:	    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] |   1   |   1   |  DCP  |   0   | CHG[2]| CHG[1]| CHG[0]|
+|CVST:	    |   0   |   0   |   0   |   0   |   0   |   0   |   1   | MD[1] | MD[2] | ST[1] | ST[0] |   0   |   0   |   1   |   1   |   1   |
+|AXST:	    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] | ST[1] | ST[0] |   0   |   0   |   1   |   1   |   1   |
+|STATST:    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] | ST[1] | ST[0] |   0   |   1   |   1   |   1   |   1   |
+|ADSTAT:    |   0   |   0   |   0   |   0   |   0   |   1   |   0   | MD[1] | MD[2] |   1   |   1   |   0   |   1   |CHST[2]|CHST[1]|CHST[0]|
+|ADOW:      |   0   |   0   |   0   |   0   |   0   |   0   |   1   | MD[1] | MD[2] |  PUP  |   1   |  DCP  |   1   | CH[2] | CH[1] | CH[0] |
+ ******************************************************************************************************************/
+void set_adc(ltc68041ChainHandle * hbms,
+			 uint8_t MD, //ADC Mode
+			 uint8_t DCP, //Discharge Permit
+			 uint8_t CH, //Cell Channels to be measured
+			 uint8_t CHG //GPIO Channels to be measured
+			 )
+{
+  uint16_t md_bits;
+
+  // Setter functions; no SPI transmissions
+  md_bits = (uint16_t)(MD & 0x03) << 7;
+  hbms->adcMD = MD & 0x03;
+  hbms->adcCH = CH;
+  hbms->adcCHG = CHG;
+  hbms->adcDCP = DCP;
+  LTC6804_setCmd(hbms->ADCV, 0x0260 | md_bits | (DCP << 4) | CH);
+  LTC6804_setCmd(hbms->ADAX, 0x0460 | md_bits | CHG);
+  LTC6804_setCmd(hbms->ADCVAX, 0x046F | md_bits | (DCP << 4));
+
+  // Self-test mode 2 for the digital filter tests; ADSTAT converts all status groups
+  LTC6804_setCmd(hbms->CVST, 0x0207 | md_bits | (0x02 << 5));
+  LTC6804_setCmd(hbms->AXST, 0x0407 | md_bits | (0x02 << 5));
+  LTC6804_setCmd(hbms->STATST, 0x040F | md_bits | (0x02 << 5));
+  LTC6804_setCmd(hbms->ADSTAT, 0x0468 | md_bits);
+
+  // Open wire check, all cells with the pull-up and with the pull-down current
+  LTC6804_setCmd(hbms->ADOWPU, 0x0228 | md_bits | (1 << 6) | (DCP << 4));
+  LTC6804_setCmd(hbms->ADOWPD, 0x0228 | md_bits | (DCP << 4));
+}
+
+
+/***********************************************************************************//**
+ \brief Reads and parses the LTC6804 auxiliary registers.
+
+ The function is used
+ to read the  parsed GPIO codes of the LTC6804. This function will send the requested
+ read commands parse the data and store the gpio voltages in aux_codes variable
+
+@param[in] uint8_t reg; This controls which GPIO voltage register is read back.
+
+          0: Read back all auxiliary registers
+
+          1: Read back auxiliary group A
+
+          2: Read back auxiliary group B
+
+
+@param[in] uint8_t total_ic; This is the number of ICs in the daisy chain(-1 only)
+
+
+ @param[out] uint16_t aux_codes[][6]; A two dimensional array of the gpio voltage codes. The GPIO codes will
+ be stored in the aux_codes[][6] array in the following format:
+ |  aux_codes[0][0]| aux_codes[0][1] |  aux_codes[0][2]|  aux_codes[0][3]|  aux_codes[0][4]|  aux_codes[0][5]| aux_codes[1][0] |aux_codes[1][1]|  .....    |
+ |-----------------|-----------------|-----------------|-----------------|-----------------|-----------------|-----------------|---------------|-----------|
+ |IC1 GPIO1        |IC1 GPIO2        |IC1 GPIO3        |IC1 GPIO4        |IC1 GPIO5        |IC1 Vref2        |IC2 GPIO1        |IC2 GPIO2      |  .....    |
+
+@return  int8_t, PEC Status
+
+  0: No PEC error detected
+
+ -1: PEC error detected, retry read
+
+ -2: Transfer failed (DMA error or timeout)
+ *************************************************/
+int8_t LTC6804_rdaux(ltc68041ChainHandle * hbms, uint8_t reg)
+{
+  uint32_t pec_errors = 0;
+  TRACE_BEGIN(TRACE_RDAUX);
+
+  //1.a
+  if (reg == 0)
+  {
+	//a.i
+    for(uint8_t gpio_reg = 1; gpio_reg <= NUM_AUX_REG; gpio_reg++)		 	   		 			//executes once for each of the LTC6804 aux voltage registers
+    {
+      LTC6804_rdaux_reg(hbms, gpio_reg);											//Reads the raw auxiliary register data into the data[] array
+      if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+      {
+        return(-2);														// Transfer failed, nothing to parse
+      }
+
+      //a.ii, a.iii
+      TRACE_BEGIN(TRACE_PARSE_AUX);
+      pec_errors |= LTC6804_pecNote(hbms, LTC6804_GRP_AUXA + gpio_reg - 1,
+    		  LTC6804_parseGroup(&((hbms->spiRxBuf)[CMD_LEN]), hbms->numIC,
+    		  &((hbms->auxVolts)[0][(gpio_reg - 1) * GPIO_IN_REG]), REG_BYTES));
+      TRACE_END(TRACE_PARSE_AUX);
+    }
+  }
+  else
+  {
+	//b.i
+    LTC6804_rdaux_reg(hbms, reg);
+    if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+    {
+      return(-2);														// Transfer failed, nothing to parse
+    }
+
+    //b.ii, b.iii
+    TRACE_BEGIN(TRACE_PARSE_AUX);
+    pec_errors = LTC6804_pecNote(hbms, LTC6804_GRP_AUXA + reg - 1,
+    		LTC6804_parseGroup(&((hbms->spiRxBuf)[CMD_LEN]), hbms->numIC,
+    		&((hbms->auxVolts)[0][(reg - 1) * GPIO_IN_REG]), REG_BYTES));
+    TRACE_END(TRACE_PARSE_AUX);
+  }
+  hbms->pecErrIC = pec_errors;
+  TRACE_END(TRACE_RDAUX);
+  return (pec_errors ? -1 : 0);
+}
+/*
+	LTC6804_rdaux Sequence
+
+	1. Switch Statement:
+		a. Reg = 0
+			i. Read GPIO voltage registers A-D for every IC in the daisy chain
+			ii. Parse raw GPIO voltage data in cell_codes array
+			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
+		b. Reg != 0
+			i.Read single GPIO voltage register for all ICs in daisy chain
+			ii. Parse raw GPIO voltage data in cell_codes array
+			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
+	2. Return pec_error flag
+*/
+
+/***********************************************//**
+ \brief Sends a write-only command (conversion or diagnostic start) via DMA
+ *************************************************/
+static void LTC6804_sendCmd(ltc68041ChainHandle * hbms, const uint8_t * cmd)
+{
+  //1
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, cmd, CMD_LEN);
+
+  //3
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+
+  //4
+  // Transmit the command via DMA
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
+}
+
+/***********************************************//**
+ \brief Returns the code self-test 2 reads back with the current set_adc() mode
+ *************************************************/
+static uint16_t LTC6804_stCode(ltc68041ChainHandle * hbms, uint16_t code)
+{
+	// Every mode reads back code except 27kHz and 14kHz
+	if(hbms->adcMD == MD_FAST)
+	{
+		return(((hbms->boardConfigs)[0][0] & 0x01) ? 0x6AAC : 0x6A9A);
+	}
+	return(code);
+}
+
+/***********************************************//**
+ \brief Checks the self-test codes of one group slot of a pipelined read
+
+ The codes are checked in spiRxBuf, so cellVolts, auxVolts and boardStat
+ keep the last measurements.
+
+ @param[in] uint8_t stage; Group slot (see LTC6804_pipeStart())
+
+ @param[in] uint8_t codes; Number of codes checked, from the first of the group
+
+ @return uint32_t, bit n set if IC n failed the PEC check or returned another code
+ *************************************************/
+static uint32_t LTC6804_stCheck(ltc68041ChainHandle * hbms, uint8_t stage, uint8_t codes, uint16_t expected)
+{
+	uint32_t failIC = 0;
+	const uint8_t * rx = &((hbms->spiRxBuf)[stage * LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]);
+
+	for(uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++)
+	{
+		if(!LTC6804_pecOk(rx))
+		{
+			failIC |= (1UL << current_ic);
+		}
+		for(uint8_t code = 0; code < codes; code++)
+		{
+			if((rx[2 * code] | ((uint16_t)rx[2 * code + 1] << 8)) != expected)
+			{
+				failIC |= (1UL << current_ic);
+			}
+		}
+		rx += BYTES_IN_REG;
+	}
+	return failIC;
+}
+
+/***********************************************//**
+ \brief Starts a command, waits for it to complete and reads back register groups
+
+ @param[in] const uint8_t * cmd; Self-test or diagnostic command with its PEC
+
+ @param[in] uint8_t conv; Conversion timed by LTC6804_convTime()
+
+ @param[in] const uint8_t * const rdCmds[]; Read commands, one per group slot
+
+ @return int8_t, 0: read back, -2: transfer failed or the command did not complete
+ *************************************************/
+static int8_t LTC6804_stConvRead(ltc68041ChainHandle * hbms, const uint8_t * cmd, uint8_t conv,
+		const uint8_t * const rdCmds[], uint8_t stages)
+{
+	uint32_t start;
+
+	//1
+	LTC6804_sendCmd(hbms, cmd);
+	start = osKernelSysTick();
+	LTC6804_spiWaitIdle(hbms);
+
+	//2
+	if(LTC6804_convWait(hbms, conv, start))
+	{
+		return(-2);
+	}
+
+	//3
+	LTC6804_pipeStart(hbms, rdCmds, stages);
+	if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+	{
+		return(-2);
+	}
+	return(0);
+}
+/*
+  LTC6804_stConvRead Function sequence:
+
+  1. Send the command
+  2. Wait out its conversion time, then poll PLADC until the chain is done
+  3. Read the register groups back as one job list into their spiRxBuf slots
+*/
+
+/***********************************************//**
+ \brief Cell voltage ADC self-test (CVST, self-test 2)
+
+ Every cell code of every IC must read back the self-test pattern.
+ The ICs failing are left in diagFailIC.
+
+ @return int8_t, 0: passed, -1: failed, -2: transfer failed
+ *************************************************/
+int8_t LTC6804_cvTest(ltc68041ChainHandle * hbms)
+{
+	static const uint8_t * const cmds[NUM_CV_REG] = {cmdRDCV[0], cmdRDCV[1], cmdRDCV[2], cmdRDCV[3]};
+	uint16_t expected = LTC6804_stCode(hbms, cvTestPos);
+
+	hbms->diagFailIC = 0;
+	if(LTC6804_stConvRead(hbms, hbms->CVST, LTC6804_CONV_ALL, cmds, NUM_CV_REG))
+	{
+		return(-2);
+	}
+	for(uint8_t cell_reg = 0; cell_reg < NUM_CV_REG; cell_reg++)
+	{
+		hbms->diagFailIC |= LTC6804_stCheck(hbms, cell_reg, CELL_IN_REG, expected);
+	}
+	return(hbms->diagFailIC ? -1 : 0);
+}
+
+/***********************************************//**
+ \brief Auxiliary ADC self-test (AXST, self-test 2)
+
+ GPIO1-5 and REF2 of every IC must read back the self-test pattern.
+ The ICs failing are left in diagFailIC.
+
+ @return int8_t, 0: passed, -1: failed, -2: transfer failed
+ *************************************************/
+int8_t LTC6804_auxTest(ltc68041ChainHandle * hbms)
+{
+	static const uint8_t * const cmds[NUM_AUX_REG] = {cmdRDAUX[0], cmdRDAUX[1]};
+	uint16_t expected = LTC6804_stCode(hbms, axTestPos);
+
+	hbms->diagFailIC = 0;
+	if(LTC6804_stConvRead(hbms, hbms->AXST, LTC6804_CONV_ALL, cmds, NUM_AUX_REG))
+	{
+		return(-2);
+	}
+	for(uint8_t aux_reg = 0; aux_reg < NUM_AUX_REG; aux_reg++)
+	{
+		hbms->diagFailIC |= LTC6804_stCheck(hbms, aux_reg, GPIO_IN_REG, expected);
+	}
+	return(hbms->diagFailIC ? -1 : 0);
+}
+
+/***********************************************//**
+ \brief Status group ADC self-test (STATST, self-test 2)
+
+ SOC, ITMP, VA (group A) and VD (first code of group B) of every IC must
+ read back the self-test pattern. The ICs failing are left in diagFailIC.
+
+ @return int8_t, 0: passed, -1: failed, -2: transfer failed
+ *************************************************/
+int8_t LTC6804_statTest(ltc68041ChainHandle * hbms)
+{
+	static const uint8_t * const cmds[NUM_STAT_REG] = {cmdRDSTAT[0], cmdRDSTAT[1]};
+	uint16_t expected = LTC6804_stCode(hbms, statTestPos);
+
+	hbms->diagFailIC = 0;
+	if(LTC6804_stConvRead(hbms, hbms->STATST, LTC6804_CONV_STAT, cmds, NUM_STAT_REG))
+	{
+		return(-2);
+	}
+	hbms->diagFailIC = LTC6804_stCheck(hbms, 0, STAT_IN_REG, expected) | LTC6804_stCheck(hbms, 1, 1, expected);
+	return(hbms->diagFailIC ? -1 : 0);
+}
+
+/***********************************************//**
+ \brief Multiplexer decoder check (DIAGN)
+
+ MUXFAIL (status group B) must read back 0 on every IC; it is also set at
+ power up and by CLRSTAT until DIAGN runs. The ICs failing are left in diagFailIC.
+
+ @return int8_t, 0: passed, -1: failed, -2: transfer failed
+ *************************************************/
+int8_t LTC6804_muxTest(ltc68041ChainHandle * hbms)
+{
+	static const uint8_t * const cmds[1] = {cmdRDSTAT[1]};
+	const uint8_t * rx;
+
+	hbms->diagFailIC = 0;
+	if(LTC6804_stConvRead(hbms, cmdDIAGN, LTC6804_CONV_DIAGN, cmds, 1))
+	{
+		return(-2);
+	}
+
+	rx = &((hbms->spiRxBuf)[CMD_LEN]);
+	for(uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++)
+	{
+		// MUXFAIL bit set
+		if(!LTC6804_pecOk(rx) || ((rx[5] >> 1) & 0x1))
+		{
+			hbms->diagFailIC |= (1UL << current_ic);
+		}
+		rx += BYTES_IN_REG;
+	}
+	return(hbms->diagFailIC ? -1 : 0);
+}
+
+/***********************************************//**
+ \brief Internal supply check (ADSTAT)
+
+ VA must be within 4.5V to 5.5V and VD within 2.7V to 3.6V on every IC.
+ The ICs failing are left in diagFailIC.
+
+ @return int8_t, 0: passed, -1: failed, -2: transfer failed
+ *************************************************/
+int8_t LTC6804_internalTest(ltc68041ChainHandle * hbms)
+{
+	static const uint8_t * const cmds[NUM_STAT_REG] = {cmdRDSTAT[0], cmdRDSTAT[1]};
+	const uint8_t * rxA = &((hbms->spiRxBuf)[CMD_LEN]);
+	const uint8_t * rxB = &((hbms->spiRxBuf)[LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]);
+	uint16_t va, vd;
+
+	hbms->diagFailIC = 0;
+	if(LTC6804_stConvRead(hbms, hbms->ADSTAT, LTC6804_CONV_STAT, cmds, NUM_STAT_REG))
+	{
+		return(-2);
+	}
+
+	for(uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++)
+	{
+		va = rxA[4] | ((uint16_t)rxA[5] << 8);
+		vd = rxB[0] | ((uint16_t)rxB[1] << 8);
+
+		// Analog power supply (4.5V <= Va <= 5.5V), digital power supply (2.7V <= Vd <= 3.6V)
+		if(!LTC6804_pecOk(rxA) || !LTC6804_pecOk(rxB) ||
+				(va > 55000) || (va < 45000) || (vd > 36000) || (vd < 27000))
+		{
+			hbms->diagFailIC |= (1UL << current_ic);
+		}
+		rxA += BYTES_IN_REG;
+		rxB += BYTES_IN_REG;
+	}
+	return(hbms->diagFailIC ? -1 : 0);
+}
+
+/***********************************************//**
+ \brief Open wire check (ADOW), one phase per call
+
+ The datasheet procedure in two phases, so each fits one diagnostic slice
+ and the cell scans go on in between:
+	Phase 0: LTC6804_OW_REPEATS ADOW conversions with the pull-up current, read into owPU
+	Phase 1: the same with the pull-down current into owPD, then the evaluation
+ A wire is open when:
+	C0: owPU of cell 1 reads 0
+	Cn (n = 1 to 11): owPD - owPU of cell n + 1 is more than LTC6804_OW_THRESHOLD
+	C12: owPD of cell 12 reads 0
+ The open wires of each IC are left in owOpen (bit n = Cn) and the ICs with
+ any open wire in diagFailIC. cellVolts is not touched. PEC errors of the
+ reads go to pecErrIC, pecMap/pecCount and the link window like a scan read's.
+
+ @return int8_t, 1: phase 0 done (or a read failed PEC, restarted), call again
+
+		0: no open wire
+
+		-1: open wire found
+
+		-2: transfer failed or a conversion did not complete, restarted
+ *************************************************/
+int8_t LTC6804_owTest(ltc68041ChainHandle * hbms)
+{
+	static const uint8_t * const cmds[NUM_CV_REG] = {cmdRDCV[0], cmdRDCV[1], cmdRDCV[2], cmdRDCV[3]};
+	uint8_t pup = (hbms->owPhase == 0);
+	uint16_t (*dst)[12] = pup ? hbms->owPU : hbms->owPD;
+	uint32_t pec_errors = 0;
+	uint32_t start;
+	uint16_t open;
+
+	//1
+	for(uint8_t repeat = 0; repeat < LTC6804_OW_REPEATS; repeat++)
+	{
+		LTC6804_sendCmd(hbms, pup ? hbms->ADOWPU : hbms->ADOWPD);
+		start = osKernelSysTick();
+		LTC6804_spiWaitIdle(hbms);
+		if(LTC6804_convWait(hbms, LTC6804_CONV_ALL, start))
+		{
+			hbms->owPhase = 0;
+			return(-2);
+		}
+	}
+
+	//2
+	LTC6804_pipeStart(hbms, cmds, NUM_CV_REG);
+	if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+	{
+		hbms->owPhase = 0;
+		return(-2);
+	}
+	for(uint8_t cell_reg = 0; cell_reg < NUM_CV_REG; cell_reg++)
+	{
+		pec_errors |= LTC6804_pecNote(hbms, LTC6804_GRP_CVA + cell_reg,
+				LTC6804_parseGroup(&((hbms->spiRxBuf)[cell_reg * LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]),
+				hbms->numIC, &(dst[0][cell_reg * CELL_IN_REG]), 12));
+	}
+	hbms->pecErrIC = pec_errors;
+	LTC6804_linkCount(hbms, pec_errors ? -1 : 0);						// Same link telemetry as a scan read
+	if(pec_errors)
+	{
+		hbms->health.pecFails++;
+		hbms->owPhase = 0;
+		return(1);
+	}
+	if(pup)
+	{
+		hbms->owPhase = 1;
+		return(1);
+	}
+
+	//3
+	hbms->owPhase = 0;
+	hbms->diagFailIC = 0;
+	for(uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++)
+	{
+		open = ((hbms->owPU)[current_ic][0] == 0) ? 0x0001 : 0;
+		for(uint8_t cell = 1; cell < 12; cell++)
+		{
+			if(((int32_t)(hbms->owPD)[current_ic][cell] - (hbms->owPU)[current_ic][cell]) > LTC6804_OW_THRESHOLD)
+			{
+				open |= (1 << cell);
+			}
+		}
+		if((hbms->owPD)[current_ic][11] == 0)
+		{
+			open |= (1 << 12);
+		}
+
+		(hbms->owOpen)[current_ic] = open;
+		if(open)
+		{
+			hbms->diagFailIC |= (1UL << current_ic);
+		}
+	}
+	return(hbms->diagFailIC ? -1 : 0);
+}
+/*
+  LTC6804_owTest Function sequence:
+
+  1. Run the ADOW conversions of this phase back to back
+  2. Read all cell voltage groups as one job list into owPU or owPD
+  3. After the pull-down phase, compare both phases to locate the open wires
+*/
+
+// Diagnostic rotation, indexed by LTC6804_DIAG_*
+static int8_t (* const diagTests[LTC6804_DIAG_NUM])(ltc68041ChainHandle *) = {
+	LTC6804_cvTest,
+	LTC6804_auxTest,
+	LTC6804_statTest,
+	LTC6804_muxTest,
+	LTC6804_internalTest,
+	LTC6804_owTest
+};
+
+/***********************************************//**
+ \brief Estimates the SPI bus time of a transfer in us
+ *************************************************/
+static uint32_t LTC6804_xferTime(ltc68041ChainHandle * hbms, uint32_t bytes)
+{
+	uint32_t pclk = (hbms->hspi->Instance == SPI1) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+	uint32_t sck = pclk >> (((hbms->hspi->Init.BaudRatePrescaler & SPI_CR1_BR_Msk) >> SPI_CR1_BR_Pos) + 1);
+
+	return((bytes * 8 * 1000) / (sck / 1000) + 1);
+}
+
+/***********************************************//**
+ \brief Estimates the duration of one diagnostic call in us (conversion + bus time)
+ *************************************************/
+static uint32_t LTC6804_diagCost(ltc68041ChainHandle * hbms, uint8_t test)
+{
+	static const uint8_t conv[LTC6804_DIAG_NUM] = {LTC6804_CONV_ALL, LTC6804_CONV_ALL, LTC6804_CONV_STAT, LTC6804_CONV_DIAGN, LTC6804_CONV_STAT, LTC6804_CONV_ALL};
+	static const uint8_t convs[LTC6804_DIAG_NUM] = {1, 1, 1, 1, 1, LTC6804_OW_REPEATS};
+	static const uint8_t stages[LTC6804_DIAG_NUM] = {NUM_CV_REG, NUM_AUX_REG, NUM_STAT_REG, 1, NUM_STAT_REG, NUM_CV_REG};
+
+	return(LTC6804_convTime(hbms, conv[test]) * convs[test] +
+			LTC6804_xferTime(hbms, convs[test] * CMD_LEN + stages[test] * LTC6804_XFER_LEN(hbms->numIC)));
+}
+
+/***********************************************//**
+ \brief Runs the next slice of the background diagnostic rotation
+
+ Runs the self-tests in LTC6804_DIAG_* order, resuming where the previous
+ call stopped, for as long as the estimated time of the next test fits in
+ budget. Call it from the scan task once per period, after the scan, so the
+ diagnostics cost a bounded amount of bus time each period instead of a
+ burst. A test that can never fit the budget is skipped and counted.
+ A test run in phases (LTC6804_owTest()) stays next until its last phase.
+
+ The results are kept per test in diag and per IC and test in diagHistory.
+ The measurement arrays are not touched; an aux conversion pending for the
+ next scan is restarted since the tests overwrite the aux registers.
+
+ @param[in] uint32_t budget; Bus time allowed for this slice in us
+
+ @return uint8_t, Number of tests run
+ *************************************************/
+uint8_t LTC6804_diagRun(ltc68041ChainHandle * hbms, uint32_t budget)
+{
+	uint32_t fullBudget = budget;
+	uint32_t cost;
+	uint8_t test;
+	uint8_t ran = 0;
+	int8_t status;
+
+	for(uint8_t tried = 0; tried < LTC6804_DIAG_NUM; tried++)
+	{
+		//1
+		test = hbms->diag.next;
+		cost = LTC6804_diagCost(hbms, test);
+		if(cost > budget)
+		{
+			if(cost <= fullBudget)
+			{
+				break;											// Runs first in the next slice
+			}
+			hbms->diag.skips++;
+		}
+		else
+		{
+			//2
+			budget -= cost;
+			ran++;
+			status = diagTests[test](hbms);
+			if(status == 1)
+			{
+				continue;										// More phases to run, stays next
+			}
+			if(status == -2)
+			{
+				hbms->health.xferFails++;						// No verdict, history unchanged
+			}
+			else
+			{
+				//3
+				hbms->diag.runs[test]++;
+				if(hbms->diagFailIC)
+				{
+					hbms->diag.fails[test]++;
+				}
+				for(uint8_t current_ic = 0; current_ic < hbms->numIC; current_ic++)
+				{
+					(hbms->diagHistory)[current_ic][test] = ((hbms->diagHistory)[current_ic][test] << 1) | ((hbms->diagFailIC >> current_ic) & 0x01);
+				}
+			}
+		}
+		hbms->diag.next = (test + 1) % LTC6804_DIAG_NUM;
+	}
+
+	//4
+	if(ran && hbms->auxPending)
+	{
+		LTC6804_adax(hbms);
+		hbms->convStart = osKernelSysTick();
+	}
+	return(ran);
+}
+/*
+  LTC6804_diagRun Function sequence:
+
+  1. Estimate the next test of the rotation, stop if it does not fit what is left of the budget
+  2. Run it
+  3. Shift its verdict into the history of every IC
+  4. Restart the pending aux conversion the self-tests overwrote
+*/
+
+/***********************************************//**
+ \brief Starts a conversion of all the status group values (ADSTAT)
+
+ SOC, ITMP, VA and VD are converted with the MD set by set_adc(). Wait
+ LTC6804_convTime(hbms, LTC6804_CONV_STAT), then read them with LTC6804_rdstat().
+ *************************************************/
+void LTC6804_adstat(ltc68041ChainHandle * hbms)
+{
+  //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  memcpy(hbms->spiTxBuf, hbms->ADSTAT, CMD_LEN);
+
+  //3
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake. This command can be removed.
+
+  //4
+  // Transmit the command via DMA
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, NULL, CMD_LEN);
+}
+/*
+  LTC6804_adstat Function sequence:
+
+  1. Load adstat command and its PEC (computed by set_adc) into cmd array
+  3. wakeup isoSPI port, this step can be removed if isoSPI status is previously guaranteed
+  4. send broadcast adstat command to LTC6804 daisy chain
+*/
+
+/***********************************************//**
+ \brief Read the raw data from one LTC6804 status register group
+
+ @param[in] uint8_t reg; 1: status group A, 2: status group B
+ *************************************************/
+void LTC6804_rdstat_reg(ltc68041ChainHandle * hbms, uint8_t reg)
+{
+  //1
+  // Wait for the previous command to be out before reusing the Tx buffer
+  LTC6804_spiWaitIdle(hbms);
+  if(reg == 2)		// Read back status group B
+  {
+	  memcpy(hbms->spiTxBuf, cmdRDSTAT[1], CMD_LEN);
+  }
+  else				// Read back status group A
+  {
+	  memcpy(hbms->spiTxBuf, cmdRDSTAT[0], CMD_LEN);
+  }
+
+  //3
+  wakeup_idle(hbms); //This will guarantee that the LTC6804 isoSPI port is awake, this command can be removed.
+
+  //4
+  // Flush spi Rx FIFO
+  LTC6804_rxFlush(hbms);
+  // Transmit the command via DMA
+  LTC6804_xferArm(hbms);
+  LTC6804_xferStart(hbms, hbms->spiTxBuf, hbms->spiRxBuf, CMD_LEN + (BYTES_IN_REG*hbms->numIC));
+}
+/*
+  LTC6804_rdstat_reg Function Process:
+  1. Determine Command and copy it with its precomputed PEC into the command array
+  3. Wake up isoSPI, this step is optional
+  4. Send Global Command to LTC6804 daisy chain
+*/
+
+/***********************************************************************************//**
+ \brief Reads and parses the LTC6804 status registers into boardStat
+
+ The registers are stored as received (see STAT_SOC to STAT_FLAGS_HI), so the
+ comparator flags can be tested directly with the STAT_ masks or with
+ LTC6804_statFaultIC(). The OV/UV flags are updated by every cell conversion;
+ SOC, ITMP, VA and VD only by ADSTAT (LTC6804_adstat()).
+
+@param[in] uint8_t reg; This controls which status register is read back.
+
+          0: Read back both status groups (one job list)
+
+          1: Read back status group A (SOC, ITMP, VA)
+
+          2: Read back status group B (VD, OV/UV flags, THSD, MUXFAIL, REV)
+
+@return  int8_t, PEC Status
+
+  0: No PEC error detected
+
+ -1: PEC error detected, retry read
+
+ -2: Transfer failed (DMA error or timeout)
+ *************************************************/
+int8_t LTC6804_rdstat(ltc68041ChainHandle * hbms, uint8_t reg)
+{
+  static const uint8_t * const cmds[NUM_STAT_REG] = {cmdRDSTAT[0], cmdRDSTAT[1]};
+  uint32_t pec_errors = 0;
+  TRACE_BEGIN(TRACE_RDSTAT);
+
+  //1.a
+  if (reg == 0)
+  {
+    //a.i
+    LTC6804_pipeStart(hbms, cmds, NUM_STAT_REG);
+    if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+    {
+      return(-2);														// Transfer failed, nothing to parse
+    }
+
+    //a.ii, a.iii
+    for(uint8_t stat_reg = 0; stat_reg < NUM_STAT_REG; stat_reg++)
+    {
+      pec_errors |= LTC6804_pecNote(hbms, LTC6804_GRP_STATA + stat_reg,
+    		  LTC6804_parseGroup(&((hbms->spiRxBuf)[stat_reg * LTC6804_XFER_LEN(hbms->numIC) + CMD_LEN]),
+    		  hbms->numIC, &((hbms->boardStat)[0][stat_reg * STAT_IN_REG]), REG_BYTES));
+    }
+  }
+  else
+  {
+    //b.i
+    LTC6804_rdstat_reg(hbms, reg);
+    if(LTC6804_xferWait(hbms) != LTC6804_XFER_OK)
+    {
+      return(-2);														// Transfer failed, nothing to parse
+    }
+
+    //b.ii, b.iii
+    pec_errors = LTC6804_pecNote(hbms, LTC6804_GRP_STATA + reg - 1,
+    		LTC6804_parseGroup(&((hbms->spiRxBuf)[CMD_LEN]), hbms->numIC,
+    		&((hbms->boardStat)[0][(reg - 1) * STAT_IN_REG]), REG_BYTES));
+  }
+  hbms->pecErrIC = pec_errors;
+  TRACE_END(TRACE_RDSTAT);
+  return (pec_errors ? -1 : 0);
+}
+/*
+	LTC6804_rdstat Sequence
+
+	1. Switch Statement:
+		a. Reg = 0
+			i. Read status registers A and B for every IC in the daisy chain as one pipelined job list
+			ii. Copy the raw register halfwords into boardStat
+			iii. Check the PEC of the data read back vs the calculated PEC for each group of each IC
+		b. Reg != 0
+			i. Read a single status register for all ICs in daisy chain
+			ii. Copy the raw register halfwords into boardStat
+			iii. Check the PEC of the data read back vs the calculated PEC for each read register command
+	2. Return pec_error flag
+*/
+
+/***********************************************//**
+ \brief Returns the cells flagged by the over voltage comparator of one IC
+
+ @param[in] const uint16_t * stat; The IC's boardStat row (handle or frame)
+
+ @return uint16_t, bit n set if cell n + 1 is above VOV
+ *************************************************/
+uint16_t LTC6804_statOV(const uint16_t * stat)
+{
+	uint32_t flags = stat[STAT_FLAGS_LO] | ((uint32_t)(stat[STAT_FLAGS_HI] & 0xFF) << 16);	// CnOV at bit 2n - 1
+	uint16_t cells = 0;
+
+	for(uint8_t cell = 0; cell < 12; cell++)
+	{
+		cells |= ((flags >> (2 * cell + 1)) & 0x01) << cell;
+	}
+	return cells;
+}
+
+/***********************************************//**
+ \brief Returns the cells flagged by the under voltage comparator of one IC
+
+ @param[in] const uint16_t * stat; The IC's boardStat row (handle or frame)
+
+ @return uint16_t, bit n set if cell n + 1 is below VUV
+ *************************************************/
+uint16_t LTC6804_statUV(const uint16_t * stat)
+{
+	uint32_t flags = stat[STAT_FLAGS_LO] | ((uint32_t)(stat[STAT_FLAGS_HI] & 0xFF) << 16);	// CnUV at bit 2n - 2
+	uint16_t cells = 0;
+
+	for(uint8_t cell = 0; cell < 12; cell++)
+	{
+		cells |= ((flags >> (2 * cell)) & 0x01) << cell;
+	}
+	return cells;
+}
+
+/***********************************************//**
+ \brief Tests the status flags of every IC for an OV, UV or thermal shutdown fault
+
+ Two halfword tests per IC; the cell codes are not looked at. Only
+ meaningful once status group B has been read after a cell conversion
+ (every LTC6804_scan() with LTC6804_SCAN_CELL does).
+
+ @param[in] const uint16_t (*boardStat)[6]; boardStat of the handle or of a frame
+
+ @param[in] uint8_t numIC; Number of ICs in the chain (at most 32)
+
+ @return uint32_t, bit n set if IC n flags a fault (0: no faults)
+ *************************************************/
+uint32_t LTC6804_statFaultIC(const uint16_t (*boardStat)[6], uint8_t numIC)
+{
+	uint32_t faultIC = 0;
+
+	for(uint8_t ic = 0; ic < numIC; ic++)
+	{
+		if(boardStat[ic][STAT_FLAGS_LO] || (boardStat[ic][STAT_FLAGS_HI] & (STAT_HI_CELL_FLAGS | STAT_HI_THSD)))
+		{
+			faultIC |= (1UL << ic);
+		}
+	}
+	return faultIC;
+}
+
+
+/***********************************************//**
+ \brief Applies link level to the chain's SPI prescaler
+
+ Waits for the bus to be idle first. The HAL enables the SPI again at the next transfer.
+ *************************************************/
+static void LTC6804_linkSet(ltc68041ChainHandle * hbms, uint8_t level)
+{
+	uint32_t br = hbms->link.base + level;
+
+	if(br > (SPI_CR1_BR_Msk >> SPI_CR1_BR_Pos))
+	{
+		br = SPI_CR1_BR_Msk >> SPI_CR1_BR_Pos;						// Already at the slowest prescaler
+	}
+	LTC6804_spiWaitIdle(hbms);
+	__HAL_SPI_DISABLE(hbms->hspi);
+	MODIFY_REG(hbms->hspi->Instance->CR1, SPI_CR1_BR_Msk, br << SPI_CR1_BR_Pos);
+	hbms->hspi->Init.BaudRatePrescaler = br << SPI_CR1_BR_Pos;		// Keeps LTC6804_xferTime() right
+	hbms->link.level = level;
+}
+
+/***********************************************//**
+ \brief Selects the fastest SPI clock allowed and clears the link statistics
+
+ Level 0 is the smallest prescaler giving at most LTC6804_SPI_MAX_HZ from the
+ SPI's bus clock; each following level halves the clock. The prescaler only
+ divides by powers of two, so with SPI1 on the 80 MHz PCLK2 level 0 is /128,
+ 625 kHz, the rate the Cube configuration already sets: /64 would be 1.25 MHz,
+ over the LTC6804's 1 MHz. A faster start needs a SYSCLK that divides down to
+ 1 MHz (64 MHz, /64), not a smaller prescaler.
+ *************************************************/
+void LTC6804_linkInit(ltc68041ChainHandle * hbms)
+{
+	uint32_t pclk = (hbms->hspi->Instance == SPI1) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+
+	memset(&(hbms->link), 0, sizeof(hbms->link));
+	memset(hbms->linkIcErrs, 0, sizeof(uint16_t) * hbms->numIC);
+	while((hbms->link.base < (SPI_CR1_BR_Msk >> SPI_CR1_BR_Pos)) && ((pclk >> (hbms->link.base + 1)) > LTC6804_SPI_MAX_HZ))
+	{
+		hbms->link.base++;
+	}
+	for(uint8_t level = 0; level < LTC6804_LINK_LEVELS; level++)
+	{
+		hbms->link.holdoff[level] = 1;
+	}
+	LTC6804_linkSet(hbms, 0);
+}
+
+/***********************************************//**
+ \brief Steps the SPI clock on the PEC error rate of the last window
+
+ Every read of LTC6804_scan() (retries included) is accounted to the clock it
+ ran at. Once a window of LTC6804_LINK_WINDOW reads is complete:
+
+ - if any IC failed more than LTC6804_LINK_MAX_ERRS of them, the clock is
+   halved, and the level left waits twice as many clean windows as before
+   (at most LTC6804_LINK_HOLDOFF) before it is tried again;
+ - after enough error free windows the next faster level is tried.
+
+ The link never runs faster than level 0, so this does not shorten the scans of
+ a clean link: it keeps a marginal one (long harness, noisy isolation barrier)
+ reading at the fastest clock holding the target error rate, rather than
+ losing frames to PEC retries, and probes the faster one now and then. Call it
+ once per period with the bus idle and no async request outstanding.
+
+ @return int8_t, 1 clock raised, -1 clock lowered, 0 unchanged
+ *************************************************/
+int8_t LTC6804_linkAdapt(ltc68041ChainHandle * hbms)
+{
+	ltc68041Link * link = &(hbms->link);
+	uint16_t worst = 0;
+
+	//1
+	if(link->winReads < LTC6804_LINK_WINDOW)
+	{
+		return 0;
+	}
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		if((hbms->linkIcErrs)[ic] > worst)
+		{
+			worst = (hbms->linkIcErrs)[ic];
+		}
+		(hbms->linkIcErrs)[ic] = 0;
+	}
+	link->winReads = 0;
+
+	//2
+	if((worst > LTC6804_LINK_MAX_ERRS) && (link->level < LTC6804_LINK_LEVELS - 1))
+	{
+		link->holdoff[link->level] = (link->holdoff[link->level] * 2 > LTC6804_LINK_HOLDOFF) ?
+				LTC6804_LINK_HOLDOFF : link->holdoff[link->level] * 2;
+		link->clean = 0;
+		link->changes++;
+		LTC6804_linkSet(hbms, link->level + 1);
+		return -1;
+	}
+
+	//3
+	if(worst)
+	{
+		link->clean = 0;
+		return 0;
+	}
+	if((link->level > 0) && (++(link->clean) >= link->holdoff[link->level - 1]))
+	{
+		link->clean = 0;
+		link->changes++;
+		LTC6804_linkSet(hbms, link->level - 1);
+		return 1;
+	}
+	return 0;
+}
+/*
+  LTC6804_linkAdapt Function Process:
+  1. Wait for a full window, then take the worst IC's error count
+  2. Over the target: step down and back off the level left
+  3. Error free long enough: try the next faster level
+*/
+
+/***********************************************//**
+ \brief Returns the chain's current SPI clock in Hz
+ *************************************************/
+uint32_t LTC6804_linkClock(ltc68041ChainHandle * hbms)
+{
+	uint32_t pclk = (hbms->hspi->Instance == SPI1) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+
+	return(pclk >> (((hbms->hspi->Init.BaudRatePrescaler & SPI_CR1_BR_Msk) >> SPI_CR1_BR_Pos) + 1));
+}
@@ -6,6 +6,7 @@
  */
 
 #include "can.h"
+#include "dwtTrace.h"
 
 /*
  * This is how HAL handles the filter values:
@@ -360,6 +361,7 @@ uint32_t bxCanDoTx(uint8_t fromISR){
 	if(Can_availableForTx() && not_in_use && (fromISR ? \
 			uxQueueMessagesWaitingFromISR(*txQ) : \
 			uxQueueMessagesWaiting(*txQ))){
+		TRACE_BEGIN(TRACE_CAN_TX);
 		not_in_use = 0;		// bxCAN is now in use
 		static Can_frame_t toSend;
 		// Use the appropriate calls from different contexts to dequeue object
@@ -389,6 +391,7 @@ uint32_t bxCanDoTx(uint8_t fromISR){
 			txFrameBuf.Data[i] = toSend.Data[i];
 		}
 		HAL_CAN_Transmit_IT(hcan_handle);
+		TRACE_END(TRACE_CAN_TX);
 		return HAL_CAN_ERROR_NONE;	// Successful transmission
 	} else {
 		// When CAN is not available for Tx -> return the error code in case there are errors
@@ -0,0 +1,63 @@
+/*
+ * cellBalance.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "cellBalance.h"
+
+// Picks the cells of one IC to bleed, keeping the highest maxPerIC of them
+static uint16_t cellBalance_pick(const cellBalancer * bal, const uint16_t * cells, uint16_t lowest, uint16_t current){
+	uint16_t want = 0;
+	uint16_t pick = 0;
+	uint16_t highest;
+	uint8_t highestCell;
+
+	for(uint8_t cell = 0; cell < 12; cell++){
+		uint16_t delta = (current & (1 << cell)) ? bal->stopDelta : bal->startDelta;
+		if((cells[cell] > bal->minCell) && (cells[cell] > lowest + delta)){
+			want |= (1 << cell);
+		}
+	}
+
+	for(uint8_t n = 0; (n < bal->maxPerIC) && want; n++){
+		highest = 0;
+		highestCell = 0;
+		for(uint8_t cell = 0; cell < 12; cell++){
+			if((want & (1 << cell)) && (cells[cell] >= highest)){
+				highest = cells[cell];
+				highestCell = cell;
+			}
+		}
+		pick |= (1 << highestCell);
+		want &= ~(1 << highestCell);
+	}
+	return pick;
+}
+
+/*
+ * Updates the discharge pattern from the latest frame of the chain
+ * Call from the chain's scan task after publishing. Without a frame younger than
+ * maxAge (or when disabled) every discharge switch is turned off.
+ * Returns 1 if the configuration was written (and verified)
+ */
+uint8_t cellBalance_update(cellBalancer * bal, ltc68041ChainHandle * hbms){
+	const ltc68041Frame * frame = LTC6804_snapshotLatest(hbms);
+	uint8_t balance = bal->enabled && (frame != NULL) && ((osKernelSysTick() - frame->timestamp) <= bal->maxAge);
+	uint16_t dcc;
+
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++){
+		dcc = balance ? cellBalance_pick(bal, frame->cellVolts[ic], frame->stats.min, bal->dcc[ic]) : 0;
+		if(dcc != bal->dcc[ic]){
+			bal->dcc[ic] = dcc;
+			LTC6804_setDcc(hbms, ic, dcc);
+		}
+	}
+
+	// Only sends a WRCFG when some IC's configuration changed or is not verified yet
+	if(LTC6804_cfgSync(hbms) == 1){
+		bal->writes++;
+		return 1;
+	}
+	return 0;
+}
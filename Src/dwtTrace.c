@@ -0,0 +1,195 @@
+/*
+ * dwtTrace.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "dwtTrace.h"
+#include "cmsis_os.h"
+#include "can.h"
+#include "serial.h"
+#include <string.h>
+
+static traceStat traceStats[TRACE_NUM_PROBES];
+static uint32_t traceMarks[TRACE_NUM_PROBES];		// CYCCNT at the last TRACE_MARK() of each probe
+
+static const char * const traceNames[TRACE_NUM_PROBES] = {
+	"PEC15",
+	"WRCFG",
+	"RDCFG",
+	"RDCV",
+	"RDAUX",
+	"RDSTAT",
+	"PARSE_CV",
+	"PARSE_AUX",
+	"XFER_WAKE",
+	"CAN_TX",
+	"SERIAL_TX",
+	"SCAN",
+	"SCAN_PERIOD",
+	"PACK_STATS"
+};
+
+/*
+ * Enables the DWT cycle counter and clears all the probes
+ */
+void dwtTrace_init(){
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;		// Enable the trace block
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;				// Start the cycle counter
+	dwtTrace_reset();
+}
+
+/*
+ * Clears the statistics of all the probes
+ */
+void dwtTrace_reset(){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for(uint8_t i = 0; i < TRACE_NUM_PROBES; i++){
+		memset(&traceStats[i], 0, sizeof(traceStat));
+		traceStats[i].min = 0xFFFFFFFF;
+	}
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Adds a sample to a probe
+ * Safe to call from both task and ISR context
+ */
+void dwtTrace_record(traceProbe id, uint32_t cycles){
+	traceStat * stat = &traceStats[id];
+	uint8_t bucket = 32 - __CLZ(cycles);				// Number of significant bits
+	if(bucket >= TRACE_BUCKETS){
+		bucket = TRACE_BUCKETS - 1;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stat->count++;
+	stat->sum += cycles;
+	if(cycles < stat->min) stat->min = cycles;
+	if(cycles > stat->max) stat->max = cycles;
+	stat->hist[bucket]++;
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Stamps the start of a cross-context measurement
+ */
+void dwtTrace_mark(traceProbe id){
+	traceMarks[id] = DWT->CYCCNT;
+}
+
+/*
+ * Records the cycles elapsed since the last dwtTrace_mark() of the probe
+ * Nothing is recorded until the probe has been marked once
+ */
+void dwtTrace_since(traceProbe id){
+	if(traceMarks[id]){
+		dwtTrace_record(id, DWT->CYCCNT - traceMarks[id]);
+	}
+}
+
+/*
+ * Takes a consistent copy of a probe's statistics
+ */
+void dwtTrace_get(traceProbe id, traceStat * stat){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memcpy(stat, &traceStats[id], sizeof(traceStat));
+	__set_PRIMASK(primask);
+}
+
+// Appends the decimal representation of val to buf, returns the new end of buf
+static uint8_t * appendUint(uint8_t * buf, uint32_t val){
+	uint8_t digits[10];
+	uint8_t len = 0;
+	do{
+		digits[len++] = '0' + (val % 10);
+		val /= 10;
+	} while(val);
+	while(len){
+		*buf++ = digits[--len];
+	}
+	return buf;
+}
+
+// Appends a string to buf, returns the new end of buf
+static uint8_t * appendStr(uint8_t * buf, const char * str){
+	while(*str){
+		*buf++ = *str++;
+	}
+	return buf;
+}
+
+/*
+ * Writes one line per probe over Serial2:
+ * <name> n=<count> min=<cycles> max=<cycles> mean=<cycles>
+ * Blocks (osDelay) while the previous line is being sent
+ */
+void dwtTrace_dumpSerial(){
+	static uint8_t line[80];
+	traceStat stat;
+	uint8_t * end;
+
+	for(uint8_t i = 0; i < TRACE_NUM_PROBES; i++){
+		dwtTrace_get(i, &stat);
+
+		end = appendStr(line, traceNames[i]);
+		end = appendStr(end, " n=");
+		end = appendUint(end, stat.count);
+		end = appendStr(end, " min=");
+		end = appendUint(end, stat.count ? stat.min : 0);
+		end = appendStr(end, " max=");
+		end = appendUint(end, stat.max);
+		end = appendStr(end, " mean=");
+		end = appendUint(end, stat.count ? (uint32_t)(stat.sum / stat.count) : 0);
+		end = appendStr(end, "\r\n");
+
+		while(!Serial2_availableForWrite()){
+			osDelay(1);
+		}
+		Serial2_writeBytes(line, end - line);
+	}
+}
+
+/*
+ * Sends one CAN frame per probe on canId:
+ * Data[0]: probe id
+ * Data[1]: scale s, all values below are in units of 2^s cycles
+ * Data[2:3], Data[4:5], Data[6:7]: min, max, mean (big endian)
+ */
+void dwtTrace_dumpCan(uint32_t canId){
+	static Can_frame_t frame;
+	traceStat stat;
+	uint32_t mean;
+	uint8_t scale;
+
+	frame.id = canId;
+	frame.dlc = 8;
+	frame.isExt = 0;
+	frame.isRemote = 0;
+
+	for(uint8_t i = 0; i < TRACE_NUM_PROBES; i++){
+		dwtTrace_get(i, &stat);
+		if(stat.count == 0){
+			stat.min = 0;
+		}
+		mean = stat.count ? (uint32_t)(stat.sum / stat.count) : 0;
+
+		// Smallest scale that fits the longest sample in 16 bits
+		for(scale = 0; (stat.max >> scale) > 0xFFFF; scale++);
+
+		frame.Data[0] = i;
+		frame.Data[1] = scale;
+		frame.Data[2] = (stat.min >> scale) >> 8;
+		frame.Data[3] = (stat.min >> scale) & 0xFF;
+		frame.Data[4] = (stat.max >> scale) >> 8;
+		frame.Data[5] = (stat.max >> scale) & 0xFF;
+		frame.Data[6] = (mean >> scale) >> 8;
+		frame.Data[7] = (mean >> scale) & 0xFF;
+		bxCan_sendFrame(&frame);
+		osDelay(1);				// Leave room in the Tx queue for the other tasks
+	}
+}
@@ -52,6 +52,8 @@
 #include "nodeConf.h"
 #include "../../CAN_ID.h"
 #include "LTC6804_lib.h"
+#include "dwtTrace.h"
+#include "cellBalance.h"
 
 // RTOS Task functions + helpers
 #include "Can_Processor.h"
@@ -67,6 +69,8 @@ SPI_HandleTypeDef hspi1;
 DMA_HandleTypeDef hdma_spi1_tx;
 DMA_HandleTypeDef hdma_spi1_rx;
 
+TIM_HandleTypeDef htim7;
+
 UART_HandleTypeDef huart2;
 DMA_HandleTypeDef hdma_usart2_rx;
 DMA_HandleTypeDef hdma_usart2_tx;
@@ -75,16 +79,18 @@ WWDG_HandleTypeDef hwwdg;
 
 osThreadId ApplicationHandle;
 osThreadId Can_ProcessorHandle;
+osThreadId Bms_AcquireHandle;
 osMessageQId mainCanTxQHandle;
 osMessageQId mainCanRxQHandle;
 osTimerId WWDGTmrHandle;
 osTimerId HBTmrHandle;
 osMutexId swMtxHandle;
-osSemaphoreId bmsTRxCompleteHandle;
 
 /* USER CODE BEGIN PV */
 /* Private variables ---------------------------------------------------------*/
-ltc68041ChainHandle hbms1;
+LTC68041_CHAIN_STORAGE(hbms1, TOTAL_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TOTAL_IC);
+CELLBALANCE_STORAGE(bmsBalancer, TOTAL_IC);
 
 #ifdef FRANK
 const uint32_t firmwareString = 0x00000100;	// v00.00.01.0
@@ -119,8 +125,10 @@ static void MX_USART2_UART_Init(void);
 static void MX_WWDG_Init(void);
 static void MX_SPI1_Init(void);
 static void MX_CRC_Init(void);
+static void MX_TIM7_Init(void);
 void doApplication(void const * argument);
 void doProcessCan(void const * argument);
+void doBmsAcquire(void const * argument);
 void TmrKickDog(void const * argument);
 void TmrSendHB(void const * argument);
 
@@ -137,19 +145,20 @@ void can_rx_cb(){
 /* USER CODE BEGIN 0 */
 // SPI DMA read channels complete callback
 void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi){
-	// Check which SPI issued interrupt
-	if(hspi == (hbms1.hspi)){
-		HAL_GPIO_WritePin(BMS_CS_GPIO_Port,BMS_CS_Pin, GPIO_PIN_SET);
-		xSemaphoreGiveFromISR(bmsTRxCompleteHandle, NULL);
-	}
+	// Dispatched to the BMS chain on the interrupting SPI
+	LTC6804_SPI_TxRxCpltCallback(hspi);
 }
 
 // SPI DMA write reg complete callback
 void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi){
-	// Check which SPI issued interrupt
-	if(hspi == (hbms1.hspi)){
-		HAL_GPIO_WritePin(BMS_CS_GPIO_Port,BMS_CS_Pin, GPIO_PIN_SET);
-	}
+	// Dispatched to the BMS chain on the interrupting SPI
+	LTC6804_SPI_TxCpltCallback(hspi);
+}
+
+// SPI DMA error callback
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi){
+	// Dispatched to the BMS chain on the failing SPI
+	LTC6804_SPI_ErrorCallback(hspi);
 }
 /* USER CODE END 0 */
 
@@ -176,8 +185,12 @@ int main(void)
   MX_WWDG_Init();
   MX_SPI1_Init();
   MX_CRC_Init();
+  MX_TIM7_Init();
 
   /* USER CODE BEGIN 2 */
+#ifdef DWT_TRACE
+  dwtTrace_init();
+#endif
   Serial2_begin();
   static uint8_t hbmsg[] = "Booting... \n";
   Serial2_writeBuf(hbmsg);
@@ -192,9 +205,11 @@ int main(void)
   bxCan_setTxCallback(can_rx_cb);
 #endif
 
-  // Set up the global ADC configs for the LTC6804
-  ltc68041ChainInitStruct bmsInitParams[TOTAL_IC];
-  LTC68041_Initialize(&hbms1, bmsInitParams);
+  // Bind the BMS chain to its bus; the chain is initialized from doApplication
+  hbms1.hspi = &hspi1;
+  hbms1.htim = &htim7;
+  hbms1.csPort = BMS_CS_GPIO_Port;
+  hbms1.csPin = BMS_CS_Pin;
   /* USER CODE END 2 */
 
   /* Create the mutex(es) */
@@ -206,11 +221,6 @@ int main(void)
   /* add mutexes, ... */
   /* USER CODE END RTOS_MUTEX */
 
-  /* Create the semaphores(s) */
-  /* definition and creation of bmsTRxComplete */
-  osSemaphoreDef(bmsTRxComplete);
-  bmsTRxCompleteHandle = osSemaphoreCreate(osSemaphore(bmsTRxComplete), 1);
-
   /* USER CODE BEGIN RTOS_SEMAPHORES */
   /* add semaphores, ... */
   /* USER CODE END RTOS_SEMAPHORES */
@@ -239,6 +249,10 @@ int main(void)
   osThreadDef(Can_Processor, doProcessCan, osPriorityBelowNormal, 0, 512);
   Can_ProcessorHandle = osThreadCreate(osThread(Can_Processor), NULL);
 
+  /* definition and creation of Bms_Acquire */
+  osThreadDef(Bms_Acquire, doBmsAcquire, osPriorityAboveNormal, 0, 512);
+  Bms_AcquireHandle = osThreadCreate(osThread(Bms_Acquire), NULL);
+
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
   /* USER CODE END RTOS_THREADS */
@@ -372,9 +386,9 @@ static void MX_CRC_Init(void)
   hcrc.Instance = CRC;
   hcrc.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_DISABLE;
   hcrc.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_DISABLE;
-  hcrc.Init.GeneratingPolynomial = 50585;
+  hcrc.Init.GeneratingPolynomial = 20139;
   hcrc.Init.CRCLength = CRC_POLYLENGTH_16B;
-  hcrc.Init.InitValue = 16;
+  hcrc.Init.InitValue = 32;
   hcrc.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_NONE;
   hcrc.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_DISABLE;
   hcrc.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
@@ -410,6 +424,35 @@ static void MX_SPI1_Init(void)
 
 }
 
+/* TIM7 init function */
+static void MX_TIM7_Init(void)
+{
+
+  TIM_MasterConfigTypeDef sMasterConfig;
+
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = 79;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = 9;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  if (HAL_TIM_OnePulse_Init(&htim7, TIM_OPMODE_SINGLE) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim7, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+}
+
 /* USART2 init function */
 static void MX_USART2_UART_Init(void)
 {
@@ -529,6 +572,109 @@ void doProcessCan(void const * argument)
   /* USER CODE END doProcessCan */
 }
 
+/* doBmsAcquire function */
+void doBmsAcquire(void const * argument)
+{
+  /* USER CODE BEGIN doBmsAcquire */
+  // Set up the global ADC configs for the LTC6804
+  // Done here since the chain's transfers block on the RTOS
+  static ltc68041ChainInitStruct bmsInitParams[TOTAL_IC];
+  for(uint8_t ic = 0; ic < TOTAL_IC; ic++)
+  {
+    // Hardware OV/UV comparators, flagged in boardStat after every cell conversion
+    bmsInitParams[ic].vov = BMS_CELL_OV / 16;
+    bmsInitParams[ic].vuv = BMS_CELL_UV / 16 - 1;
+    // Reference kept up between conversions: no tREFUP wait at the start of every scan
+    bmsInitParams[ic].refon = 1;
+  }
+  // Bring-up; a chain still failing after the retries is scanned anyway, its errors show in health
+  for(uint8_t attempt = 0; attempt < BMS_INIT_Retries; attempt++)
+  {
+    if(LTC68041_Initialize(&hbms1, bmsInitParams) == 0)
+    {
+      break;
+    }
+    osDelay(BMS_INIT_Delay);
+  }
+
+  bmsBalancer.enabled = BMS_BAL_Enable;
+  bmsBalancer.maxPerIC = BMS_BAL_MaxPerIC;
+  bmsBalancer.startDelta = BMS_BAL_Start;
+  bmsBalancer.stopDelta = BMS_BAL_Stop;
+  bmsBalancer.minCell = BMS_BAL_MinCell;
+  bmsBalancer.maxAge = pdMS_TO_TICKS(3 * BMS_SCAN_Interval);	// Stop bleeding after a few failed scans
+
+  TickType_t scanWake = xTaskGetTickCount();
+  uint32_t scanStart;
+  uint32_t scanTime;
+  uint8_t auxCount = 0;
+  uint8_t statCount = 0;
+  uint8_t scrubCount = 0;
+  uint8_t scans;
+
+  /* Infinite loop */
+  for(;;)
+  {
+    // Fixed rate scan; the release jitter shows in the SCAN_PERIOD trace probe
+    TRACE_SINCE(TRACE_SCAN_PERIOD);
+    TRACE_MARK(TRACE_SCAN_PERIOD);
+
+    // Scan mix of this period
+    scans = LTC6804_SCAN_CELL;
+    if(BMS_AUX_Divider && (++auxCount >= BMS_AUX_Divider))
+    {
+      auxCount = 0;
+      scans |= LTC6804_SCAN_AUX;
+    }
+    if(BMS_STAT_Divider && (++statCount >= BMS_STAT_Divider))
+    {
+      statCount = 0;
+      scans |= LTC6804_SCAN_STAT;
+    }
+
+    scanStart = osKernelSysTick();
+    TRACE_BEGIN(TRACE_SCAN);
+    if(LTC6804_scan(&hbms1, scans) == 0)
+    {
+      LTC6804_snapshotPublish(&hbms1);		// Only PEC valid frames are published
+    }
+    TRACE_END(TRACE_SCAN);
+    scanTime = osKernelSysTick() - scanStart;
+
+    // Rewrite the configuration of chips that reset since the last check
+    if(BMS_CFG_Scrub && (++scrubCount >= BMS_CFG_Scrub))
+    {
+      scrubCount = 0;
+      LTC6804_cfgScrub(&hbms1);
+    }
+
+    // Discharge pattern from the latest frame; WRCFG only when it changes
+    cellBalance_update(&bmsBalancer, &hbms1);
+
+    // One slice of the self-test rotation in the rest of the period
+    LTC6804_diagRun(&hbms1, BMS_DIAG_Budget);
+
+    // Slower SPI clock while the scans see PEC errors, back to the Cube rate once clean
+    LTC6804_linkAdapt(&hbms1);
+
+    // Pack health accounting
+    hbms1.health.periods++;
+    if(scanTime > hbms1.health.worstScan)
+    {
+      hbms1.health.worstScan = scanTime;
+    }
+    if((xTaskGetTickCount() - scanWake) >= pdMS_TO_TICKS(BMS_SCAN_Interval))
+    {
+      // Deadline missed: restart the period from now instead of releasing back to back to catch up
+      hbms1.health.overruns++;
+      scanWake = xTaskGetTickCount();
+    }
+
+    vTaskDelayUntil(&scanWake, pdMS_TO_TICKS(BMS_SCAN_Interval));
+  }
+  /* USER CODE END doBmsAcquire */
+}
+
 /* TmrKickDog function */
 void TmrKickDog(void const * argument)
 {
@@ -591,6 +737,8 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
     HAL_IncTick();
   }
 /* USER CODE BEGIN Callback 1 */
+  // isoSPI wake pulse timer, dispatched to the BMS chain using it
+  LTC6804_TIM_PeriodElapsedCallback(htim);
 
 /* USER CODE END Callback 1 */
 }
@@ -6,6 +6,7 @@
  */
 
 #include "serial.h"
+#include "dwtTrace.h"
 
 extern UART_HandleTypeDef huart2;
 
@@ -169,6 +170,7 @@ static void Serial2_dequeue_tx(int length){
 
 static void doTx(uint8_t fromISR){
 	static int txavail;
+	TRACE_BEGIN(TRACE_SERIAL_TX);
 	txavail = Serial2_available_tx();
 	if(txavail){
 		if(Serial2_tail_tx + txavail > Serial2_max_tx){
@@ -180,6 +182,7 @@ static void doTx(uint8_t fromISR){
 		Serial2_dequeue_tx(currentWrite);
 		txWillTrigger = 0;
 	}
+	TRACE_END(TRACE_SERIAL_TX);
 }
 
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart){
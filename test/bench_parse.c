@@ -0,0 +1,141 @@
+/*
+ * bench_parse.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host cycles of the RDCVA-RDCVD parse of a full 32 IC chain: the separate
+ *  unpack and pec15_calc() loops the library had before LTC6804_parseGroup()
+ *  (kept below as the baseline) against the fused pass. The library source is
+ *  included to reach the static kernel, so the Makefile does not link it again.
+ *  Both must give the same codes and PEC error mask on the same Rx buffer.
+ */
+
+#include "../Src/LTC6804_lib.c"
+#include "harness.h"
+
+#define TEST_IC		32
+#define CALLS		2000
+#define RUNS		15
+
+static uint8_t rxBuf[NUM_CV_REG * LTC6804_XFER_LEN(TEST_IC)] __attribute__((aligned(4)));
+static uint16_t cellsBase[TEST_IC][12];
+static uint16_t cellsFused[TEST_IC][12];
+
+// rdcv_pipeCplt()'s parse loop before the fused kernel, errors per IC added for the comparison
+static uint32_t parseBaseline(const uint8_t * buf, uint8_t numIC, uint16_t (*cellVolts)[12])
+{
+	uint32_t pec_errors = 0;
+	uint16_t parsed_cell;
+	uint16_t received_pec;
+	uint16_t data_pec;
+	uint16_t data_counter = 0;
+
+	for(uint8_t cell_reg = 1; cell_reg < 5; cell_reg++)
+	{
+		data_counter = (cell_reg - 1) * LTC6804_XFER_LEN(numIC);
+
+		for(uint8_t current_ic = 0; current_ic < numIC; current_ic++)
+		{
+			for(uint8_t current_cell = 0; current_cell < CELL_IN_REG; current_cell++)
+			{
+				parsed_cell = buf[data_counter + CMD_LEN] + (buf[data_counter + CMD_LEN + 1] << 8);
+				cellVolts[current_ic][current_cell + ((cell_reg - 1) * CELL_IN_REG)] = parsed_cell;
+				data_counter += 2;
+			}
+			received_pec = (buf[data_counter + CMD_LEN] << 8) + buf[data_counter + CMD_LEN + 1];
+			data_pec = pec15_calc(REG_BYTES, (uint8_t *)&buf[data_counter + CMD_LEN - REG_BYTES]);
+			if(received_pec != data_pec)
+			{
+				pec_errors |= (1UL << current_ic);
+			}
+			data_counter += 2;
+		}
+	}
+	return pec_errors;
+}
+
+static uint32_t parseFused(const uint8_t * buf, uint8_t numIC, uint16_t (*cellVolts)[12])
+{
+	uint32_t pec_errors = 0;
+
+	for(uint8_t cell_reg = 0; cell_reg < NUM_CV_REG; cell_reg++)
+	{
+		pec_errors |= LTC6804_parseGroup(&buf[cell_reg * LTC6804_XFER_LEN(numIC) + CMD_LEN],
+				numIC, &cellVolts[0][cell_reg * CELL_IN_REG], 12);
+	}
+	return pec_errors;
+}
+
+static uint64_t run(uint32_t (*parse)(const uint8_t *, uint8_t, uint16_t (*)[12]), uint16_t (*cells)[12], uint32_t * errors)
+{
+	uint64_t best = ~0ULL;
+
+	for(uint8_t run = 0; run < RUNS; run++)
+	{
+		uint64_t start = harness_cycles();
+
+		for(uint32_t call = 0; call < CALLS; call++)
+		{
+			*errors = parse(rxBuf, TEST_IC, cells);
+			__asm__ volatile("" ::: "memory");
+		}
+		start = harness_cycles() - start;
+		best = (start < best) ? start : best;
+	}
+	return best;
+}
+
+int main(void)
+{
+	uint32_t errBase;
+	uint32_t errFused;
+	uint64_t base;
+	uint64_t fused;
+
+	harness_init();
+
+	// Random codes with valid PECs, a few ICs corrupted so both paths flag the same ones
+	sim_seed(10);
+	for(uint8_t reg = 0; reg < NUM_CV_REG; reg++)
+	{
+		uint8_t * frame = &rxBuf[reg * LTC6804_XFER_LEN(TEST_IC) + CMD_LEN];
+
+		for(uint8_t ic = 0; ic < TEST_IC; ic++, frame += BYTES_IN_REG)
+		{
+			uint16_t pec;
+
+			for(uint8_t i = 0; i < REG_BYTES; i++)
+			{
+				frame[i] = (uint8_t)sim_random();
+			}
+			pec = sim_pec15(frame, REG_BYTES);
+			frame[6] = (uint8_t)(pec >> 8);
+			frame[7] = (uint8_t)pec;
+			if((ic % 11) == reg)
+			{
+				frame[sim_random() % 8] ^= 0x10;
+			}
+		}
+	}
+
+	base = run(parseBaseline, cellsBase, &errBase);
+	fused = run(parseFused, cellsFused, &errFused);
+	CHECK(errBase != 0);
+	CHECK(errFused == errBase);
+	CHECK(memcmp(cellsFused, cellsBase, sizeof(cellsBase)) == 0);
+
+#if (LTC6804_PEC_BACKEND == PEC_BACKEND_HW)
+	(void)base;
+	(void)fused;
+	printf("  PEC_BACKEND_HW runs on the shim's software CRC model, not measured\n");
+#else
+	double groups = (double)CALLS * NUM_CV_REG * TEST_IC;
+
+	printf("  RDCVA-RDCVD of %u ICs: separate loops %.1f, fused %.1f cycles per IC group (%.1fx), %.0f vs %.0f per parse\n",
+			TEST_IC, (double)base / groups, (double)fused / groups, (double)base / (double)fused,
+			(double)base / CALLS, (double)fused / CALLS);
+	CHECK(fused < base);
+#endif
+
+	return harness_report("bench_parse");
+}
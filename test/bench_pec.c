@@ -0,0 +1,89 @@
+/*
+ * bench_pec.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Cycles per byte of pec15_calc() against the bitwise datasheet algorithm
+ *  (sim_pec15()), for a command (2 bytes), a register group (6 bytes) and a
+ *  longer buffer. Each figure is the best of several runs.
+ *
+ *  Only the table backend is measured here: built with PEC_BACKEND_HW the shim
+ *  computes HAL_CRC_Calculate() bit by bit in software, which says nothing
+ *  about the CRC unit. On the target, enable DWT_TRACE and read TRACE_PEC15
+ *  (dwtTrace_get()) over a few scans with each backend.
+ */
+
+#include "harness.h"
+
+#define CALLS		20000
+#define RUNS		15
+
+static uint8_t data[64];
+static volatile uint16_t sink;
+
+static uint64_t runTable(uint8_t len)
+{
+	uint64_t best = ~0ULL;
+
+	for(uint8_t run = 0; run < RUNS; run++)
+	{
+		uint64_t start = harness_cycles();
+
+		for(uint32_t call = 0; call < CALLS; call++)
+		{
+			data[0] = (uint8_t)call;
+			sink = pec15_calc(len, data);
+		}
+		start = harness_cycles() - start;
+		best = (start < best) ? start : best;
+	}
+	return best;
+}
+
+static uint64_t runBitwise(uint8_t len)
+{
+	uint64_t best = ~0ULL;
+
+	for(uint8_t run = 0; run < RUNS; run++)
+	{
+		uint64_t start = harness_cycles();
+
+		for(uint32_t call = 0; call < CALLS; call++)
+		{
+			data[0] = (uint8_t)call;
+			sink = sim_pec15(data, len);
+		}
+		start = harness_cycles() - start;
+		best = (start < best) ? start : best;
+	}
+	return best;
+}
+
+int main(void)
+{
+	harness_init();
+	sim_seed(2);
+	for(uint8_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)sim_random();
+	}
+
+#if (LTC6804_PEC_BACKEND == PEC_BACKEND_HW)
+	printf("  PEC_BACKEND_HW runs on the shim's software CRC model, not measured\n");
+#else
+	static const uint8_t lens[] = {CMD_LEN / 2, REG_BYTES, sizeof(data)};
+
+	for(uint8_t i = 0; i < sizeof(lens); i++)
+	{
+		uint64_t bitwise = runBitwise(lens[i]);
+		uint64_t table = runTable(lens[i]);
+		double bytes = (double)CALLS * lens[i];
+
+		printf("  %2u bytes: bitwise %5.1f, table %5.1f cycles/byte (%.1fx)\n", lens[i],
+				(double)bitwise / bytes, (double)table / bytes, (double)bitwise / (double)table);
+		CHECK(table * 2 < bitwise);
+	}
+#endif
+
+	return harness_report("bench_pec");
+}
@@ -0,0 +1,111 @@
+/*
+ * harness.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Peripherals and HAL callbacks of the host tests, wired like main.c.
+ */
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "harness.h"
+#include "nodeConf.h"
+
+SPI_HandleTypeDef hspi1;
+SPI_HandleTypeDef hspi2;
+TIM_HandleTypeDef htim7;
+CRC_HandleTypeDef hcrc;
+uint32_t harnessChecks;
+uint32_t harnessFails;
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef * hspi)
+{
+	LTC6804_SPI_TxRxCpltCallback(hspi);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef * hspi)
+{
+	LTC6804_SPI_TxCpltCallback(hspi);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef * hspi)
+{
+	LTC6804_SPI_ErrorCallback(hspi);
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef * htim)
+{
+	LTC6804_TIM_PeriodElapsedCallback(htim);
+}
+
+void harness_check(int ok, const char * what, const char * file, int line)
+{
+	harnessChecks++;
+	if(!ok)
+	{
+		harnessFails++;
+		printf("%s:%d: check failed: %s\n", file, line, what);
+	}
+}
+
+// The peripherals of MX_SPI1_Init(), MX_TIM7_Init() and MX_CRC_Init()
+void harness_init(void)
+{
+	shim_spiInit(&hspi1, SPI1, SPI_BAUDRATEPRESCALER_128);
+	shim_spiInit(&hspi2, SPI2, SPI_BAUDRATEPRESCALER_128);
+	shim_timInit(&htim7, TIM7, 79, 9);
+
+	memset(&hcrc, 0, sizeof(hcrc));
+	hcrc.Instance = CRC;
+	hcrc.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_DISABLE;
+	hcrc.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_DISABLE;
+	hcrc.Init.GeneratingPolynomial = 20139;
+	hcrc.Init.CRCLength = CRC_POLYLENGTH_16B;
+	hcrc.Init.InitValue = 32;
+	hcrc.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_NONE;
+	hcrc.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_DISABLE;
+	hcrc.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
+	HAL_CRC_Init(&hcrc);
+}
+
+// Binds a handle and a chain model to an SPI, an optional wake timer and a CS pin of GPIOB
+void harness_chain(ltc68041ChainHandle * hbms, simChain * chain, SPI_HandleTypeDef * hspi, TIM_HandleTypeDef * htim, uint16_t csPin)
+{
+	hbms->hspi = hspi;
+	hbms->htim = htim;
+	hbms->csPort = GPIOB;
+	hbms->csPin = csPin;
+	sim_init(chain, hspi, GPIOB, csPin, hbms->numIC);
+}
+
+// Comparator thresholds of bmsInitParams in main.c, everything else off
+void harness_params(ltc68041ChainInitStruct * hinit, uint8_t numIC)
+{
+	memset(hinit, 0, sizeof(*hinit) * numIC);
+	for(uint8_t ic = 0; ic < numIC; ic++)
+	{
+		hinit[ic].vov = BMS_CELL_OV / 16;
+		hinit[ic].vuv = BMS_CELL_UV / 16 - 1;
+	}
+}
+
+// Cycle counter of the benchmarks: the TSC on x86, nanoseconds elsewhere
+uint64_t harness_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+int harness_report(const char * name)
+{
+	printf("%s: %lu checks, %lu failed\n", name, (unsigned long)harnessChecks, (unsigned long)harnessFails);
+	return (harnessFails != 0);
+}
@@ -0,0 +1,35 @@
+/*
+ * harness.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Common setup of the host tests: the peripherals main.c would own, bound to
+ *  the shim and the chain model, and a minimal check/report.
+ */
+
+#ifndef HARNESS_H_
+#define HARNESS_H_
+
+#include <stdio.h>
+#include "LTC6804_lib.h"
+#include "shim.h"
+#include "ltc6804_sim.h"
+
+extern SPI_HandleTypeDef hspi1;
+extern SPI_HandleTypeDef hspi2;
+extern TIM_HandleTypeDef htim7;
+extern CRC_HandleTypeDef hcrc;
+extern uint32_t harnessChecks;
+extern uint32_t harnessFails;
+
+// Records a failed check with its location, carries on
+#define CHECK(cond)	harness_check((cond), #cond, __FILE__, __LINE__)
+
+void harness_check(int ok, const char * what, const char * file, int line);
+void harness_init(void);
+void harness_chain(ltc68041ChainHandle * hbms, simChain * chain, SPI_HandleTypeDef * hspi, TIM_HandleTypeDef * htim, uint16_t csPin);
+void harness_params(ltc68041ChainInitStruct * hinit, uint8_t numIC);
+int harness_report(const char * name);
+uint64_t harness_cycles(void);
+
+#endif /* HARNESS_H_ */
@@ -0,0 +1,25 @@
+@ packStats_scalar.s
+@
+@  Inner loop of the scalar packStats_compute() (PACKSTATS_BACKEND_SCALAR) in
+@  Thumb-2, one iteration per cell, for `make mca` (llvm-mca on the Cortex-M4
+@  pipeline model). Written from the C loop, with the compares if-converted
+@  (IT blocks) as the compiler does for short conditional moves.
+@
+@  r0 src, r1 maxv, r2 maxIdx, r3 minv, r4 minIdx, r5 flat index, r6 icSum,
+@  r7:r8 sq, r11 count
+
+loop:
+	ldrh	r12, [r0], #2			@ code = cellVolts[ic][cell]
+	cmp	r12, r1				@ if(code > maxv)
+	itt	hi
+	movhi	r1, r12				@ maxv = code
+	movhi	r2, r5				@ maxIdx = ic * 12 + cell
+	cmp	r12, r3				@ if(code < minv)
+	itt	lo
+	movlo	r3, r12				@ minv = code
+	movlo	r4, r5				@ minIdx = ic * 12 + cell
+	add	r6, r6, r12			@ icSum += code
+	umlal	r7, r8, r12, r12		@ sq += code * code
+	adds	r5, r5, #1
+	subs	r11, r11, #1
+	bne	loop
@@ -0,0 +1,25 @@
+@ packStats_simd.s
+@
+@  Inner loop of the SIMD packStats_compute() (PACKSTATS_BACKEND_SIMD) in
+@  Thumb-2, one iteration per word = 2 cells, for `make mca` (llvm-mca on the
+@  Cortex-M4 pipeline model). Written from the C loop: one instruction per
+@  intrinsic and C operation, registers held across iterations.
+@
+@  r0 src, r1 maxv, r2 maxi, r3 minv, r4 mini, r5 idx, r6 icSum,
+@  r7:r8 sq, r9 0x80008000, r10 0x00020002, r11 count
+
+loop:
+	ldr	r12, [r0], #4			@ memcpy(&word, src, 4), unaligned LDR is fine on the M4
+	usub16	lr, r1, r12			@ __USUB16(maxv, word)
+	sel	r1, r1, r12			@ maxv = __SEL(maxv, word)
+	sel	r2, r2, r5			@ maxi = __SEL(maxi, idx)
+	usub16	lr, r12, r3			@ __USUB16(word, minv)
+	sel	r3, r3, r12			@ minv = __SEL(minv, word)
+	sel	r4, r4, r5			@ mini = __SEL(mini, idx)
+	uxtah	r6, r6, r12			@ icSum += word & 0xFFFF
+	add	r6, r6, r12, lsr #16		@ icSum += word >> 16
+	eor	lr, r12, r9			@ word ^ 0x80008000
+	smlald	r7, r8, lr, lr			@ sq = __SMLALD(..., sq)
+	add	r5, r5, r10			@ idx += 0x00020002
+	subs	r11, r11, #1
+	bne	loop
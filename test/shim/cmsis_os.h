@@ -0,0 +1,65 @@
+/*
+ * cmsis_os.h (host shim)
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  The FreeRTOS / CMSIS-RTOS v1 calls used by the LTC6804 library, on the
+ *  simulated clock of shim.c (1kHz tick like FreeRTOSConfig.h). There is no
+ *  scheduler: a blocking call runs the simulated interrupts until it would
+ *  return. Each shimTask holds its own notification, so a test can stand in
+ *  for several tasks by switching shim_setTask().
+ */
+
+#ifndef CMSIS_OS_H_SHIM
+#define CMSIS_OS_H_SHIM
+
+#include <stdint.h>
+
+typedef long			BaseType_t;
+typedef unsigned long	UBaseType_t;
+typedef uint32_t		TickType_t;
+typedef void *			TaskHandle_t;
+
+typedef enum {
+	eNoAction = 0,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite
+} eNotifyAction;
+
+#define pdFALSE		((BaseType_t)0)
+#define pdTRUE		((BaseType_t)1)
+#define pdPASS		pdTRUE
+
+#define configTICK_RATE_HZ				((TickType_t)1000)
+#define pdMS_TO_TICKS(xTimeInMs)		((TickType_t)(((TickType_t)(xTimeInMs) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000))
+#define osKernelSysTickFrequency		(configTICK_RATE_HZ)
+#define osKernelSysTickMicroSec(microsec)	(((uint64_t)microsec * (osKernelSysTickFrequency)) / 1000000)
+
+// Single core, no preemption: the simulated interrupts only run inside blocking calls
+#define taskENTER_CRITICAL()				((void)0)
+#define taskEXIT_CRITICAL()					((void)0)
+#define taskENTER_CRITICAL_FROM_ISR()		((UBaseType_t)0)
+#define taskEXIT_CRITICAL_FROM_ISR(x)		((void)(x))
+#define portYIELD_FROM_ISR(x)				((void)(x))
+
+typedef enum {
+	osOK = 0
+} osStatus;
+
+typedef struct {
+	uint8_t		pending;
+	uint32_t	value;
+} shimTask;
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t * pulNotificationValue, TickType_t xTicksToWait);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t * pxHigherPriorityTaskWoken);
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction);
+BaseType_t xTaskNotifyStateClear(TaskHandle_t xTask);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+uint32_t osKernelSysTick(void);
+osStatus osDelay(uint32_t millisec);
+
+#endif /* CMSIS_OS_H_SHIM */
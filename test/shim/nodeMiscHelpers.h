@@ -0,0 +1,19 @@
+/*
+ * nodeMiscHelpers.h (host shim)
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Stands in for Inc/nodeMiscHelpers.h, whose busy wait is ARM assembly and
+ *  which pulls in the CAN and serial drivers.
+ */
+
+#ifndef NODEMISCHELPERS_H_SHIM
+#define NODEMISCHELPERS_H_SHIM
+
+#include "stm32l4xx_hal.h"
+#include "cmsis_os.h"
+
+void shim_delayUs(uint32_t us);
+#define delayUs(US)		shim_delayUs(US)
+
+#endif /* NODEMISCHELPERS_H_SHIM */
@@ -0,0 +1,477 @@
+/*
+ * shim.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  HAL and RTOS shim on a simulated microsecond clock (see shim.h).
+ */
+
+#include "shim.h"
+
+#define SHIM_EVENTS		8
+
+#define EV_NONE			0
+#define EV_SPI_DONE		1
+#define EV_SPI_ERROR	2
+#define EV_TIM			3
+
+typedef struct {
+	uint64_t	at;
+	uint8_t		type;
+	void *		obj;
+} shimEvent;
+
+typedef struct {
+	SPI_HandleTypeDef *	hspi;
+	uint8_t *	tx;
+	uint8_t *	rx;
+	uint16_t	len;
+	uint64_t	start;
+	shimEvent *	ev;
+} shimXfer;
+
+uint64_t shimNow = 0;
+shimStats shimStat;
+uint32_t shimPreemptUs;
+uint32_t shimGE;
+uint32_t shimCRC;
+
+GPIO_TypeDef shimGPIOA, shimGPIOB, shimGPIOC;
+SPI_TypeDef shimSPI1, shimSPI2;
+TIM_TypeDef shimTIM6, shimTIM7;
+
+static shimEvent events[SHIM_EVENTS];
+static shimXfer xfers[2];
+static const shimDevice * device;
+static shimTask mainTask;
+static shimTask * current = &mainTask;
+
+/* ---------------- Event loop ---------------- */
+
+static shimEvent * shim_post(uint64_t at, uint8_t type, void * obj)
+{
+	for(uint8_t i = 0; i < SHIM_EVENTS; i++)
+	{
+		if(events[i].type == EV_NONE)
+		{
+			events[i].at = at;
+			events[i].type = type;
+			events[i].obj = obj;
+			return &events[i];
+		}
+	}
+	return NULL;
+}
+
+static shimXfer * shim_xfer(SPI_HandleTypeDef * hspi)
+{
+	return &xfers[(hspi->Instance == SPI1) ? 0 : 1];
+}
+
+/*
+ * Delivers the earliest interrupt due at or before until, moving the clock to it.
+ * Returns 0 (clock moved to until) if there is none.
+ */
+static uint8_t shim_step(uint64_t until)
+{
+	shimEvent * next = NULL;
+	shimEvent ev;
+	shimXfer * xfer;
+	TIM_HandleTypeDef * htim;
+
+	for(uint8_t i = 0; i < SHIM_EVENTS; i++)
+	{
+		if((events[i].type != EV_NONE) && (events[i].at <= until) && ((next == NULL) || (events[i].at < next->at)))
+		{
+			next = &events[i];
+		}
+	}
+	if(next == NULL)
+	{
+		if(until > shimNow)
+		{
+			shimNow = until;
+		}
+		return 0;
+	}
+
+	ev = *next;
+	next->type = EV_NONE;
+	if(ev.at > shimNow)
+	{
+		shimNow = ev.at;
+	}
+
+	switch(ev.type)
+	{
+	case EV_SPI_DONE:
+	case EV_SPI_ERROR:
+		xfer = (shimXfer *)ev.obj;
+		xfer->ev = NULL;
+		shimStat.busyUs[xfer - xfers] += shimNow - xfer->start;
+		if((ev.type == EV_SPI_DONE) && (device != NULL))
+		{
+			device->xferEnd(xfer->hspi, xfer->tx, xfer->rx, xfer->len);
+		}
+		else if(device != NULL)
+		{
+			device->xferAbort(xfer->hspi);								// Ended by the error, nothing delivered
+		}
+		xfer->hspi->State = HAL_SPI_STATE_READY;						// The HAL is ready again before it calls back
+		if(ev.type == EV_SPI_ERROR)
+		{
+			xfer->hspi->ErrorCode = 1;
+			HAL_SPI_ErrorCallback(xfer->hspi);
+		}
+		else if(xfer->rx != NULL)
+		{
+			HAL_SPI_TxRxCpltCallback(xfer->hspi);
+		}
+		else
+		{
+			HAL_SPI_TxCpltCallback(xfer->hspi);
+		}
+		break;
+
+	case EV_TIM:
+		htim = (TIM_HandleTypeDef *)ev.obj;
+		htim->Instance->CR1 &= ~TIM_CR1_CEN;							// One pulse mode
+		htim->Instance->SR |= TIM_FLAG_UPDATE;
+		if(htim->Instance->DIER & TIM_IT_UPDATE)
+		{
+			HAL_TIM_PeriodElapsedCallback(htim);
+		}
+		break;
+	}
+	return 1;
+}
+
+void shim_run(uint64_t us)
+{
+	uint64_t until = shimNow + us;
+
+	while(shim_step(until));
+}
+
+// 1 when no transfer or timer interrupt is outstanding
+uint8_t shim_idle(void)
+{
+	for(uint8_t i = 0; i < SHIM_EVENTS; i++)
+	{
+		if(events[i].type != EV_NONE)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void shim_device(const shimDevice * dev)
+{
+	device = dev;
+}
+
+void shim_setTask(shimTask * task)
+{
+	current = (task != NULL) ? task : &mainTask;
+}
+
+/* ---------------- RTOS ---------------- */
+
+static shimTask * shim_task(TaskHandle_t task)
+{
+	return (task != NULL) ? (shimTask *)task : current;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t * pulNotificationValue, TickType_t xTicksToWait)
+{
+	uint64_t deadline = ((shimNow / 1000) + xTicksToWait) * 1000;	// Woken by the xTicksToWait-th tick from now
+
+	if(!current->pending)
+	{
+		current->value &= ~ulBitsToClearOnEntry;
+	}
+	while(!current->pending && shim_step(deadline));
+	if(!current->pending)
+	{
+		shimStat.timeouts++;
+		return pdFALSE;
+	}
+
+	if(pulNotificationValue != NULL)
+	{
+		*pulNotificationValue = current->value;
+	}
+	current->value &= ~ulBitsToClearOnExit;
+	current->pending = 0;
+	return pdTRUE;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction)
+{
+	shimTask * task = shim_task(xTaskToNotify);
+
+	switch(eAction)
+	{
+	case eSetBits:
+		task->value |= ulValue;
+		break;
+	case eIncrement:
+		task->value++;
+		break;
+	case eSetValueWithoutOverwrite:
+		if(task->pending)
+		{
+			return pdFALSE;
+		}
+		task->value = ulValue;
+		break;
+	case eSetValueWithOverwrite:
+		task->value = ulValue;
+		break;
+	default:
+		break;
+	}
+	task->pending = 1;
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t * pxHigherPriorityTaskWoken)
+{
+	shimStat.notifies++;
+	if(pxHigherPriorityTaskWoken != NULL)
+	{
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	}
+	return xTaskNotify(xTaskToNotify, ulValue, eAction);
+}
+
+BaseType_t xTaskNotifyStateClear(TaskHandle_t xTask)
+{
+	shimTask * task = shim_task(xTask);
+	BaseType_t was = task->pending ? pdTRUE : pdFALSE;
+
+	task->pending = 0;
+	return was;
+}
+
+// The library calls it last when arming a transfer: a preemption set up by the test happens there
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	uint32_t us = shimPreemptUs;
+
+	if(us)
+	{
+		shimPreemptUs = 0;
+		shim_run(us);
+	}
+	return (TaskHandle_t)current;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(shimNow / 1000);
+}
+
+uint32_t osKernelSysTick(void)
+{
+	return (uint32_t)(shimNow / 1000);
+}
+
+osStatus osDelay(uint32_t millisec)
+{
+	uint64_t deadline = ((shimNow / 1000) + millisec) * 1000;
+
+	while(shim_step(deadline));
+	return osOK;
+}
+
+void shim_delayUs(uint32_t us)
+{
+	shim_run(us);
+}
+
+/* ---------------- RCC / GPIO ---------------- */
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+	return SHIM_PCLK_HZ;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+	return SHIM_PCLK_HZ;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	uint32_t was = GPIOx->ODR & GPIO_Pin;
+
+	if(PinState == GPIO_PIN_SET)
+	{
+		GPIOx->ODR |= GPIO_Pin;
+	}
+	else
+	{
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+	if(((GPIOx->ODR & GPIO_Pin) != was) && (device != NULL))
+	{
+		device->cs(GPIOx, GPIO_Pin, (PinState == GPIO_PIN_SET));
+	}
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin)
+{
+	return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+/* ---------------- SPI ---------------- */
+
+void shim_spiInit(SPI_HandleTypeDef * hspi, SPI_TypeDef * instance, uint32_t prescaler)
+{
+	memset(hspi, 0, sizeof(*hspi));
+	hspi->Instance = instance;
+	hspi->Init.BaudRatePrescaler = prescaler;
+	hspi->State = HAL_SPI_STATE_READY;
+	instance->CR1 = prescaler;											// Like HAL_SPI_Init()
+}
+
+// SCK from the prescaler in CR1 (the register the transfer actually runs at)
+uint32_t shim_sck(SPI_HandleTypeDef * hspi)
+{
+	return (SHIM_PCLK_HZ >> (((hspi->Instance->CR1 & SPI_CR1_BR_Msk) >> SPI_CR1_BR_Pos) + 1));
+}
+
+static HAL_StatusTypeDef shim_spiStart(SPI_HandleTypeDef * hspi, uint8_t * tx, uint8_t * rx, uint16_t len)
+{
+	shimXfer * xfer = shim_xfer(hspi);
+	uint32_t sck = shim_sck(hspi);
+	uint8_t end;
+
+	if(hspi->State != HAL_SPI_STATE_READY)
+	{
+		shimStat.busyStarts++;
+		return HAL_BUSY;
+	}
+	hspi->State = (rx != NULL) ? HAL_SPI_STATE_BUSY_TX_RX : HAL_SPI_STATE_BUSY_TX;
+	hspi->Instance->CR1 |= SPI_CR1_SPE;
+	hspi->ErrorCode = 0;
+	shimStat.xfers++;
+
+	xfer->hspi = hspi;
+	xfer->tx = tx;
+	xfer->rx = rx;
+	xfer->len = len;
+	xfer->start = shimNow;
+	xfer->ev = NULL;
+	end = (device != NULL) ? device->xferBegin(hspi, len) : SHIM_XFER_OK;
+	if(end != SHIM_XFER_HANG)
+	{
+		xfer->ev = shim_post(shimNow + (((uint64_t)len * 8 * 1000000) + sck - 1) / sck,
+				(end == SHIM_XFER_ERROR) ? EV_SPI_ERROR : EV_SPI_DONE, xfer);
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef * hspi, uint8_t * pTxData, uint8_t * pRxData, uint16_t Size)
+{
+	return shim_spiStart(hspi, pTxData, pRxData, Size);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef * hspi, uint8_t * pData, uint16_t Size)
+{
+	return shim_spiStart(hspi, pData, NULL, Size);
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef * hspi)
+{
+	shimXfer * xfer = shim_xfer(hspi);
+
+	if(hspi->State != HAL_SPI_STATE_READY)
+	{
+		shimStat.aborts++;
+		if(xfer->ev != NULL)
+		{
+			xfer->ev->type = EV_NONE;
+			xfer->ev = NULL;
+		}
+		shimStat.busyUs[xfer - xfers] += shimNow - xfer->start;
+		if(device != NULL)
+		{
+			device->xferAbort(hspi);
+		}
+	}
+	hspi->State = HAL_SPI_STATE_READY;
+	return HAL_OK;
+}
+
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef * hspi)
+{
+	return hspi->State;
+}
+
+/* ---------------- CRC ---------------- */
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef * hcrc)
+{
+	return (hcrc->Instance == CRC) ? HAL_OK : HAL_ERROR;
+}
+
+/*
+ * Generic model of the STM32 CRC unit: MSB first, no input or output
+ * inversion, programmable polynomial size, byte input
+ */
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef * hcrc, uint32_t pBuffer[], uint32_t BufferLength)
+{
+	const uint8_t * data = (const uint8_t *)pBuffer;
+	uint8_t width;
+	uint32_t poly, mask, crc;
+
+	switch(hcrc->Init.CRCLength)
+	{
+	case CRC_POLYLENGTH_7B:		width = 7;	break;
+	case CRC_POLYLENGTH_8B:		width = 8;	break;
+	case CRC_POLYLENGTH_16B:	width = 16;	break;
+	default:					width = 32;	break;
+	}
+	mask = (width == 32) ? 0xFFFFFFFF : ((1UL << width) - 1);
+	poly = ((hcrc->Init.DefaultPolynomialUse == DEFAULT_POLYNOMIAL_ENABLE) ? 0x04C11DB7 : hcrc->Init.GeneratingPolynomial) & mask;
+	crc = ((hcrc->Init.DefaultInitValueUse == DEFAULT_INIT_VALUE_ENABLE) ? 0xFFFFFFFF : hcrc->Init.InitValue) & mask;
+
+	for(uint32_t i = 0; i < BufferLength; i++)
+	{
+		for(int8_t bit = 7; bit >= 0; bit--)
+		{
+			uint32_t in = ((crc >> (width - 1)) ^ (data[i] >> bit)) & 0x01;
+
+			crc = (crc << 1) & mask;
+			if(in)
+			{
+				crc ^= poly;
+			}
+		}
+	}
+	return crc;
+}
+
+/* ---------------- TIM ---------------- */
+
+void shim_timInit(TIM_HandleTypeDef * htim, TIM_TypeDef * instance, uint32_t prescaler, uint32_t period)
+{
+	memset(htim, 0, sizeof(*htim));
+	memset(instance, 0, sizeof(*instance));
+	htim->Instance = instance;
+	htim->Init.Prescaler = prescaler;
+	htim->Init.Period = period;
+	instance->PSC = prescaler;
+	instance->ARR = period;
+}
+
+void shim_timEnable(TIM_HandleTypeDef * htim)
+{
+	uint64_t us = ((uint64_t)(htim->Instance->PSC + 1) * (htim->Instance->ARR + 1) * 1000000) / SHIM_PCLK_HZ;
+
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+	shim_post(shimNow + us, EV_TIM, htim);
+}
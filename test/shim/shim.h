@@ -0,0 +1,53 @@
+/*
+ * shim.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Host side controls of the HAL / RTOS shim: the simulated clock, the task
+ *  the library runs as, and the hooks a simulated SPI device plugs into.
+ *
+ *  Time only moves inside the blocking calls (xTaskNotifyWait(), osDelay(),
+ *  delayUs()) and shim_run(); they deliver the DMA and timer interrupts due
+ *  meanwhile in time order, each on its own callback like the NVIC would.
+ */
+
+#ifndef SHIM_H_
+#define SHIM_H_
+
+#include "stm32l4xx_hal.h"
+#include "cmsis_os.h"
+
+// How a simulated device ends a DMA transfer (see shimDevice.xferBegin)
+#define SHIM_XFER_OK		0	// Completes after the bytes are clocked out
+#define SHIM_XFER_ERROR		1	// Ends with HAL_SPI_ErrorCallback()
+#define SHIM_XFER_HANG		2	// Never completes (only HAL_SPI_Abort() ends it)
+
+typedef struct {
+	void	(*cs)(GPIO_TypeDef * port, uint16_t pin, uint8_t level);						// Called on every chip select edge
+	uint8_t	(*xferBegin)(SPI_HandleTypeDef * hspi, uint16_t len);							// DMA transfer started, returns SHIM_XFER_*
+	void	(*xferEnd)(SPI_HandleTypeDef * hspi, const uint8_t * tx, uint8_t * rx, uint16_t len);	// Transfer complete, rx NULL for write-only
+	void	(*xferAbort)(SPI_HandleTypeDef * hspi);											// Transfer aborted before it completed
+} shimDevice;
+
+typedef struct {
+	uint32_t	xfers;						// DMA transfers started
+	uint32_t	busyStarts;					// DMA starts refused (HAL_BUSY) because the SPI was not ready
+	uint32_t	aborts;						// HAL_SPI_Abort() calls ending a transfer in progress
+	uint32_t	notifies;					// Task notifications sent from interrupts
+	uint32_t	timeouts;					// xTaskNotifyWait() calls timing out
+	uint64_t	busyUs[2];					// Time SPI1 and SPI2 spent transferring
+} shimStats;
+
+extern uint64_t shimNow;					// Simulated time (us)
+extern shimStats shimStat;
+extern uint32_t shimPreemptUs;				// Time the task loses at its next xTaskGetCurrentTaskHandle(), interrupts run meanwhile
+
+void shim_device(const shimDevice * dev);
+void shim_setTask(shimTask * task);
+void shim_run(uint64_t us);
+uint8_t shim_idle(void);
+uint32_t shim_sck(SPI_HandleTypeDef * hspi);
+void shim_spiInit(SPI_HandleTypeDef * hspi, SPI_TypeDef * instance, uint32_t prescaler);
+void shim_timInit(TIM_HandleTypeDef * htim, TIM_TypeDef * instance, uint32_t prescaler, uint32_t period);
+
+#endif /* SHIM_H_ */
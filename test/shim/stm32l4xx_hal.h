@@ -0,0 +1,227 @@
+/*
+ * stm32l4xx_hal.h (host shim)
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Just enough of the STM32L4 HAL and CMSIS core to build the LTC6804 library
+ *  on a PC. Register blocks are plain structs, the DMA transfers and the timer
+ *  run on the simulated microsecond clock of shim.c, and the completion
+ *  callbacks are delivered from its event loop like interrupts would be.
+ */
+
+#ifndef STM32L4XX_HAL_H_SHIM
+#define STM32L4XX_HAL_H_SHIM
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define __IO	volatile
+
+typedef enum {
+	HAL_OK = 0,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)	((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+
+/* ---------------- CMSIS core ---------------- */
+
+static inline uint32_t __REV16(uint32_t value)
+{
+	return(((value >> 8) & 0x00FF00FFUL) | ((value << 8) & 0xFF00FF00UL));
+}
+
+#define __DMB()		__sync_synchronize()
+
+// DSP extension: USUB16 sets the APSR.GE flag of each halfword lane, SEL reads them
+extern uint32_t shimGE;
+
+static inline uint32_t __USUB16(uint32_t op1, uint32_t op2)
+{
+	uint32_t lo = (op1 & 0xFFFF) - (op2 & 0xFFFF);
+	uint32_t hi = (op1 >> 16) - (op2 >> 16);
+
+	shimGE = (((op1 & 0xFFFF) >= (op2 & 0xFFFF)) ? 0x3 : 0) | (((op1 >> 16) >= (op2 >> 16)) ? 0xC : 0);
+	return((lo & 0xFFFF) | (hi << 16));
+}
+
+static inline uint32_t __SEL(uint32_t op1, uint32_t op2)
+{
+	return(((shimGE & 0x3) ? (op1 & 0xFFFF) : (op2 & 0xFFFF)) | ((shimGE & 0xC) ? (op1 & 0xFFFF0000) : (op2 & 0xFFFF0000)));
+}
+
+static inline uint64_t __SMLALD(uint32_t op1, uint32_t op2, uint64_t acc)
+{
+	return(acc + (int64_t)((int32_t)(int16_t)op1 * (int16_t)op2) + (int64_t)((int32_t)(int16_t)(op1 >> 16) * (int16_t)(op2 >> 16)));
+}
+
+/* ---------------- RCC ---------------- */
+
+#define SHIM_PCLK_HZ	80000000UL
+
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+/* ---------------- GPIO ---------------- */
+
+typedef struct {
+	__IO uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef enum {
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0		((uint16_t)0x0001)
+#define GPIO_PIN_1		((uint16_t)0x0002)
+#define GPIO_PIN_2		((uint16_t)0x0004)
+#define GPIO_PIN_3		((uint16_t)0x0008)
+#define GPIO_PIN_4		((uint16_t)0x0010)
+#define GPIO_PIN_5		((uint16_t)0x0020)
+#define GPIO_PIN_6		((uint16_t)0x0040)
+#define GPIO_PIN_7		((uint16_t)0x0080)
+#define GPIO_PIN_8		((uint16_t)0x0100)
+#define GPIO_PIN_15		((uint16_t)0x8000)
+
+extern GPIO_TypeDef shimGPIOA, shimGPIOB, shimGPIOC;
+#define GPIOA	(&shimGPIOA)
+#define GPIOB	(&shimGPIOB)
+#define GPIOC	(&shimGPIOC)
+
+void HAL_GPIO_WritePin(GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef * GPIOx, uint16_t GPIO_Pin);
+
+/* ---------------- SPI ---------------- */
+
+typedef struct {
+	__IO uint32_t CR1;
+	__IO uint32_t DR;
+} SPI_TypeDef;
+
+typedef struct {
+	uint32_t BaudRatePrescaler;
+} SPI_InitTypeDef;
+
+typedef enum {
+	HAL_SPI_STATE_RESET = 0,
+	HAL_SPI_STATE_READY,
+	HAL_SPI_STATE_BUSY,
+	HAL_SPI_STATE_BUSY_TX,
+	HAL_SPI_STATE_BUSY_RX,
+	HAL_SPI_STATE_BUSY_TX_RX,
+	HAL_SPI_STATE_ERROR,
+	HAL_SPI_STATE_ABORT
+} HAL_SPI_StateTypeDef;
+
+typedef struct __SPI_HandleTypeDef {
+	SPI_TypeDef *			Instance;
+	SPI_InitTypeDef			Init;
+	__IO HAL_SPI_StateTypeDef	State;
+	__IO uint32_t			ErrorCode;
+} SPI_HandleTypeDef;
+
+extern SPI_TypeDef shimSPI1, shimSPI2;
+#define SPI1	(&shimSPI1)
+#define SPI2	(&shimSPI2)
+
+#define SPI_CR1_SPE			(0x1UL << 6)
+#define SPI_CR1_BR_Pos		(3U)
+#define SPI_CR1_BR_Msk		(0x7UL << SPI_CR1_BR_Pos)
+#define SPI_BAUDRATEPRESCALER_2		(0x00000000U)
+#define SPI_BAUDRATEPRESCALER_64	(0x00000028U)
+#define SPI_BAUDRATEPRESCALER_128	(0x00000030U)
+
+#define SPI_FLAG_RXNE		(0x1U << 0)
+
+// Received bytes go straight to the DMA buffers, the Rx FIFO never holds any
+#define __HAL_SPI_GET_FLAG(__HANDLE__, __FLAG__)	((void)(__HANDLE__), 0U)
+#define __HAL_SPI_DISABLE(__HANDLE__)				((__HANDLE__)->Instance->CR1 &= ~SPI_CR1_SPE)
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef * hspi, uint8_t * pTxData, uint8_t * pRxData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef * hspi, uint8_t * pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef * hspi);
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef * hspi);
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef * hspi);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef * hspi);
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef * hspi);
+
+/* ---------------- CRC ---------------- */
+
+#define DEFAULT_POLYNOMIAL_ENABLE			((uint8_t)0x00)
+#define DEFAULT_POLYNOMIAL_DISABLE			((uint8_t)0x01)
+#define DEFAULT_INIT_VALUE_ENABLE			((uint8_t)0x00)
+#define DEFAULT_INIT_VALUE_DISABLE			((uint8_t)0x01)
+#define CRC_POLYLENGTH_32B					((uint32_t)0x00000000)
+#define CRC_POLYLENGTH_16B					((uint32_t)0x00000008)
+#define CRC_POLYLENGTH_8B					((uint32_t)0x00000010)
+#define CRC_POLYLENGTH_7B					((uint32_t)0x00000018)
+#define CRC_INPUTDATA_INVERSION_NONE		((uint32_t)0x00000000)
+#define CRC_OUTPUTDATA_INVERSION_DISABLE	((uint32_t)0x00000000)
+#define CRC_INPUTDATA_FORMAT_BYTES			((uint32_t)0x00000001)
+
+typedef struct {
+	uint8_t		DefaultPolynomialUse;
+	uint8_t		DefaultInitValueUse;
+	uint32_t	GeneratingPolynomial;
+	uint32_t	CRCLength;
+	uint32_t	InitValue;
+	uint32_t	InputDataInversionMode;
+	uint32_t	OutputDataInversionMode;
+} CRC_InitTypeDef;
+
+typedef struct {
+	void *			Instance;
+	CRC_InitTypeDef	Init;
+	uint32_t		InputDataFormat;
+} CRC_HandleTypeDef;
+
+extern uint32_t shimCRC;
+#define CRC		((void *)&shimCRC)
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef * hcrc);
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef * hcrc, uint32_t pBuffer[], uint32_t BufferLength);
+
+/* ---------------- TIM ---------------- */
+
+typedef struct {
+	__IO uint32_t CR1;
+	__IO uint32_t DIER;
+	__IO uint32_t SR;
+	__IO uint32_t CNT;
+	__IO uint32_t PSC;
+	__IO uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+	uint32_t Prescaler;
+	uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+	TIM_TypeDef *			Instance;
+	TIM_Base_InitTypeDef	Init;
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef shimTIM6, shimTIM7;
+#define TIM6	(&shimTIM6)
+#define TIM7	(&shimTIM7)
+
+#define TIM_CR1_CEN			(0x1U << 0)
+#define TIM_FLAG_UPDATE		(0x1U << 0)
+#define TIM_IT_UPDATE		(0x1U << 0)
+
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __AUTORELOAD__)	\
+	do { (__HANDLE__)->Instance->ARR = (__AUTORELOAD__); (__HANDLE__)->Init.Period = (__AUTORELOAD__); } while(0)
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__)	((__HANDLE__)->Instance->CNT = (__COUNTER__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__)		((__HANDLE__)->Instance->SR = ~(__FLAG__))
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)	((__HANDLE__)->Instance->DIER |= (__INTERRUPT__))
+#define __HAL_TIM_ENABLE(__HANDLE__)					shim_timEnable(__HANDLE__)
+
+void shim_timEnable(TIM_HandleTypeDef * htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef * htim);
+
+#endif /* STM32L4XX_HAL_H_SHIM */
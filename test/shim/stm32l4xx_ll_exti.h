@@ -0,0 +1,7 @@
+/*
+ * stm32l4xx_ll_exti.h (host shim)
+ *
+ *  Inc/main.h includes the LL drivers; on the host they all come down to the HAL shim.
+ */
+
+#include "stm32l4xx_hal.h"
@@ -0,0 +1,712 @@
+/*
+ * ltc6804_sim.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  LTC6804-1 daisy chain model (see ltc6804_sim.h). Command codes, register
+ *  layouts, conversion times and self-test codes follow the LTC6804-1 datasheet.
+ */
+
+#include "ltc6804_sim.h"
+
+#define SIM_MAX_CHAINS	2
+
+static const shimDevice simDevice;
+static simChain * simChains[SIM_MAX_CHAINS];
+static uint8_t simNumChains;
+static uint32_t simRand = 0x6804;
+
+// Conversion times in us, [MD][ADCOPT] (MD = 0 is the 422Hz/1kHz mode)
+static const uint32_t simTimeAll[4][2] = {{12807, 7150}, {1113, 1288}, {2335, 3033}, {201317, 4430}};
+static const uint32_t simTimeCvax[4][2] = {{17077, 9534}, {1564, 1736}, {3133, 4064}, {335000, 5925}};
+static const uint32_t simTimeSingle[4][2] = {{2135, 1192}, {201, 230}, {405, 521}, {34000, 754}};
+static const uint32_t simTimeStat[4][2] = {{8570, 4781}, {748, 865}, {1563, 2028}, {134000, 2959}};
+
+/* ---------------- Helpers ---------------- */
+
+void sim_seed(uint32_t seed)
+{
+	simRand = (seed != 0) ? seed : 0x6804;
+}
+
+// xorshift32, deterministic across runs
+uint32_t sim_random(void)
+{
+	simRand ^= simRand << 13;
+	simRand ^= simRand >> 17;
+	simRand ^= simRand << 5;
+	return simRand;
+}
+
+// Bitwise PEC15 straight from the datasheet algorithm, independent of the library's
+uint16_t sim_pec15(const uint8_t * data, uint8_t len)
+{
+	uint16_t remainder = 16;
+
+	for(uint8_t i = 0; i < len; i++)
+	{
+		for(int8_t bit = 7; bit >= 0; bit--)
+		{
+			uint16_t in = ((data[i] >> bit) ^ (remainder >> 14)) & 0x01;
+
+			remainder = (remainder << 1) & 0x7FFF;
+			if(in)
+			{
+				remainder ^= 0x4599;
+			}
+		}
+	}
+	return (uint16_t)(remainder << 1);
+}
+
+static simChain * sim_chainSpi(SPI_HandleTypeDef * hspi)
+{
+	for(uint8_t i = 0; i < simNumChains; i++)
+	{
+		if(simChains[i]->hspi == hspi)
+		{
+			return simChains[i];
+		}
+	}
+	return NULL;
+}
+
+void sim_resetCfg(simChain * chain, uint8_t ic)
+{
+	static const uint8_t cfgDefault[REG_BYTES_SIM] = {0xF8, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+	memcpy(chain->ic[ic].cfg, cfgDefault, sizeof(cfgDefault));
+}
+
+/*
+ * Binds a chain of numIC ICs to an SPI and chip select and powers it up:
+ * registers cleared, default configuration, core asleep
+ */
+void sim_init(simChain * chain, SPI_HandleTypeDef * hspi, GPIO_TypeDef * csPort, uint16_t csPin, uint8_t numIC)
+{
+	uint8_t i;
+
+	for(i = 0; i < simNumChains; i++)
+	{
+		if(simChains[i]->hspi == hspi)
+		{
+			break;
+		}
+	}
+	if(i == simNumChains)
+	{
+		if(simNumChains == SIM_MAX_CHAINS)
+		{
+			return;
+		}
+		simNumChains++;
+	}
+	simChains[i] = chain;
+
+	memset(chain, 0, sizeof(*chain));
+	chain->hspi = hspi;
+	chain->csPort = csPort;
+	chain->csPin = csPin;
+	chain->numIC = (numIC > SIM_MAX_IC) ? SIM_MAX_IC : numIC;
+	chain->asleep = 1;
+	for(uint8_t ic = 0; ic < SIM_MAX_IC; ic++)
+	{
+		simIC * dev = &chain->ic[ic];
+
+		sim_resetCfg(chain, ic);
+		memset(dev->cv, 0xFF, sizeof(dev->cv));
+		memset(dev->aux, 0xFF, sizeof(dev->aux));
+		memset(dev->stat, 0xFF, 4 * sizeof(uint16_t));
+		dev->stat[4] = 0x0000;
+		dev->stat[5] = 0x0200;									// MUXFAIL until DIAGN runs
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			dev->cell[cell] = 36000;
+		}
+		for(uint8_t gpio = 0; gpio < 5; gpio++)
+		{
+			dev->gpio[gpio] = 10000 + 1000 * gpio;
+		}
+		dev->ref2 = 30000;
+		dev->itmp = (25 + 273) * 75;							// 25 degC
+		dev->va = 50000;
+		dev->vd = 30000;
+	}
+	HAL_GPIO_WritePin(csPort, csPin, GPIO_PIN_SET);
+	shim_device(&simDevice);
+}
+
+// Fills the cell voltages with deterministic values between 3.0V and 4.1V
+void sim_cells(simChain * chain, uint32_t seed)
+{
+	sim_seed(seed);
+	for(uint8_t ic = 0; ic < chain->numIC; ic++)
+	{
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			chain->ic[ic].cell[cell] = 30000 + (sim_random() % 11000);
+		}
+	}
+}
+
+/* ---------------- Conversions ---------------- */
+
+// Self-test code of ST with the mode of the command (27kHz and 14kHz differ)
+static uint16_t sim_stCode(const simIC * dev, uint8_t st, uint8_t md)
+{
+	uint8_t adcopt = dev->cfg[0] & 0x01;
+	uint16_t code;
+
+	if(md == 1)
+	{
+		code = (st == 1) ? (adcopt ? 0x9553 : 0x9565) : (adcopt ? 0x6AAC : 0x6A9A);
+	}
+	else
+	{
+		code = (st == 1) ? 0x9555 : 0x6AAA;
+	}
+	return dev->stFail ? (code ^ 0x0001) : code;
+}
+
+// Updates the OV/UV flags of one cell from its new code
+static void sim_flags(simIC * dev, uint8_t cell)
+{
+	uint16_t vuv = ((uint16_t)(dev->cfg[2] & 0x0F) << 8) | dev->cfg[1];
+	uint16_t vov = ((uint16_t)dev->cfg[3] << 4) | (dev->cfg[2] >> 4);
+	uint16_t * flags = (cell < 8) ? &dev->stat[4] : &dev->stat[5];
+	uint8_t bit = 2 * (cell & 0x07);
+
+	*flags &= ~(0x3 << bit);
+	if(dev->cv[cell] < (uint32_t)(vuv + 1) * 16)
+	{
+		*flags |= (0x1 << bit);
+	}
+	if(dev->cv[cell] > (uint32_t)vov * 16)
+	{
+		*flags |= (0x2 << bit);
+	}
+}
+
+// Commits the conversion in progress if it is over
+static void sim_settle(simIC * dev)
+{
+	uint8_t md = (dev->convArg >> 8) & 0x03;
+	uint8_t arg = dev->convArg & 0xFF;
+	uint8_t pup = dev->owStreak & 0x80;
+	uint32_t soc = 0;
+
+	if((dev->conv == SIM_CONV_NONE) || (shimNow < dev->convEnd))
+	{
+		return;
+	}
+
+	switch(dev->conv)
+	{
+	case SIM_CONV_CELL:
+	case SIM_CONV_CVAX:
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			if((arg == 0) || ((cell % 6) + 1 == arg) || (dev->conv == SIM_CONV_CVAX))
+			{
+				dev->cv[cell] = dev->cell[cell];
+				sim_flags(dev, cell);
+			}
+		}
+		if(dev->conv == SIM_CONV_CVAX)
+		{
+			dev->aux[0] = dev->gpio[0];
+			dev->aux[1] = dev->gpio[1];
+		}
+		break;
+
+	case SIM_CONV_OW:
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			dev->cv[cell] = dev->cell[cell];
+		}
+		// The wire currents need a couple of conversions to pull an open input away
+		if((dev->owStreak & 0x7F) >= 2)
+		{
+			if(pup && (dev->openWire & 0x0001))
+			{
+				dev->cv[0] = 0;
+			}
+			if(!pup && (dev->openWire & 0x1000))
+			{
+				dev->cv[11] = 0;
+			}
+			for(uint8_t wire = 1; wire < 12; wire++)
+			{
+				if(dev->openWire & (1U << wire))
+				{
+					dev->cv[wire] = pup ? ((dev->cell[wire] > 5000) ? dev->cell[wire] - 5000 : 0) :
+							((dev->cell[wire] < 60535) ? dev->cell[wire] + 5000 : 0xFFFF);
+				}
+			}
+		}
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			sim_flags(dev, cell);
+		}
+		break;
+
+	case SIM_CONV_CVST:
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			dev->cv[cell] = sim_stCode(dev, arg, md);
+		}
+		break;
+
+	case SIM_CONV_AUX:
+		for(uint8_t ch = 0; ch < 5; ch++)
+		{
+			if((arg == 0) || (arg == ch + 1))
+			{
+				dev->aux[ch] = dev->gpio[ch];
+			}
+		}
+		if((arg == 0) || (arg == 6))
+		{
+			dev->aux[5] = dev->ref2;
+		}
+		break;
+
+	case SIM_CONV_AXST:
+		for(uint8_t ch = 0; ch < 6; ch++)
+		{
+			dev->aux[ch] = sim_stCode(dev, arg, md);
+		}
+		break;
+
+	case SIM_CONV_STAT:
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			soc += dev->cell[cell];
+		}
+		if((arg == 0) || (arg == 1))
+		{
+			dev->stat[0] = soc / 20;
+		}
+		if((arg == 0) || (arg == 2))
+		{
+			dev->stat[1] = dev->itmp;
+		}
+		if((arg == 0) || (arg == 3))
+		{
+			dev->stat[2] = dev->va;
+		}
+		if((arg == 0) || (arg == 4))
+		{
+			dev->stat[3] = dev->vd;
+		}
+		break;
+
+	case SIM_CONV_STATST:
+		for(uint8_t reg = 0; reg < 4; reg++)
+		{
+			dev->stat[reg] = sim_stCode(dev, arg, md);
+		}
+		break;
+
+	case SIM_CONV_DIAGN:
+		dev->stat[5] = dev->muxFail ? (dev->stat[5] | 0x0200) : (dev->stat[5] & ~0x0200);
+		break;
+	}
+	dev->conv = SIM_CONV_NONE;
+}
+
+static void sim_convStart(simChain * chain, uint8_t conv, uint8_t md, uint8_t arg)
+{
+	chain->conversions[conv]++;
+	for(uint8_t ic = 0; ic < chain->numIC; ic++)
+	{
+		simIC * dev = &chain->ic[ic];
+		uint8_t adcopt = dev->cfg[0] & 0x01;
+		uint8_t refon = dev->cfg[0] & 0x04;
+		uint32_t us;
+
+		switch(conv)
+		{
+		case SIM_CONV_CELL:
+			us = (arg == 0) ? simTimeAll[md][adcopt] : simTimeSingle[md][adcopt];
+			break;
+		case SIM_CONV_AUX:
+			us = (arg == 0) ? simTimeAll[md][adcopt] : simTimeSingle[md][adcopt];
+			break;
+		case SIM_CONV_STAT:
+		case SIM_CONV_STATST:
+			us = simTimeStat[md][adcopt];
+			break;
+		case SIM_CONV_CVAX:
+			us = simTimeCvax[md][adcopt];
+			break;
+		case SIM_CONV_DIAGN:
+			us = refon ? 400 : 4500;
+			refon = 1;											// Already includes the reference power up
+			break;
+		default:												// ADOW, CVST, AXST: all channels
+			us = simTimeAll[md][adcopt];
+			break;
+		}
+		if(!refon)
+		{
+			us += SIM_T_REFUP_US;
+		}
+
+		sim_settle(dev);
+		if(conv == SIM_CONV_OW)
+		{
+			uint8_t pup = (arg & 0x80);
+
+			dev->owStreak = ((dev->owStreak & 0x80) == pup) ? (dev->owStreak + 1) : (pup | 1);
+			if((dev->owStreak & 0x7F) == 0)
+			{
+				dev->owStreak |= 0x7F;									// Saturate
+			}
+		}
+		else if((conv == SIM_CONV_CELL) || (conv == SIM_CONV_CVST) || (conv == SIM_CONV_CVAX))
+		{
+			dev->owStreak = 0;
+		}
+		dev->conv = conv;
+		dev->convArg = ((uint16_t)md << 8) | (arg & 0x7F);
+		dev->convEnd = shimNow + us;
+	}
+}
+
+static uint8_t sim_converting(simChain * chain)
+{
+	for(uint8_t ic = 0; ic < chain->numIC; ic++)
+	{
+		sim_settle(&chain->ic[ic]);
+		if(chain->ic[ic].conv != SIM_CONV_NONE)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* ---------------- Register reads ---------------- */
+
+// Fills the 6 data bytes of group grp of an IC
+static void sim_group(const simIC * dev, uint8_t grp, uint8_t * data)
+{
+	const uint16_t * words;
+
+	if(grp == SIM_GRP_CFG)
+	{
+		memcpy(data, dev->cfg, REG_BYTES_SIM);
+		data[0] = (data[0] | 0xF8) & ~0x02;								// GPIO pins read high, SWTRD pin low
+		return;
+	}
+	if(grp < SIM_GRP_AUXA)
+	{
+		words = &dev->cv[3 * grp];
+	}
+	else if(grp < SIM_GRP_STATA)
+	{
+		words = &dev->aux[3 * (grp - SIM_GRP_AUXA)];
+	}
+	else
+	{
+		words = &dev->stat[3 * (grp - SIM_GRP_STATA)];
+	}
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		data[2 * i] = (uint8_t)words[i];
+		data[2 * i + 1] = (uint8_t)(words[i] >> 8);
+	}
+}
+
+// Answers a register group read: IC 0 first, each group followed by its PEC
+static void sim_read(simChain * chain, uint8_t grp, uint8_t * rx, uint16_t len)
+{
+	uint8_t frame[8];
+	uint16_t pec;
+	uint8_t corrupt;
+
+	chain->reads[grp]++;
+	if(rx == NULL)
+	{
+		return;
+	}
+	for(uint8_t ic = 0; ic < chain->numIC; ic++)
+	{
+		uint16_t at = 4 + 8 * ic;
+
+		sim_settle(&chain->ic[ic]);										// A conversion done meanwhile has landed
+		sim_group(&chain->ic[ic], grp, frame);
+		pec = sim_pec15(frame, REG_BYTES_SIM);
+		frame[6] = (uint8_t)(pec >> 8);
+		frame[7] = (uint8_t)pec;
+
+		corrupt = 0;
+		if(chain->corruptCount && (chain->corruptIC == ic) && (chain->corruptGrp == grp))
+		{
+			chain->corruptCount--;
+			corrupt = 1;
+		}
+		if(chain->marginalHz && (shim_sck(chain->hspi) > chain->marginalHz) &&
+				((sim_random() % 1000000) < chain->marginalPpm))
+		{
+			corrupt = 1;
+		}
+		if(corrupt)
+		{
+			uint32_t r = sim_random();
+
+			frame[(r >> 3) & 0x07] ^= (uint8_t)(1U << (r & 0x07));
+			chain->corrupted++;
+		}
+
+		for(uint8_t b = 0; b < 8; b++)
+		{
+			if(at + b < len)
+			{
+				rx[at + b] = frame[b];
+			}
+		}
+	}
+}
+
+/* ---------------- Command decoder ---------------- */
+
+static void sim_command(simChain * chain, const uint8_t * tx, uint8_t * rx, uint16_t len)
+{
+	uint16_t code = ((uint16_t)(tx[0] & 0x07) << 8) | tx[1];
+	uint8_t md = (code >> 7) & 0x03;
+	uint16_t pec = sim_pec15(tx, 2);
+
+	if((tx[2] != (uint8_t)(pec >> 8)) || (tx[3] != (uint8_t)pec) || (tx[0] & 0xF8))
+	{
+		chain->cmdPecErrs++;
+		return;
+	}
+	chain->cmds++;
+	chain->lastCmd = shimNow;
+
+	switch(code)
+	{
+	case 0x001:													// WRCFG, last IC's data first
+		for(uint8_t ic = 0; ic < chain->numIC; ic++)
+		{
+			uint16_t at = 4 + 8 * (chain->numIC - 1 - ic);
+
+			if(at + 8 > len)
+			{
+				continue;
+			}
+			pec = sim_pec15(&tx[at], REG_BYTES_SIM);
+			if((tx[at + 6] != (uint8_t)(pec >> 8)) || (tx[at + 7] != (uint8_t)pec))
+			{
+				chain->cfgPecErrs++;
+				continue;
+			}
+			memcpy(chain->ic[ic].cfg, &tx[at], REG_BYTES_SIM);
+		}
+		return;
+	case 0x002: sim_read(chain, SIM_GRP_CFG, rx, len);				return;
+	case 0x004: sim_read(chain, SIM_GRP_CVA + 0, rx, len);			return;
+	case 0x006: sim_read(chain, SIM_GRP_CVA + 1, rx, len);			return;
+	case 0x008: sim_read(chain, SIM_GRP_CVA + 2, rx, len);			return;
+	case 0x00A: sim_read(chain, SIM_GRP_CVA + 3, rx, len);			return;
+	case 0x00C: sim_read(chain, SIM_GRP_AUXA + 0, rx, len);			return;
+	case 0x00E: sim_read(chain, SIM_GRP_AUXA + 1, rx, len);			return;
+	case 0x010: sim_read(chain, SIM_GRP_STATA + 0, rx, len);		return;
+	case 0x012: sim_read(chain, SIM_GRP_STATA + 1, rx, len);		return;
+	case 0x711:													// CLRCELL
+		for(uint8_t ic = 0; ic < chain->numIC; ic++)
+		{
+			memset(chain->ic[ic].cv, 0xFF, sizeof(chain->ic[ic].cv));
+		}
+		return;
+	case 0x712:													// CLRAUX
+		for(uint8_t ic = 0; ic < chain->numIC; ic++)
+		{
+			memset(chain->ic[ic].aux, 0xFF, sizeof(chain->ic[ic].aux));
+		}
+		return;
+	case 0x713:													// CLRSTAT
+		for(uint8_t ic = 0; ic < chain->numIC; ic++)
+		{
+			memset(chain->ic[ic].stat, 0xFF, 5 * sizeof(uint16_t));
+			chain->ic[ic].stat[5] |= 0x03FF;
+		}
+		return;
+	case 0x714:													// PLADC, SDO held low while converting
+		chain->plPolls++;
+		if(sim_converting(chain))
+		{
+			chain->plBusy++;
+			for(uint16_t i = 4; (rx != NULL) && (i < len); i++)
+			{
+				rx[i] = 0x00;
+			}
+		}
+		return;
+	case 0x715:													// DIAGN
+		sim_convStart(chain, SIM_CONV_DIAGN, md, 0);
+		return;
+	}
+
+	// Commands carrying the mode and channel fields; ADCVAX overlaps ADSTAT, test it first
+	if((code & 0x066F) == 0x046F)
+	{
+		sim_convStart(chain, SIM_CONV_CVAX, md, 0);
+	}
+	else if((code & 0x0668) == 0x0260)
+	{
+		sim_convStart(chain, SIM_CONV_CELL, md, code & 0x07);
+	}
+	else if((code & 0x0628) == 0x0228)
+	{
+		sim_convStart(chain, SIM_CONV_OW, md, (code & 0x0040) ? 0x80 : 0x00);
+	}
+	else if((code & 0x061F) == 0x0207)
+	{
+		sim_convStart(chain, SIM_CONV_CVST, md, (code >> 5) & 0x03);
+	}
+	else if((code & 0x0678) == 0x0460)
+	{
+		sim_convStart(chain, SIM_CONV_AUX, md, code & 0x07);
+	}
+	else if((code & 0x0678) == 0x0468)
+	{
+		sim_convStart(chain, SIM_CONV_STAT, md, code & 0x07);
+	}
+	else if((code & 0x061F) == 0x0407)
+	{
+		sim_convStart(chain, SIM_CONV_AXST, md, (code >> 5) & 0x03);
+	}
+	else if((code & 0x061F) == 0x040F)
+	{
+		sim_convStart(chain, SIM_CONV_STATST, md, (code >> 5) & 0x03);
+	}
+	else
+	{
+		chain->unknownCmds++;
+	}
+}
+
+/* ---------------- Shim hooks ---------------- */
+
+static void sim_cs(GPIO_TypeDef * port, uint16_t pin, uint8_t level)
+{
+	for(uint8_t i = 0; i < simNumChains; i++)
+	{
+		simChain * chain = simChains[i];
+
+		if((chain->csPort != port) || (chain->csPin != pin))
+		{
+			continue;
+		}
+		if(chain->xferActive)
+		{
+			chain->csGlitches++;
+		}
+		if(!level)
+		{
+			// Watchdog: no valid command for 2s, the core sleeps and forgets its configuration
+			if(!chain->asleep && ((shimNow - chain->lastCmd) > SIM_T_SLEEP_US))
+			{
+				chain->asleep = 1;
+				chain->sleeps++;
+				for(uint8_t ic = 0; ic < SIM_MAX_IC; ic++)
+				{
+					sim_resetCfg(chain, ic);
+				}
+			}
+			if(chain->asleep)
+			{
+				chain->asleep = 0;
+				chain->wakeAt = shimNow + SIM_T_WAKE_US;
+				chain->lastCmd = shimNow;
+				chain->dropWindow = 1;
+			}
+			else
+			{
+				chain->dropWindow = ((shimNow - chain->lastEdge) > SIM_T_IDLE_US);
+			}
+			chain->windowBytes = 0;
+		}
+		chain->csLow = !level;
+		chain->csEdges++;
+		chain->lastEdge = shimNow;
+	}
+}
+
+static uint8_t sim_xferBegin(SPI_HandleTypeDef * hspi, uint16_t len)
+{
+	simChain * chain = sim_chainSpi(hspi);
+
+	(void)len;
+	if(chain == NULL)
+	{
+		return SHIM_XFER_OK;
+	}
+	if(!chain->csLow)
+	{
+		chain->noCs++;
+	}
+	if(chain->windowBytes)
+	{
+		chain->framingErrs++;
+	}
+	chain->xferActive = 1;
+	if(chain->hangCount)
+	{
+		chain->hangCount--;
+		return SHIM_XFER_HANG;
+	}
+	if(chain->errorCount)
+	{
+		chain->errorCount--;
+		return SHIM_XFER_ERROR;
+	}
+	return SHIM_XFER_OK;
+}
+
+static void sim_xferEnd(SPI_HandleTypeDef * hspi, const uint8_t * tx, uint8_t * rx, uint16_t len)
+{
+	simChain * chain = sim_chainSpi(hspi);
+
+	if(rx != NULL)
+	{
+		memset(rx, 0xFF, len);
+	}
+	if(chain == NULL)
+	{
+		return;
+	}
+	chain->xferActive = 0;
+	if(!chain->csLow)
+	{
+		return;
+	}
+	chain->windowBytes += len;
+	if(chain->dropWindow || (shimNow < chain->wakeAt) || (len < 4))
+	{
+		chain->dropped++;
+		return;
+	}
+	sim_command(chain, tx, rx, len);
+}
+
+static void sim_xferAbort(SPI_HandleTypeDef * hspi)
+{
+	simChain * chain = sim_chainSpi(hspi);
+
+	if(chain != NULL)
+	{
+		chain->xferActive = 0;
+		chain->windowBytes++;									// Partial frame, the chip ignores the rest of this CS period
+	}
+}
+
+static const shimDevice simDevice = {
+	.cs = sim_cs,
+	.xferBegin = sim_xferBegin,
+	.xferEnd = sim_xferEnd,
+	.xferAbort = sim_xferAbort
+};
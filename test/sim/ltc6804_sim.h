@@ -0,0 +1,132 @@
+/*
+ * ltc6804_sim.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  LTC6804-1 daisy chain model behind the SPI shim, for host tests.
+ *
+ *  Each chain sits on one SPI and chip select. The bytes clocked out by the
+ *  library are decoded like the chips would: the command PEC (checked with an
+ *  independent bitwise PEC15) must match or the command is ignored, WRCFG data
+ *  is taken by each IC only with a good PEC, conversions take their datasheet
+ *  time and land in the registers when they complete, and reads return each
+ *  IC's group with its PEC, IC 0 first.
+ *
+ *  The isoSPI port goes IDLE after tIDLE without chip select activity and the
+ *  core SLEEPs (configuration reset) after the 2s watchdog: a chip select low
+ *  period starting on an idle port only wakes it, whatever is clocked in it is
+ *  lost and reads back 0xFF.
+ *
+ *  Faults can be injected per chain: corrupted groups, a marginal link above a
+ *  clock, transfers that hang or end in a DMA error, chips losing their
+ *  configuration, open sense wires, MUX and supply failures.
+ */
+
+#ifndef LTC6804_SIM_H_
+#define LTC6804_SIM_H_
+
+#include "shim.h"
+
+#define SIM_MAX_IC			32
+#define REG_BYTES_SIM		6			// Data bytes of a register group
+#define SIM_T_IDLE_US		4300		// isoSPI port idle timeout (minimum)
+#define SIM_T_SLEEP_US		2000000		// Watchdog timeout, the core sleeps and resets its configuration
+#define SIM_T_WAKE_US		300			// Core wake up time from SLEEP
+#define SIM_T_REFUP_US		3500		// Reference power up before a conversion with REFON = 0
+
+// Register groups, same numbering as LTC6804_GRP_*
+#define SIM_GRP_CVA			0
+#define SIM_GRP_AUXA		4
+#define SIM_GRP_STATA		6
+#define SIM_GRP_CFG			8
+#define SIM_GRP_NUM			9
+
+// Conversion kinds
+#define SIM_CONV_NONE		0
+#define SIM_CONV_CELL		1			// ADCV
+#define SIM_CONV_OW			2			// ADOW
+#define SIM_CONV_CVST		3			// CVST
+#define SIM_CONV_AUX		4			// ADAX
+#define SIM_CONV_AXST		5			// AXST
+#define SIM_CONV_STAT		6			// ADSTAT
+#define SIM_CONV_STATST		7			// STATST
+#define SIM_CONV_CVAX		8			// ADCVAX
+#define SIM_CONV_DIAGN		9			// DIAGN
+
+typedef struct {
+	// Inputs
+	uint16_t	cell[12];				// Cell voltages (100uV/LSB)
+	uint16_t	gpio[5];				// GPIO voltages (100uV/LSB)
+	uint16_t	ref2;					// Second reference (100uV/LSB)
+	uint16_t	itmp;					// Die temperature code
+	uint16_t	va;						// Analog supply (100uV/LSB)
+	uint16_t	vd;						// Digital supply (100uV/LSB)
+	uint16_t	openWire;				// Open sense wires (bit n = Cn)
+	uint8_t		muxFail;				// DIAGN fails
+	uint8_t		stFail;					// Self-tests return a wrong pattern
+
+	// Registers
+	uint8_t		cfg[6];
+	uint16_t	cv[12];
+	uint16_t	aux[6];
+	uint16_t	stat[6];				// SOC, ITMP, VA, VD, flags low, flags high
+
+	// Conversion in progress (committed when read after convEnd)
+	uint8_t		conv;
+	uint16_t	convArg;				// CH, CHG, ST or PUP of the command
+	uint64_t	convEnd;
+	uint8_t		owStreak;				// ADOW conversions in a row with the same current (bit 7: pull-up)
+} simIC;
+
+typedef struct {
+	SPI_HandleTypeDef *	hspi;
+	GPIO_TypeDef *	csPort;
+	uint16_t	csPin;
+	uint8_t		numIC;
+	simIC		ic[SIM_MAX_IC];
+
+	// isoSPI link state
+	uint8_t		asleep;					// Core in SLEEP (configuration reset)
+	uint8_t		csLow;
+	uint8_t		xferActive;				// A transfer is being clocked
+	uint8_t		dropWindow;				// This chip select low period only wakes the port
+	uint16_t	windowBytes;			// Bytes clocked in this chip select low period
+	uint32_t	csEdges;
+	uint64_t	lastEdge;
+	uint64_t	lastCmd;
+	uint64_t	wakeAt;
+
+	// Fault injection
+	uint8_t		corruptIC;				// IC and group corrupted by the next corruptCount reads of it
+	uint8_t		corruptGrp;
+	uint16_t	corruptCount;
+	uint32_t	marginalHz;				// Above this SCK each IC frame is corrupted with marginalPpm probability (0: off)
+	uint32_t	marginalPpm;
+	uint16_t	hangCount;				// Next transfers hang
+	uint16_t	errorCount;				// Next transfers end in a DMA error
+
+	// Counters
+	uint32_t	cmds;					// Commands decoded
+	uint32_t	cmdPecErrs;				// Commands ignored for a bad command PEC
+	uint32_t	cfgPecErrs;				// WRCFG data ignored by an IC for a bad PEC
+	uint32_t	unknownCmds;			// Commands with a good PEC but no meaning
+	uint32_t	dropped;				// Transfers lost in a chip select period waking the port
+	uint32_t	sleeps;					// Watchdog timeouts (configuration reset)
+	uint32_t	csGlitches;				// Chip select edges in the middle of a transfer
+	uint32_t	framingErrs;			// Transfers not starting a chip select low period
+	uint32_t	noCs;					// Transfers clocked with chip select high
+	uint32_t	reads[SIM_GRP_NUM];		// Reads of each group
+	uint32_t	corrupted;				// IC frames corrupted on purpose
+	uint32_t	conversions[10];		// Conversions started of each kind
+	uint32_t	plPolls;				// PLADC polls
+	uint32_t	plBusy;					// PLADC polls answered busy
+} simChain;
+
+void sim_init(simChain * chain, SPI_HandleTypeDef * hspi, GPIO_TypeDef * csPort, uint16_t csPin, uint8_t numIC);
+void sim_cells(simChain * chain, uint32_t seed);
+void sim_resetCfg(simChain * chain, uint8_t ic);
+uint16_t sim_pec15(const uint8_t * data, uint8_t len);
+uint32_t sim_random(void);
+void sim_seed(uint32_t seed);
+
+#endif /* LTC6804_SIM_H_ */
@@ -0,0 +1,165 @@
+/*
+ * test_async.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Async requests next to the blocking calls: a request submitted while a job
+ *  list is still on the bus waits for it instead of taking its completion,
+ *  blocking reads made with requests outstanding do not overwrite their slots,
+ *  the most urgent class goes first, and a failed transfer only fails its own
+ *  request.
+ */
+
+#include "harness.h"
+#include "nodeConf.h"
+
+#define TEST_IC		4
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+
+static const uint8_t cmdRDCFG[CMD_LEN] = {0x00, 0x02, 0x2B, 0x0A};
+static uint8_t cfgRead[TEST_IC][REG_BYTES];
+static ltc68041Req * doneOrder[8];
+static uint8_t doneCount;
+
+// Keeps the configuration read back, IC 0 first
+static int8_t parseCfg(ltc68041ChainHandle * hbms, const uint8_t * rx, void * ctx)
+{
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		memcpy(cfgRead[ic], rx + ic * BYTES_IN_REG, REG_BYTES);
+	}
+	return 0;
+}
+
+static void recordDone(ltc68041ChainHandle * hbms, ltc68041Req * req)
+{
+	doneOrder[doneCount++] = req;
+}
+
+static void cfgReq(ltc68041Req * req, uint8_t prio)
+{
+	memset(req, 0, sizeof(*req));
+	req->cmd = cmdRDCFG;
+	req->len = BYTES_IN_REG * TEST_IC;
+	req->parse = parseCfg;
+	req->done = recordDone;
+	req->prio = prio;
+}
+
+static uint8_t cellsOk(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		if(memcmp(hbms1.cellVolts[ic], chain1.ic[ic].cell, sizeof(hbms1.cellVolts[ic])) != 0)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// The GPIO bits of CFGR0 read back the pin levels, only ADCOPT, SWTRD and REFON are compared there
+static uint8_t cfgOk(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		if(((cfgRead[ic][0] ^ chain1.ic[ic].cfg[0]) & 0x07) ||
+				(memcmp(&cfgRead[ic][1], &chain1.ic[ic].cfg[1], REG_BYTES - 1) != 0))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	ltc68041Req rdcv[NUM_CV_REG];
+	ltc68041Req req[3];
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 21);
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);		// Reads the GPIOs converted by the first one
+
+	// Submitted while a job list is on the bus: waits for it, both complete
+	memset(hbms1.cellVolts, 0, sizeof(hbms1.cellVolts[0]) * TEST_IC);
+	memset(cfgRead, 0, sizeof(cfgRead));
+	cfgReq(&req[0], LTC6804_PRIO_NORMAL);
+	LTC6804_rdcv_pipe(&hbms1);
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[0]) == 0);
+	CHECK(LTC6804_rdcv_pipeCplt(&hbms1) == 0);
+	CHECK(cellsOk());
+	CHECK(LTC6804_asyncWait(&hbms1, &req[0]) == 0);
+	CHECK(cfgOk());
+	CHECK(!hbms1.asyncBusy && !hbms1.asyncActive);
+
+	// A blocking read with requests outstanding waits for them and leaves their slots alone
+	memset(hbms1.cellVolts, 0, sizeof(hbms1.cellVolts[0]) * TEST_IC);
+	memset(hbms1.auxVolts, 0, sizeof(hbms1.auxVolts[0]) * TEST_IC);
+	for(uint8_t reg = 1; reg <= NUM_CV_REG; reg++)
+	{
+		LTC6804_asyncRdcvReq(&hbms1, &rdcv[reg - 1], reg);
+		rdcv[reg - 1].prio = LTC6804_PRIO_SAFETY;
+		CHECK(LTC6804_asyncSubmit(&hbms1, &rdcv[reg - 1]) == 0);
+	}
+	CHECK(LTC6804_rdaux(&hbms1, 1) == 0);
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		CHECK(hbms1.auxVolts[ic][0] == chain1.ic[ic].gpio[0]);
+	}
+	LTC6804_asyncFlush(&hbms1);
+	for(uint8_t reg = 0; reg < NUM_CV_REG; reg++)
+	{
+		CHECK(rdcv[reg].state == LTC6804_REQ_DONE);
+		CHECK(rdcv[reg].status == 0);
+	}
+	CHECK(cellsOk());
+
+	// Queued behind a transfer: the most urgent class overtakes, whatever the submission order
+	doneCount = 0;
+	cfgReq(&req[0], LTC6804_PRIO_NORMAL);
+	cfgReq(&req[1], LTC6804_PRIO_DIAG);
+	cfgReq(&req[2], LTC6804_PRIO_SAFETY);
+	for(uint8_t r = 0; r < 3; r++)
+	{
+		CHECK(LTC6804_asyncSubmit(&hbms1, &req[r]) == 0);
+	}
+	LTC6804_asyncFlush(&hbms1);
+	CHECK(doneCount == 3);
+	CHECK(doneOrder[0] == &req[0]);
+	CHECK(doneOrder[1] == &req[2]);
+	CHECK(doneOrder[2] == &req[1]);
+	CHECK(cfgOk());
+
+	// A DMA error fails its request only, the queue carries on
+	doneCount = 0;
+	memset(cfgRead, 0, sizeof(cfgRead));
+	cfgReq(&req[0], LTC6804_PRIO_NORMAL);
+	cfgReq(&req[1], LTC6804_PRIO_NORMAL);
+	chain1.errorCount = 1;
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[0]) == 0);
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[1]) == 0);
+	CHECK(LTC6804_asyncWait(&hbms1, &req[1]) == 0);
+	CHECK(req[0].status == -2);
+	CHECK(req[0].state == LTC6804_REQ_DONE);
+	CHECK(cfgOk());
+	CHECK(LTC6804_rdcv(&hbms1, 0) == 0);
+	CHECK(cellsOk());
+
+	CHECK(chain1.cmdPecErrs == 0);
+	CHECK(chain1.unknownCmds == 0);
+	CHECK(chain1.csGlitches == 0);
+	CHECK(chain1.framingErrs == 0);
+	CHECK(chain1.noCs == 0);
+	CHECK(shimStat.timeouts == 0);
+
+	return harness_report("test_async");
+}
@@ -0,0 +1,157 @@
+/*
+ * test_chain.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Chain length as a per-handle parameter: the same handle is bound to caller
+ *  storage for 1 to 32 ICs. Every IC must be configured and read back, no
+ *  write may leave its array (each one is followed by a canary), and a
+ *  register read must cost exactly CMD_LEN + 8 * numIC bytes per group.
+ */
+
+#include <stdlib.h>
+#include "harness.h"
+
+#define CANARY_LEN		32
+#define CANARY_BYTE		0xA5
+#define MAX_BUFFERS		32
+
+static ltc68041ChainHandle hbms1;
+static simChain chain1;
+static uint8_t * buffers[MAX_BUFFERS];
+static size_t bufferLen[MAX_BUFFERS];
+static uint8_t numBuffers;
+
+// Caller storage of len bytes followed by a canary
+static void * canaried(size_t len)
+{
+	uint8_t * buf = aligned_alloc(4, (len + CANARY_LEN + 3) & ~(size_t)3);
+
+	memset(buf, 0, len);
+	memset(buf + len, CANARY_BYTE, CANARY_LEN);
+	buffers[numBuffers] = buf;
+	bufferLen[numBuffers++] = len;
+	return buf;
+}
+
+static uint8_t canariesOk(void)
+{
+	for(uint8_t i = 0; i < numBuffers; i++)
+	{
+		for(uint8_t b = 0; b < CANARY_LEN; b++)
+		{
+			if(buffers[i][bufferLen[i] + b] != CANARY_BYTE)
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void freeBuffers(void)
+{
+	while(numBuffers)
+	{
+		free(buffers[--numBuffers]);
+	}
+}
+
+// What LTC68041_CHAIN_STORAGE() and LTC68041_CHAIN_HANDLE() give, for a run time n
+static void bindStorage(ltc68041ChainHandle * hbms, uint8_t n)
+{
+	memset(hbms, 0, sizeof(*hbms));
+	hbms->numIC = n;
+	hbms->spiRxBuf = canaried(LTC6804_BUF_LEN(n));
+	hbms->spiTxBuf = canaried(LTC6804_BUF_LEN(n));
+	hbms->boardConfigs = canaried(n * sizeof(*hbms->boardConfigs));
+	hbms->cfgShadow = canaried(n * sizeof(*hbms->cfgShadow));
+	hbms->boardStat = canaried(n * sizeof(*hbms->boardStat));
+	hbms->auxVolts = canaried(n * sizeof(*hbms->auxVolts));
+	hbms->cellVolts = canaried(n * sizeof(*hbms->cellVolts));
+	hbms->diagHistory = canaried(n * sizeof(*hbms->diagHistory));
+	hbms->owPU = canaried(n * sizeof(*hbms->owPU));
+	hbms->owPD = canaried(n * sizeof(*hbms->owPD));
+	hbms->owOpen = canaried(n * sizeof(*hbms->owOpen));
+	hbms->linkIcErrs = canaried(n * sizeof(*hbms->linkIcErrs));
+	hbms->pecMap = canaried(n * sizeof(*hbms->pecMap));
+	hbms->pecCount = canaried(n * sizeof(*hbms->pecCount));
+	for(uint8_t frame = 0; frame < 2; frame++)
+	{
+		hbms->snap[frame].cellVolts = canaried(n * sizeof(*hbms->cellVolts));
+		hbms->snap[frame].auxVolts = canaried(n * sizeof(*hbms->auxVolts));
+		hbms->snap[frame].boardStat = canaried(n * sizeof(*hbms->boardStat));
+		hbms->snap[frame].stats.icSum = canaried(n * sizeof(uint32_t));
+	}
+}
+
+int main(void)
+{
+	static const uint8_t sizes[] = {1, 2, 3, 5, 8, 12, 16, 24, 31, 32};
+	ltc68041ChainInitStruct hinit[SIM_MAX_IC];
+	uint16_t (*frameCells)[12];
+	ltc68041Frame frame;
+
+	harness_init();
+	printf("  ICs  RDCV bus time (us)\n");
+	for(uint8_t s = 0; s < sizeof(sizes); s++)
+	{
+		uint8_t n = sizes[s];
+		uint64_t busy;
+		uint32_t expected = 0;
+
+		bindStorage(&hbms1, n);
+		harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+		harness_params(hinit, n);
+		for(uint8_t ic = 0; ic < n; ic++)
+		{
+			hinit[ic].dcc = ic & 0x0FFF;							// Something different on every IC
+		}
+		sim_cells(&chain1, n);
+
+		CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+		for(uint8_t ic = 0; ic < n; ic++)
+		{
+			CHECK(memcmp(chain1.ic[ic].cfg, hbms1.boardConfigs[ic], REG_BYTES) == 0);
+		}
+		CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX | LTC6804_SCAN_STAT) == 0);
+		CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+		for(uint8_t ic = 0; ic < n; ic++)
+		{
+			CHECK(memcmp(hbms1.cellVolts[ic], chain1.ic[ic].cell, sizeof(hbms1.cellVolts[ic])) == 0);
+			CHECK(hbms1.auxVolts[ic][0] == chain1.ic[ic].gpio[0]);
+			CHECK(hbms1.boardStat[ic][STAT_VA] == chain1.ic[ic].va);
+		}
+
+		// Published frame of the same length
+		LTC6804_snapshotPublish(&hbms1);
+		frameCells = canaried(n * sizeof(*frameCells));
+		memset(&frame, 0, sizeof(frame));
+		frame.cellVolts = frameCells;
+		frame.auxVolts = canaried(n * sizeof(*hbms1.auxVolts));
+		frame.boardStat = canaried(n * sizeof(*hbms1.boardStat));
+		frame.stats.icSum = canaried(n * sizeof(uint32_t));
+		CHECK(LTC6804_snapshotRead(&hbms1, &frame) != 0);
+		CHECK(memcmp(frameCells[n - 1], chain1.ic[n - 1].cell, sizeof(frameCells[0])) == 0);
+
+		// One read of the 4 cell groups: 4 transfers of CMD_LEN + 8 * n bytes, nothing else
+		busy = shimStat.busyUs[0];
+		CHECK(LTC6804_rdcv(&hbms1, 0) == 0);
+		busy = shimStat.busyUs[0] - busy;
+		for(uint8_t reg = 0; reg < NUM_CV_REG; reg++)
+		{
+			expected += (uint32_t)((((uint64_t)LTC6804_XFER_LEN(n) * 8 * 1000000) + shim_sck(&hspi1) - 1) / shim_sck(&hspi1));
+		}
+		CHECK(busy == expected);
+		printf("  %3u  %6lu\n", n, (unsigned long)busy);
+
+		CHECK(chain1.cmdPecErrs == 0);
+		CHECK(chain1.cfgPecErrs == 0);
+		CHECK(chain1.framingErrs == 0);
+		CHECK(hbms1.health.pecFails == 0);
+		CHECK(canariesOk());
+		freeBuffers();
+	}
+
+	return harness_report("test_chain");
+}
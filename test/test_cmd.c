@@ -0,0 +1,90 @@
+/*
+ * test_cmd.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Precomputed command codes and PECs: every set_adc() template for every
+ *  MD/DCP/CH/CHG combination, and every fixed command sent by the library's
+ *  paths, must be accepted by the chain model (which checks the PEC with its
+ *  own bitwise PEC15 and decodes the opcode).
+ */
+
+#include "harness.h"
+
+#define TEST_IC		2
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+
+// The template holds code and its PEC
+static void checkCmd(const uint8_t * cmd, uint16_t code)
+{
+	uint16_t pec = sim_pec15(cmd, 2);
+
+	CHECK((((uint16_t)cmd[0] << 8) | cmd[1]) == code);
+	CHECK((cmd[2] == (uint8_t)(pec >> 8)) && (cmd[3] == (uint8_t)pec));
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+
+	harness_init();
+
+	// Templates, every combination
+	for(uint8_t md = 0; md < 4; md++)
+	{
+		uint16_t mdBits = (uint16_t)md << 7;
+
+		for(uint8_t dcp = 0; dcp < 2; dcp++)
+		{
+			for(uint8_t ch = 0; ch < 7; ch++)
+			{
+				set_adc(&hbms1, md, dcp, ch, ch);
+				checkCmd(hbms1.ADCV, 0x0260 | mdBits | (dcp << 4) | ch);
+				checkCmd(hbms1.ADAX, 0x0460 | mdBits | ch);
+				checkCmd(hbms1.ADCVAX, 0x046F | mdBits | (dcp << 4));
+				checkCmd(hbms1.CVST, 0x0207 | mdBits | (0x02 << 5));
+				checkCmd(hbms1.AXST, 0x0407 | mdBits | (0x02 << 5));
+				checkCmd(hbms1.STATST, 0x040F | mdBits | (0x02 << 5));
+				checkCmd(hbms1.ADSTAT, 0x0468 | mdBits);
+				checkCmd(hbms1.ADOWPU, 0x0228 | mdBits | (1 << 6) | (dcp << 4));
+				checkCmd(hbms1.ADOWPD, 0x0228 | mdBits | (dcp << 4));
+			}
+		}
+	}
+
+	// Every command path: WRCFG/RDCFG, CVST, STATST and ADSTAT (Initialize), ADCV, ADAX,
+	// RDCVx, RDAUXx, RDSTATx and PLADC (scans), ADCVAX, AXST, DIAGN, ADOW, CLRCELL, CLRAUX
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX | LTC6804_SCAN_STAT) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+	CHECK(LTC6804_scanCvax(&hbms1) == 0);
+	CHECK(LTC6804_auxTest(&hbms1) == 0);
+	CHECK(LTC6804_muxTest(&hbms1) == 0);
+	CHECK(LTC6804_owTest(&hbms1) == 1);
+	CHECK(LTC6804_owTest(&hbms1) == 0);
+	LTC6804_clrcell(&hbms1);
+	LTC6804_clraux(&hbms1);
+	CHECK(LTC6804_rdcv(&hbms1, 0) == 0);
+	CHECK(hbms1.cellVolts[0][0] == 0xFFFF);
+	CHECK(LTC6804_rdaux(&hbms1, 0) == 0);
+	CHECK(hbms1.auxVolts[1][5] == 0xFFFF);
+
+	CHECK(chain1.cmdPecErrs == 0);
+	CHECK(chain1.unknownCmds == 0);
+	for(uint8_t conv = SIM_CONV_CELL; conv <= SIM_CONV_DIAGN; conv++)
+	{
+		CHECK(chain1.conversions[conv] != 0);
+	}
+	for(uint8_t grp = 0; grp < SIM_GRP_NUM; grp++)
+	{
+		CHECK(chain1.reads[grp] != 0);
+	}
+	CHECK(chain1.plPolls != 0);
+
+	return harness_report("test_cmd");
+}
@@ -0,0 +1,98 @@
+/*
+ * test_diag.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Background diagnostics: ADOW, CVST and AXST always convert every channel,
+ *  so they are timed and budgeted as such even when the scans only convert
+ *  one cell pair or one GPIO, and the open wire reads account their PEC
+ *  errors like any other cell read.
+ */
+
+#include "harness.h"
+#include "nodeConf.h"
+
+#define TEST_IC		4
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	uint32_t allUs;
+	uint64_t start;
+	uint32_t pecCount;
+	uint32_t winReads;
+	uint16_t icErrs;
+	uint32_t pecFails;
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 18);
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+
+	// Scans of one cell pair and one GPIO: the self-tests still take the all channel time
+	set_adc(&hbms1, MD_NORMAL, DCP_DISABLED, CELL_CH_1and7, AUX_CH_GPIO1);
+	allUs = LTC6804_convTime(&hbms1, LTC6804_CONV_ALL);
+	CHECK(allUs > LTC6804_convTime(&hbms1, LTC6804_CONV_CELL));
+	CHECK(allUs > LTC6804_convTime(&hbms1, LTC6804_CONV_AUX));
+	start = shimNow;
+	CHECK(LTC6804_cvTest(&hbms1) == 0);
+	CHECK(shimNow - start >= allUs);
+	start = shimNow;
+	CHECK(LTC6804_auxTest(&hbms1) == 0);
+	CHECK(shimNow - start >= allUs);
+
+	// A slice too short for an all channel conversion runs none of those tests
+	hbms1.diag.next = LTC6804_DIAG_CV;
+	LTC6804_diagRun(&hbms1, allUs - 1);
+	CHECK(hbms1.diag.runs[LTC6804_DIAG_CV] == 0);
+	CHECK(hbms1.diag.runs[LTC6804_DIAG_AUX] == 0);
+	CHECK(hbms1.diag.runs[LTC6804_DIAG_OW] == 0);
+	CHECK(hbms1.diag.skips >= 3);
+	CHECK(chain1.conversions[SIM_CONV_OW] == 0);
+
+	// Plenty of time: every test runs and passes
+	hbms1.diag.next = LTC6804_DIAG_CV;
+	LTC6804_diagRun(&hbms1, 1000000);
+	LTC6804_diagRun(&hbms1, 1000000);
+	for(uint8_t test = 0; test < LTC6804_DIAG_NUM; test++)
+	{
+		CHECK(hbms1.diag.runs[test] != 0);
+		CHECK(hbms1.diag.fails[test] == 0);
+	}
+
+	// A PEC error in the open wire reads is counted like a scan read's, then cleared by a clean read
+	pecCount = hbms1.pecCount[2][LTC6804_GRP_CVB];
+	winReads = hbms1.link.winReads;
+	icErrs = hbms1.linkIcErrs[2];
+	pecFails = hbms1.health.pecFails;
+	chain1.corruptIC = 2;
+	chain1.corruptGrp = SIM_GRP_CVA + 1;
+	chain1.corruptCount = 1;
+	hbms1.owPhase = 0;
+	CHECK(LTC6804_owTest(&hbms1) == 1);
+	CHECK(hbms1.owPhase == 0);
+	CHECK(hbms1.pecErrIC == (1UL << 2));
+	CHECK(hbms1.pecMap[2] & (1U << LTC6804_GRP_CVB));
+	CHECK(LTC6804_pecGroupIC(&hbms1, LTC6804_GRP_CVB) == (1UL << 2));
+	CHECK(hbms1.pecCount[2][LTC6804_GRP_CVB] == pecCount + 1);
+	CHECK(hbms1.link.winReads == winReads + 1);
+	CHECK(hbms1.linkIcErrs[2] == icErrs + 1);
+	CHECK(hbms1.health.pecFails == pecFails + 1);
+
+	CHECK(LTC6804_owTest(&hbms1) == 1);
+	CHECK(LTC6804_owTest(&hbms1) == 0);
+	CHECK(hbms1.pecErrIC == 0);
+	CHECK(LTC6804_pecGroupIC(&hbms1, LTC6804_GRP_CVB) == 0);
+	CHECK(hbms1.link.winReads == winReads + 3);
+
+	CHECK(chain1.cmdPecErrs == 0);
+	CHECK(chain1.unknownCmds == 0);
+	CHECK(shimStat.timeouts == 0);
+
+	return harness_report("test_diag");
+}
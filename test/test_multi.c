@@ -0,0 +1,109 @@
+/*
+ * test_multi.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Two chains on independent SPI peripherals and chip selects: each one is
+ *  completed by its own interrupts, LTC6804_rdcvMulti() reads both right, and
+ *  its bus time overlaps so a split pack scans in about the time of one chain.
+ */
+
+#include "harness.h"
+
+#define TEST_IC		8
+#define ROUNDS		20
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+LTC68041_CHAIN_STORAGE(hbms2, TEST_IC);
+ltc68041ChainHandle hbms2 = LTC68041_CHAIN_HANDLE(hbms2, TEST_IC);
+static simChain chain1;
+static simChain chain2;
+
+static void checkCells(const simChain * chain, const ltc68041ChainHandle * hbms)
+{
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		CHECK(memcmp(hbms->cellVolts[ic], chain->ic[ic].cell, sizeof(hbms->cellVolts[ic])) == 0);
+	}
+}
+
+static void checkLink(const simChain * chain)
+{
+	CHECK(chain->cmdPecErrs == 0);
+	CHECK(chain->unknownCmds == 0);
+	CHECK(chain->csGlitches == 0);
+	CHECK(chain->framingErrs == 0);
+	CHECK(chain->noCs == 0);
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	ltc68041ChainHandle * chains[2] = {&hbms1, &hbms2};
+	uint64_t start;
+	uint64_t serialUs = 0;
+	uint64_t multiUs = 0;
+	uint64_t singleUs = 0;
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_chain(&hbms2, &chain2, &hspi2, NULL, GPIO_PIN_0);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 1);
+	sim_cells(&chain2, 2);
+
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(LTC68041_Initialize(&hbms2, hinit) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+	CHECK(LTC6804_scan(&hbms2, LTC6804_SCAN_CELL) == 0);
+	checkCells(&chain1, &hbms1);
+	checkCells(&chain2, &hbms2);
+
+	// Chains read one after the other, then both at once
+	for(uint8_t round = 0; round < ROUNDS; round++)
+	{
+		sim_cells(&chain1, 100 + round);
+		sim_cells(&chain2, 200 + round);
+		CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+		CHECK(LTC6804_scan(&hbms2, LTC6804_SCAN_CELL) == 0);
+
+		start = shimNow;
+		CHECK(LTC6804_rdcv(&hbms1, 0) == 0);
+		singleUs += shimNow - start;
+		CHECK(LTC6804_rdcv(&hbms2, 0) == 0);
+		serialUs += shimNow - start;
+
+		memset(hbms1.cellVolts, 0, sizeof(hbms1.cellVolts[0]) * TEST_IC);
+		memset(hbms2.cellVolts, 0, sizeof(hbms2.cellVolts[0]) * TEST_IC);
+		start = shimNow;
+		CHECK(LTC6804_rdcvMulti(chains, 2) == 0);
+		multiUs += shimNow - start;
+		checkCells(&chain1, &hbms1);
+		checkCells(&chain2, &hbms2);
+	}
+
+	// A PEC error on one chain is reported without spoiling the other one
+	chain2.corruptIC = 3;
+	chain2.corruptGrp = SIM_GRP_CVA + 1;
+	chain2.corruptCount = 1;
+	CHECK(LTC6804_rdcvMulti(chains, 2) == -1);
+	CHECK(hbms1.pecErrIC == 0);
+	CHECK(hbms2.pecErrIC == (1UL << 3));
+	checkCells(&chain1, &hbms1);
+
+	printf("  RDCV of 2 x %u ICs (us): single %lu, serial %lu, multi %lu (%.2fx)\n", TEST_IC,
+			(unsigned long)(singleUs / ROUNDS), (unsigned long)(serialUs / ROUNDS), (unsigned long)(multiUs / ROUNDS),
+			(double)serialUs / (double)multiUs);
+	// Overlapped: within 10% of one chain, well under the serial sum
+	CHECK(multiUs * 10 <= singleUs * 11);
+	CHECK(multiUs * 10 <= serialUs * 6);
+
+	CHECK(shimStat.busyUs[0] != 0);
+	CHECK(shimStat.busyUs[1] != 0);
+	CHECK(shimStat.timeouts == 0);
+	checkLink(&chain1);
+	checkLink(&chain2);
+
+	return harness_report("test_multi");
+}
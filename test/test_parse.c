@@ -0,0 +1,120 @@
+/*
+ * test_parse.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  The fused unpack + PEC check of register group reads against a byte by
+ *  byte reference: random codes on a full 32 IC chain read over a link that
+ *  flips a bit in some IC frames. Every code must come out of the raw Rx
+ *  buffer, and the PEC error mask, return value and per group counters must
+ *  flag exactly the frames the reference (bitwise PEC15) rejects.
+ */
+
+#include "harness.h"
+
+#define TEST_IC		32
+#define ROUNDS		500
+#define FLIP_PPM	5000			// IC frames with a bit flipped
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+static uint32_t pecCount[TEST_IC][LTC6804_GRP_NUM];
+
+// Checks one group of every IC in rx against dst, returns the ICs whose PEC is bad
+static uint32_t refGroup(const uint8_t * rx, const uint16_t * dst, uint8_t stride, uint8_t grp)
+{
+	uint32_t errors = 0;
+
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		const uint8_t * frame = rx + ic * 8;
+
+		for(uint8_t code = 0; code < 3; code++)
+		{
+			CHECK(dst[ic * stride + code] == (uint16_t)(frame[2 * code] | (frame[2 * code + 1] << 8)));
+		}
+		if(sim_pec15(frame, REG_BYTES_SIM) != (uint16_t)((frame[6] << 8) | frame[7]))
+		{
+			errors |= (1UL << ic);
+			pecCount[ic][grp]++;
+		}
+	}
+	return errors;
+}
+
+static void randomRegs(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		for(uint8_t i = 0; i < 12; i++)
+		{
+			chain1.ic[ic].cv[i] = (uint16_t)sim_random();
+		}
+		for(uint8_t i = 0; i < 6; i++)
+		{
+			chain1.ic[ic].aux[i] = (uint16_t)sim_random();
+		}
+	}
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	uint32_t expected;
+	uint32_t flagged = 0;
+	uint32_t badRounds = 0;
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 10);
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);
+	memcpy(pecCount, hbms1.pecCount, sizeof(pecCount));
+
+	sim_seed(6804);
+	chain1.marginalHz = 1;
+	chain1.marginalPpm = FLIP_PPM;
+	for(uint32_t round = 0; round < ROUNDS; round++)
+	{
+		int8_t ret;
+
+		randomRegs();
+
+		// All cell groups in one job list, each group in its own Rx slot
+		ret = LTC6804_rdcv(&hbms1, 0);
+		expected = 0;
+		for(uint8_t reg = 0; reg < NUM_CV_REG; reg++)
+		{
+			uint32_t errors = refGroup(&hbms1.spiRxBuf[reg * LTC6804_XFER_LEN(TEST_IC) + CMD_LEN],
+					&hbms1.cellVolts[0][reg * 3], 12, LTC6804_GRP_CVA + reg);
+
+			expected |= errors;
+			flagged += __builtin_popcount(errors);
+		}
+		CHECK(hbms1.pecErrIC == expected);
+		CHECK(ret == (expected ? -1 : 0));
+		badRounds += (expected != 0);
+
+		// Aux groups one at a time, into rows of REG_BYTES codes
+		for(uint8_t reg = 1; reg <= 2; reg++)
+		{
+			ret = LTC6804_rdaux(&hbms1, reg);
+			expected = refGroup(&hbms1.spiRxBuf[CMD_LEN], &hbms1.auxVolts[0][(reg - 1) * 3], REG_BYTES, LTC6804_GRP_AUXA + reg - 1);
+			CHECK(ret == (expected ? -1 : 0));
+			flagged += __builtin_popcount(expected);
+		}
+	}
+
+	// A single bit flip never passes the PEC: every corrupted frame was flagged, and nothing else
+	printf("  %lu frames corrupted, %lu flagged, %lu of %u cell reads with errors\n",
+			(unsigned long)chain1.corrupted, (unsigned long)flagged, (unsigned long)badRounds, ROUNDS);
+	CHECK(chain1.corrupted != 0);
+	CHECK(flagged == chain1.corrupted);
+	CHECK(badRounds < ROUNDS);
+	CHECK(memcmp(pecCount, hbms1.pecCount, sizeof(pecCount)) == 0);
+	CHECK(chain1.cmdPecErrs == 0);
+
+	return harness_report("test_parse");
+}
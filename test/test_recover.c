@@ -0,0 +1,151 @@
+/*
+ * test_recover.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  A transfer that never ends, found by whichever call waits for the bus next:
+ *  the bus is taken back, the async request that hung fails with -2, the job
+ *  list that hung reports a failed transfer instead of stale data, requests
+ *  queued behind it still go out, and the chain reads right afterwards.
+ */
+
+#include "harness.h"
+#include "nodeConf.h"
+
+#define TEST_IC		4
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+
+static const uint8_t cmdRDCFG[CMD_LEN] = {0x00, 0x02, 0x2B, 0x0A};
+static uint8_t cfgRead[TEST_IC][REG_BYTES];
+
+// Keeps the configuration read back, IC 0 first
+static int8_t parseCfg(ltc68041ChainHandle * hbms, const uint8_t * rx, void * ctx)
+{
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		memcpy(cfgRead[ic], rx + ic * BYTES_IN_REG, REG_BYTES);
+	}
+	return 0;
+}
+
+static void cfgReq(ltc68041Req * req)
+{
+	memset(req, 0, sizeof(*req));
+	req->cmd = cmdRDCFG;
+	req->len = BYTES_IN_REG * TEST_IC;
+	req->parse = parseCfg;
+}
+
+static uint8_t cellsOk(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		if(memcmp(hbms1.cellVolts[ic], chain1.ic[ic].cell, sizeof(hbms1.cellVolts[ic])) != 0)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// The GPIO bits of CFGR0 read back the pin levels, only ADCOPT, SWTRD and REFON are compared there
+static uint8_t cfgOk(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		if(((cfgRead[ic][0] ^ chain1.ic[ic].cfg[0]) & 0x07) ||
+				(memcmp(&cfgRead[ic][1], &chain1.ic[ic].cfg[1], REG_BYTES - 1) != 0))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static uint8_t auxOk(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		if(hbms1.auxVolts[ic][0] != chain1.ic[ic].gpio[0])
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	ltc68041Req req[2];
+	uint32_t aborts;
+	uint32_t xferFails;
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 22);
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);		// Reads the GPIOs converted by the first one
+
+	// An async request hangs, a blocking read takes the bus back: the request fails, the read does not
+	aborts = shimStat.aborts;
+	xferFails = hbms1.health.xferFails;
+	cfgReq(&req[0]);
+	chain1.hangCount = 1;
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[0]) == 0);
+	memset(hbms1.cellVolts, 0, sizeof(hbms1.cellVolts[0]) * TEST_IC);
+	CHECK(LTC6804_rdcv(&hbms1, 0) == 0);
+	CHECK(cellsOk());
+	CHECK(shimStat.aborts == aborts + 1);
+	CHECK(!hbms1.asyncBusy && !hbms1.asyncActive);
+	CHECK(req[0].state == LTC6804_REQ_XFERED);
+	CHECK(LTC6804_asyncWait(&hbms1, &req[0]) == -2);
+	CHECK(req[0].state == LTC6804_REQ_DONE);
+	CHECK(hbms1.health.xferFails == xferFails + 2);					// The hang, then the failed request
+
+	// A request queued behind the one that hung goes out once waited for
+	memset(cfgRead, 0, sizeof(cfgRead));
+	cfgReq(&req[0]);
+	cfgReq(&req[1]);
+	chain1.hangCount = 1;
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[0]) == 0);
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[1]) == 0);
+	memset(hbms1.auxVolts, 0, sizeof(hbms1.auxVolts[0]) * TEST_IC);
+	CHECK(LTC6804_rdaux(&hbms1, 1) == 0);
+	CHECK(auxOk());
+	CHECK(req[1].state == LTC6804_REQ_QUEUED);
+	CHECK(LTC6804_asyncWait(&hbms1, &req[1]) == 0);
+	CHECK(req[0].status == -2);
+	CHECK(req[0].state == LTC6804_REQ_DONE);
+	CHECK(cfgOk());
+
+	// A job list hangs, a request submitted behind it takes the bus back: the list fails, the request does not
+	memset(cfgRead, 0, sizeof(cfgRead));
+	cfgReq(&req[0]);
+	chain1.hangCount = 1;
+	LTC6804_rdcv_pipe(&hbms1);
+	CHECK(LTC6804_asyncSubmit(&hbms1, &req[0]) == 0);
+	CHECK(hbms1.xferStages == 0);
+	CHECK(LTC6804_asyncWait(&hbms1, &req[0]) == 0);
+	CHECK(cfgOk());
+	CHECK(LTC6804_rdcv_pipeCplt(&hbms1) == -2);
+
+	// Everything reads right afterwards
+	memset(hbms1.cellVolts, 0, sizeof(hbms1.cellVolts[0]) * TEST_IC);
+	memset(hbms1.auxVolts, 0, sizeof(hbms1.auxVolts[0]) * TEST_IC);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);
+	CHECK(cellsOk());
+	CHECK(auxOk());
+	CHECK(shimStat.aborts == aborts + 3);
+
+	CHECK(chain1.cmdPecErrs == 0);
+	CHECK(chain1.unknownCmds == 0);
+	CHECK(chain1.framingErrs == 0);
+
+	return harness_report("test_recover");
+}
@@ -0,0 +1,123 @@
+/*
+ * test_scan.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Bring-up and acquisition against the chain model: LTC68041_Initialize()
+ *  passes its self-tests, the scans read back every cell, GPIO and status
+ *  code, and the chips never see a malformed frame.
+ */
+
+#include "harness.h"
+#include "nodeConf.h"
+
+#define TEST_IC		3
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+
+// Every converted code of the chain matches the model's inputs
+static void checkCodes(const simChain * chain, const ltc68041ChainHandle * hbms, uint8_t aux, uint8_t stat)
+{
+	for(uint8_t ic = 0; ic < hbms->numIC; ic++)
+	{
+		const simIC * dev = &chain->ic[ic];
+		uint32_t sum = 0;
+
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			CHECK(hbms->cellVolts[ic][cell] == dev->cell[cell]);
+			sum += dev->cell[cell];
+		}
+		if(aux)
+		{
+			for(uint8_t gpio = 0; gpio < 5; gpio++)
+			{
+				CHECK(hbms->auxVolts[ic][gpio] == dev->gpio[gpio]);
+			}
+			CHECK(hbms->auxVolts[ic][5] == dev->ref2);
+		}
+		if(stat)
+		{
+			CHECK(hbms->boardStat[ic][STAT_SOC] == sum / 20);
+			CHECK(hbms->boardStat[ic][STAT_ITMP] == dev->itmp);
+			CHECK(hbms->boardStat[ic][STAT_VA] == dev->va);
+			CHECK(hbms->boardStat[ic][STAT_VD] == dev->vd);
+		}
+	}
+}
+
+// Nothing the library sent was rejected or torn by the chips
+static void checkLink(const simChain * chain)
+{
+	CHECK(chain->cmdPecErrs == 0);
+	CHECK(chain->cfgPecErrs == 0);
+	CHECK(chain->unknownCmds == 0);
+	CHECK(chain->csGlitches == 0);
+	CHECK(chain->framingErrs == 0);
+	CHECK(chain->noCs == 0);
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	uint32_t xferFails;
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 1);
+
+	// Bring-up with the link down fails and is counted, the retry passes
+	chain1.errorCount = 0xFFFF;
+	CHECK(LTC68041_Initialize(&hbms1, hinit) != 0);
+	CHECK(hbms1.health.initFails == 1);
+	chain1.errorCount = 0;
+	xferFails = hbms1.health.xferFails;
+
+	// Bring-up: configuration written and verified, self-tests and supplies pass
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(hbms1.health.initFails == 1);
+	CHECK(hbms1.cfgStale == 0);
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		CHECK((chain1.ic[ic].cfg[1] | ((uint16_t)(chain1.ic[ic].cfg[2] & 0x0F) << 8)) == hinit[ic].vuv);
+	}
+	checkLink(&chain1);
+
+	// Cells, then aux (read back during the next scan) and status
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_AUX) == 0);
+	checkCodes(&chain1, &hbms1, 0, 0);
+	sim_cells(&chain1, 2);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL | LTC6804_SCAN_STAT) == 0);
+	checkCodes(&chain1, &hbms1, 1, 1);
+	CHECK(LTC6804_statFaultIC((const uint16_t (*)[6])hbms1.boardStat, TEST_IC) == 0);
+
+	// An overvoltage cell is flagged by the comparators with the same conversion
+	chain1.ic[1].cell[4] = BMS_CELL_OV + 100;
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+	checkCodes(&chain1, &hbms1, 0, 0);
+	CHECK(LTC6804_statOV(hbms1.boardStat[1]) == (1 << 4));
+	CHECK(LTC6804_statFaultIC((const uint16_t (*)[6])hbms1.boardStat, TEST_IC) == 0x2);
+
+	// After the watchdog put the chain to sleep: full wake up, scan, then the scrub restores the configuration
+	shim_run(2500000);
+	sim_cells(&chain1, 3);
+	wakeup_sleep(&hbms1);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+	checkCodes(&chain1, &hbms1, 0, 0);
+	CHECK(chain1.sleeps == 1);
+	CHECK(LTC6804_cfgScrub(&hbms1) == 1);
+	CHECK(hbms1.health.cfgDrifts == 1);
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		CHECK(memcmp(chain1.ic[ic].cfg, hbms1.boardConfigs[ic], REG_BYTES) == 0);
+	}
+
+	checkLink(&chain1);
+	CHECK(hbms1.health.pecFails == 0);
+	CHECK(hbms1.health.xferFails == xferFails);
+	CHECK(shimStat.timeouts == 0);
+	return harness_report("test_scan");
+}
@@ -0,0 +1,228 @@
+/*
+ * test_stats.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Pack statistics against a plain reference written from their definitions.
+ *  The Makefile builds this with the SIMD backend (default) and the scalar one,
+ *  so both are held to the same answers: random packs of 1 to 32 ICs plus the
+ *  patterns that stress the lane merge (ties, all equal, codes at 0 and 0xFFFF,
+ *  the extremes in either lane and in the last cell).
+ *
+ *  packStatsInc is then driven with random single register group updates and
+ *  must give what packStats_compute() gives over the same cells after any of them.
+ */
+
+#include "harness.h"
+#include "packStats.h"
+
+#define MAX_IC		32
+#define ROUNDS		20000
+#define UPDATES		200000
+
+static uint16_t cells[MAX_IC][12];
+static uint32_t icSum[MAX_IC];
+static uint32_t refIcSum[MAX_IC];
+static uint32_t incIcSum[MAX_IC];
+static uint16_t incCells[MAX_IC][12];
+
+// Straight from the definitions: first cell on ties, population variance rounded down
+static void reference(uint8_t numIC, packStats * ref)
+{
+	uint32_t n = numIC * 12;
+	uint64_t sq = 0;
+	uint32_t minIdx = 0;
+	uint32_t maxIdx = 0;
+
+	memset(ref, 0, sizeof(*ref));
+	ref->icSum = refIcSum;
+	for(uint32_t idx = 0; idx < n; idx++)
+	{
+		uint16_t code = cells[idx / 12][idx % 12];
+
+		if(code < cells[minIdx / 12][minIdx % 12])
+		{
+			minIdx = idx;
+		}
+		if(code > cells[maxIdx / 12][maxIdx % 12])
+		{
+			maxIdx = idx;
+		}
+		ref->sum += code;
+		sq += (uint64_t)code * code;
+	}
+	for(uint8_t ic = 0; ic < numIC; ic++)
+	{
+		refIcSum[ic] = 0;
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			refIcSum[ic] += cells[ic][cell];
+		}
+	}
+	ref->min = cells[minIdx / 12][minIdx % 12];
+	ref->max = cells[maxIdx / 12][maxIdx % 12];
+	ref->minIC = minIdx / 12;
+	ref->minCell = minIdx % 12;
+	ref->maxIC = maxIdx / 12;
+	ref->maxCell = maxIdx % 12;
+	ref->delta = ref->max - ref->min;
+	ref->mean = ref->sum / n;
+	ref->variance = (uint32_t)(((__int128)n * sq - (__int128)ref->sum * ref->sum) / ((__int128)n * n));
+}
+
+static uint8_t same(const packStats * a, const packStats * b, uint8_t numIC)
+{
+	return (a->min == b->min) && (a->max == b->max) &&
+			(a->minIC == b->minIC) && (a->minCell == b->minCell) &&
+			(a->maxIC == b->maxIC) && (a->maxCell == b->maxCell) &&
+			(a->delta == b->delta) && (a->mean == b->mean) &&
+			(a->sum == b->sum) && (a->variance == b->variance) &&
+			(memcmp(a->icSum, b->icSum, numIC * sizeof(uint32_t)) == 0);
+}
+
+// Random codes, mostly around a nominal cell with a few outliers, or over the full range
+static void fillRandom(uint8_t numIC, uint8_t wide)
+{
+	for(uint8_t ic = 0; ic < numIC; ic++)
+	{
+		for(uint8_t cell = 0; cell < 12; cell++)
+		{
+			cells[ic][cell] = wide ? (uint16_t)sim_random() : (uint16_t)(36000 + (sim_random() % 64));
+		}
+	}
+}
+
+// New codes for one register group (3 cells) of every IC, as a read would bring them
+static void moveGroup(uint8_t numIC, uint8_t first)
+{
+	for(uint8_t ic = 0; ic < numIC; ic++)
+	{
+		for(uint8_t cell = first; cell < first + 3; cell++)
+		{
+			switch(sim_random() % 4)
+			{
+			case 0:										// Unchanged
+				break;
+			case 1:										// Drift of a few codes either way
+				cells[ic][cell] += (uint16_t)((sim_random() % 9) - 4);
+				break;
+			case 2:										// Jump anywhere in a narrow band, ties likely
+				cells[ic][cell] = (uint16_t)(36000 + (sim_random() % 16));
+				break;
+			default:									// Outlier, occasionally at the ends of the range
+				cells[ic][cell] = (sim_random() & 1) ? (uint16_t)(sim_random() % 3) * 0x7FFF : (uint16_t)sim_random();
+				break;
+			}
+		}
+	}
+}
+
+// Fixed patterns, each one ending on a different merge case
+static uint8_t fillPattern(uint8_t pattern, uint8_t numIC)
+{
+	uint32_t n = numIC * 12;
+
+	for(uint32_t idx = 0; idx < n; idx++)
+	{
+		uint16_t * code = &cells[idx / 12][idx % 12];
+
+		switch(pattern)
+		{
+		case 0:	*code = 0;						break;		// All lowest
+		case 1:	*code = 0xFFFF;					break;		// All highest
+		case 2:	*code = 37000;					break;		// All equal
+		case 3:	*code = (idx & 1) ? 0xFFFF : 0;	break;		// Lanes at opposite ends
+		case 4:	*code = (idx & 1) ? 0 : 0xFFFF;	break;
+		case 5:	*code = (uint16_t)(40000 - idx);	break;	// Min in the last cell, max in the first
+		case 6:	*code = (uint16_t)(30000 + idx);	break;	// Max in the last cell, min in the first
+		case 7:	*code = (idx % 5) ? 36000 : 37000;	break;	// Ties spread over both lanes
+		case 8:	*code = (idx % 7) ? 36000 : 35000;	break;
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(void)
+{
+	packStats stats = {.icSum = icSum};
+	packStats ref;
+	uint32_t mismatches = 0;
+
+	sim_seed(14);
+	for(uint8_t numIC = 1; numIC <= MAX_IC; numIC++)
+	{
+		for(uint8_t pattern = 0; fillPattern(pattern, numIC); pattern++)
+		{
+			packStats_compute((const uint16_t (*)[12])cells, numIC, &stats);
+			reference(numIC, &ref);
+			if(!same(&stats, &ref, numIC))
+			{
+				printf("  pattern %u on %u ICs differs\n", pattern, numIC);
+				mismatches++;
+			}
+		}
+	}
+	for(uint32_t round = 0; round < ROUNDS; round++)
+	{
+		uint8_t numIC = 1 + (sim_random() % MAX_IC);
+
+		fillRandom(numIC, round & 1);
+		packStats_compute((const uint16_t (*)[12])cells, numIC, &stats);
+		reference(numIC, &ref);
+		mismatches += !same(&stats, &ref, numIC);
+	}
+	CHECK(mismatches == 0);
+
+	// The per-IC sums land in the caller's array, and a copy keeps its own
+	{
+		uint32_t copySum[MAX_IC];
+		packStats copy = {.icSum = copySum};
+
+		fillRandom(MAX_IC, 1);
+		packStats_compute((const uint16_t (*)[12])cells, MAX_IC, &stats);
+		packStats_copy(&copy, &stats, MAX_IC);
+		CHECK(copy.icSum == copySum);
+		CHECK(same(&copy, &stats, MAX_IC));
+	}
+
+	// Incremental statistics over random single group updates, read back after some of them
+	mismatches = 0;
+	for(uint8_t numIC = 1; numIC <= MAX_IC; numIC += 31)
+	{
+		packStatsInc inc = {.numIC = numIC, .icSum = incIcSum, .cells = incCells};
+		packStats incStats = {.icSum = icSum};
+		uint32_t reads = 0;
+
+		fillRandom(numIC, 0);
+		packStatsInc_reset(&inc, (const uint16_t (*)[12])cells);
+		for(uint32_t update = 0; update < UPDATES; update++)
+		{
+			uint8_t first = (sim_random() % 4) * 3;
+
+			moveGroup(numIC, first);
+			packStatsInc_update(&inc, (const uint16_t (*)[12])cells, first, 3);
+			if(sim_random() % 3)
+			{
+				continue;								// Not read after this one, min/max may stay stale
+			}
+			packStatsInc_get(&inc, &incStats);
+			reads++;
+			reference(numIC, &ref);
+			if(!same(&incStats, &ref, numIC))
+			{
+				if(mismatches++ < 5)
+				{
+					printf("  update %lu on %u ICs differs\n", (unsigned long)update, numIC);
+				}
+			}
+		}
+		CHECK(memcmp(incCells, cells, numIC * sizeof(cells[0])) == 0);
+		CHECK(inc.rebuilds < reads);
+		printf("  %u ICs: %lu reads, %lu min/max rescans\n", numIC, (unsigned long)reads, (unsigned long)inc.rebuilds);
+	}
+	CHECK(mismatches == 0);
+
+	return harness_report("test_stats");
+}
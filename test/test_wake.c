@@ -0,0 +1,89 @@
+/*
+ * test_wake.c
+ *
+ *  Created on: Oct 17, 2026
+ *
+ *  Wake pulses ended by the timer ISR while the reading task is preempted
+ *  between arming a read and starting its transfer: the end of the pulse only
+ *  wakes the task, the read still goes out and returns the chips' registers,
+ *  not what the previous read left in the Rx buffer.
+ */
+
+#include "harness.h"
+
+#define TEST_IC		4
+#define ROUNDS		8
+#define PREEMPT_US	(2 * LTC6804_WAKE_IDLE_US)			// Longer than the pulse
+
+LTC68041_CHAIN_STORAGE(hbms1, TEST_IC);
+ltc68041ChainHandle hbms1 = LTC68041_CHAIN_HANDLE(hbms1, TEST_IC);
+static simChain chain1;
+
+// New register contents, as a conversion would leave them
+static void newCodes(void)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		for(uint8_t i = 0; i < 12; i++)
+		{
+			chain1.ic[ic].cv[i] = (uint16_t)sim_random();
+		}
+	}
+}
+
+static uint8_t codesOk(uint8_t first, uint8_t count)
+{
+	for(uint8_t ic = 0; ic < TEST_IC; ic++)
+	{
+		for(uint8_t i = first; i < first + count; i++)
+		{
+			if(hbms1.cellVolts[ic][i] != chain1.ic[ic].cv[i])
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+int main(void)
+{
+	ltc68041ChainInitStruct hinit[TEST_IC];
+	uint32_t wakes;
+
+	harness_init();
+	harness_chain(&hbms1, &chain1, &hspi1, &htim7, GPIO_PIN_1);
+	harness_params(hinit, TEST_IC);
+	sim_cells(&chain1, 23);
+	sim_seed(23);
+	CHECK(LTC68041_Initialize(&hbms1, hinit) == 0);
+	CHECK(LTC6804_scan(&hbms1, LTC6804_SCAN_CELL) == 0);
+
+	for(uint8_t round = 0; round < ROUNDS; round++)
+	{
+		// Single group read after the port went idle: the pulse ends while the task is out
+		shim_run(LTC6804_AWAKE_MS * 1000 + 1000);
+		newCodes();
+		wakes = hbms1.health.wakes;
+		shimPreemptUs = PREEMPT_US;
+		CHECK(LTC6804_rdcv(&hbms1, 1 + (round % NUM_CV_REG)) == 0);
+		CHECK(hbms1.health.wakes == wakes + 1);
+		CHECK(shimPreemptUs == 0);
+		CHECK(codesOk((round % NUM_CV_REG) * CELL_IN_REG, CELL_IN_REG));
+
+		// Same for a job list
+		shim_run(LTC6804_AWAKE_MS * 1000 + 1000);
+		newCodes();
+		shimPreemptUs = PREEMPT_US;
+		CHECK(LTC6804_rdcv(&hbms1, 0) == 0);
+		CHECK(shimPreemptUs == 0);
+		CHECK(codesOk(0, 12));
+	}
+
+	CHECK(chain1.cmdPecErrs == 0);
+	CHECK(chain1.csGlitches == 0);
+	CHECK(chain1.noCs == 0);
+	CHECK(shimStat.timeouts == 0);
+
+	return harness_report("test_wake");
+}